@@ -2,6 +2,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include "bthome.h"
+#include "bthome_internal.h"
 
 // Object size lookup table (0 = variable length, requires length byte)
 static const uint8_t object_sizes[] = {
@@ -97,46 +98,53 @@ static const uint8_t object_sizes[] = {
     [0xF2] = 3,   // firmware version (uint24)
 };
 
-// Scaling factors for sensors
-static const float scaling_factors[] = {
-    [0x02] = 0.01f,   // temperature
-    [0x03] = 0.01f,   // humidity
-    [0x04] = 0.01f,   // pressure
-    [0x05] = 0.01f,   // illuminance
-    [0x06] = 0.01f,   // mass (kg)
-    [0x07] = 0.01f,   // mass (lb)
-    [0x08] = 0.01f,   // dewpoint
-    [0x0A] = 0.001f,  // energy (uint24)
-    [0x0B] = 0.01f,   // power (uint24)
-    [0x0C] = 0.001f,  // voltage
-    [0x14] = 0.01f,   // moisture
-    [0x3F] = 0.1f,    // rotation
-    [0x42] = 0.001f,  // duration
-    [0x43] = 0.001f,  // current
-    [0x44] = 0.01f,   // speed
-    [0x45] = 0.1f,    // temperature (0.1)
-    [0x46] = 0.1f,    // uv index
-    [0x47] = 0.1f,    // volume (L)
-    [0x49] = 0.001f,  // volume flow rate
-    [0x4A] = 0.1f,    // voltage (0.1V)
-    [0x4B] = 0.001f,  // gas (uint24)
-    [0x4C] = 0.001f,  // gas (uint32)
-    [0x4D] = 0.001f,  // energy (uint32)
-    [0x4E] = 0.001f,  // volume (uint32)
-    [0x4F] = 0.001f,  // water
-    [0x51] = 0.001f,  // acceleration
-    [0x52] = 0.001f,  // gyroscope
-    [0x55] = 0.001f,  // volume storage
-    [0x58] = 0.35f,   // temperature (sint8 0.35)
-    [0x5C] = 0.01f,   // power (sint32)
-    [0x5D] = 0.001f,  // current (sint16)
-    [0x5E] = 0.01f,   // direction
-    [0x5F] = 0.1f,    // precipitation
+// Scaling factors for sensors, as multiplier / 10^decimals so values can be
+// formatted exactly with integer arithmetic
+typedef struct {
+    uint8_t multiplier;
+    uint8_t decimals;
+} decimal_scale_t;
+
+static const decimal_scale_t decimal_scales[] = {
+    [0x02] = { 1, 2 },    // temperature
+    [0x03] = { 1, 2 },    // humidity
+    [0x04] = { 1, 2 },    // pressure
+    [0x05] = { 1, 2 },    // illuminance
+    [0x06] = { 1, 2 },    // mass (kg)
+    [0x07] = { 1, 2 },    // mass (lb)
+    [0x08] = { 1, 2 },    // dewpoint
+    [0x0A] = { 1, 3 },    // energy (uint24)
+    [0x0B] = { 1, 2 },    // power (uint24)
+    [0x0C] = { 1, 3 },    // voltage
+    [0x14] = { 1, 2 },    // moisture
+    [0x3F] = { 1, 1 },    // rotation
+    [0x42] = { 1, 3 },    // duration
+    [0x43] = { 1, 3 },    // current
+    [0x44] = { 1, 2 },    // speed
+    [0x45] = { 1, 1 },    // temperature (0.1)
+    [0x46] = { 1, 1 },    // uv index
+    [0x47] = { 1, 1 },    // volume (L)
+    [0x49] = { 1, 3 },    // volume flow rate
+    [0x4A] = { 1, 1 },    // voltage (0.1V)
+    [0x4B] = { 1, 3 },    // gas (uint24)
+    [0x4C] = { 1, 3 },    // gas (uint32)
+    [0x4D] = { 1, 3 },    // energy (uint32)
+    [0x4E] = { 1, 3 },    // volume (uint32)
+    [0x4F] = { 1, 3 },    // water
+    [0x51] = { 1, 3 },    // acceleration
+    [0x52] = { 1, 3 },    // gyroscope
+    [0x55] = { 1, 3 },    // volume storage
+    [0x58] = { 35, 2 },   // temperature (sint8 0.35)
+    [0x5C] = { 1, 2 },    // power (sint32)
+    [0x5D] = { 1, 3 },    // current (sint16)
+    [0x5E] = { 1, 2 },    // direction
+    [0x5F] = { 1, 1 },    // precipitation
 };
 
 
+#if CONFIG_BTHOME_OBJECT_STRINGS
 // Object names lookup table
-static const char* object_names[] = {
+static const char *const object_names[] = {
     [0x00] = "packet_id",
     [0x01] = "battery",
     [0x02] = "temperature",
@@ -230,7 +238,7 @@ static const char* object_names[] = {
 };
 
 // Object units lookup table
-static const char* object_units[] = {
+static const char *const object_units[] = {
     [0x01] = "%",
     [0x02] = "°C",
     [0x03] = "%",
@@ -281,7 +289,7 @@ static const char* object_units[] = {
 
 
 // Object unit descriptions (ASCII-only)
-static const char* object_unit_descriptions[] = {
+static const char *const object_unit_descriptions[] = {
     [0x01] = "percent",
     [0x02] = "degrees Celsius",
     [0x03] = "percent",
@@ -329,6 +337,7 @@ static const char* object_unit_descriptions[] = {
     [0x5F] = "millimeter",
     [0x61] = "revolutions per minute",
 };
+#endif // CONFIG_BTHOME_OBJECT_STRINGS
 
 // Helper functions
 
@@ -345,6 +354,15 @@ static uint32_t read_uint32_le(const uint8_t *data) {
            ((uint32_t)data[2] << 16) | ((uint32_t)data[3] << 24);
 }
 
+static int16_t read_sint16_le(const uint8_t *data) {
+    return (int16_t)read_uint16_le(data);
+}
+
+static int32_t read_sint32_le(const uint8_t *data) {
+    return (int32_t)read_uint32_le(data);
+}
+
+#if CONFIG_BTHOME_ENCODER
 static void write_uint16_le(uint8_t *data, uint16_t value) {
     data[0] = value & 0xFF;
     data[1] = (value >> 8) & 0xFF;
@@ -363,14 +381,6 @@ static void write_uint32_le(uint8_t *data, uint32_t value) {
     data[3] = (value >> 24) & 0xFF;
 }
 
-static int16_t read_sint16_le(const uint8_t *data) {
-    return (int16_t)read_uint16_le(data);
-}
-
-static int32_t read_sint32_le(const uint8_t *data) {
-    return (int32_t)read_uint32_le(data);
-}
-
 static void write_sint16_le(uint8_t *data, int16_t value) {
     write_uint16_le(data, (uint16_t)value);
 }
@@ -378,6 +388,7 @@ static void write_sint16_le(uint8_t *data, int16_t value) {
 static void write_sint32_le(uint8_t *data, int32_t value) {
     write_uint32_le(data, (uint32_t)value);
 }
+#endif // CONFIG_BTHOME_ENCODER
 
 uint8_t bthome_get_object_size(uint8_t object_id) {
     if (object_id < sizeof(object_sizes)) {
@@ -394,14 +405,105 @@ bool bthome_is_event(uint8_t object_id) {
     return object_id == 0x3A || object_id == 0x3C;
 }
 
+bool bthome_is_signed(uint8_t object_id) {
+    return object_id == 0x02 || object_id == 0x08 || 
+           object_id == 0x3F || object_id == 0x45 ||
+           (object_id >= 0x57 && object_id <= 0x5D);
+}
+
+size_t bthome_value_len(uint8_t object_id, const uint8_t *data, size_t len) {
+    if (len == 0) {
+        return 0;
+    }
+    
+    size_t size;
+    if (object_id == BTHOME_SENSOR_PACKET_ID || object_id == BTHOME_EVENT_BUTTON) {
+        size = 1;
+    } else if (object_id == BTHOME_EVENT_DIMMER) {
+        size = data[0] != BTHOME_DIMMER_NONE ? 2 : 1;
+    } else {
+        size = bthome_get_object_size(object_id);
+        if (size == 0) {
+            size = 1 + data[0];  // Length byte + data
+        }
+    }
+    
+    return size <= len ? size : 0;
+}
+
+void bthome_read_value(const uint8_t *data, uint8_t size, bool is_signed, bthome_value_t *value) {
+    if (is_signed) {
+        switch (size) {
+            case 1:
+                value->sint8_val = (int8_t)data[0];
+                break;
+            case 2:
+                value->sint16_val = read_sint16_le(data);
+                break;
+            case 4:
+                value->sint32_val = read_sint32_le(data);
+                break;
+        }
+    } else {
+        switch (size) {
+            case 1:
+                value->uint8_val = data[0];
+                break;
+            case 2:
+                value->uint16_val = read_uint16_le(data);
+                break;
+            case 3:
+                value->uint32_val = read_uint24_le(data);
+                break;
+            case 4:
+                value->uint32_val = read_uint32_le(data);
+                break;
+        }
+    }
+}
+
+void bthome_get_decimal_scale(uint8_t object_id, uint8_t *multiplier, uint8_t *decimals) {
+    *multiplier = 1;
+    *decimals = 0;
+    if (object_id < sizeof(decimal_scales) / sizeof(decimal_scales[0]) &&
+        decimal_scales[object_id].multiplier != 0) {
+        *multiplier = decimal_scales[object_id].multiplier;
+        *decimals = decimal_scales[object_id].decimals;
+    }
+}
+
 float bthome_get_scaling_factor(uint8_t object_id) {
-    if (object_id < sizeof(scaling_factors) / sizeof(scaling_factors[0])) {
-        float factor = scaling_factors[object_id];
-        return factor == 0.0f ? 1.0f : factor;
+    static const float powers_of_ten[] = { 1.0f, 10.0f, 100.0f, 1000.0f };
+    uint8_t multiplier, decimals;
+    bthome_get_decimal_scale(object_id, &multiplier, &decimals);
+    return multiplier / powers_of_ten[decimals];
+}
+
+int64_t bthome_get_raw_value(const bthome_measurement_t *measurement) {
+    if (measurement->is_signed) {
+        switch (measurement->size) {
+            case 1:
+                return measurement->value.sint8_val;
+            case 2:
+                return measurement->value.sint16_val;
+            case 4:
+                return measurement->value.sint32_val;
+        }
+    } else {
+        switch (measurement->size) {
+            case 1:
+                return measurement->value.uint8_val;
+            case 2:
+                return measurement->value.uint16_val;
+            case 3:
+            case 4:
+                return measurement->value.uint32_val;
+        }
     }
-    return 1.0f;
+    return 0;
 }
 
+#if CONFIG_BTHOME_OBJECT_STRINGS
 const char* bthome_get_object_name(uint8_t object_id) {
     if (object_id < sizeof(object_names) / sizeof(object_names[0])) {
         return object_names[object_id];
@@ -422,6 +524,22 @@ const char* bthome_get_object_unit_description(uint8_t object_id) {
     }
     return NULL;
 }
+#else
+const char* bthome_get_object_name(uint8_t object_id) {
+    (void)object_id;
+    return NULL;
+}
+
+const char* bthome_get_object_unit(uint8_t object_id) {
+    (void)object_id;
+    return NULL;
+}
+
+const char* bthome_get_object_unit_description(uint8_t object_id) {
+    (void)object_id;
+    return NULL;
+}
+#endif // CONFIG_BTHOME_OBJECT_STRINGS
 
 float bthome_get_scaled_value(const bthome_measurement_t *measurement, float factor) {
     if (measurement->is_signed) {
@@ -447,13 +565,203 @@ float bthome_get_scaled_value(const bthome_measurement_t *measurement, float fac
     return 0.0f;
 }
 
+size_t bthome_format_value(const bthome_measurement_t *measurement, char *buf, size_t cap) {
+    static const char hex_digits[] = "0123456789ABCDEF";
+    char text[BTHOME_VALUE_STR_LEN];
+    const char *out = text;
+    size_t len = 0;
+
+    if (measurement->object_id == BTHOME_SENSOR_TEXT && measurement->size == 0) {
+        out = (const char *)measurement->value.bytes_val.data;
+        len = measurement->value.bytes_val.len;
+    } else if (measurement->size == 0) {
+        // Raw data as hex, written straight to buf
+        len = 2 * measurement->value.bytes_val.len;
+        for (size_t i = 0; i < measurement->value.bytes_val.len && 2 * i + 2 < cap; i++) {
+            buf[2 * i] = hex_digits[measurement->value.bytes_val.data[i] >> 4];
+            buf[2 * i + 1] = hex_digits[measurement->value.bytes_val.data[i] & 0x0F];
+        }
+        out = NULL;
+    } else {
+        uint8_t multiplier, decimals;
+        bthome_get_decimal_scale(measurement->object_id, &multiplier, &decimals);
+        int64_t value = bthome_get_raw_value(measurement) * multiplier;
+        uint64_t magnitude = value < 0 ? -(uint64_t)value : (uint64_t)value;
+
+        // Build the digits backwards: fraction, point, integer part, sign
+        char reversed[BTHOME_VALUE_STR_LEN];
+        size_t n = 0;
+        for (uint8_t i = 0; i < decimals; i++) {
+            reversed[n++] = '0' + magnitude % 10;
+            magnitude /= 10;
+        }
+        if (decimals > 0) {
+            reversed[n++] = '.';
+        }
+        do {
+            reversed[n++] = '0' + magnitude % 10;
+            magnitude /= 10;
+        } while (magnitude != 0);
+        if (value < 0) {
+            reversed[n++] = '-';
+        }
+        while (n > 0) {
+            text[len++] = reversed[--n];
+        }
+    }
+
+    if (cap > 0) {
+        size_t copy = len < cap ? len : cap - 1;
+        if (out) {
+            memcpy(buf, out, copy);
+        } else {
+            copy -= copy % 2;  // Whole hex bytes only
+        }
+        buf[copy] = '\0';
+    }
+    return len;
+}
+
 // Packet management
 
+#if CONFIG_BTHOME_NO_HEAP
+// Static pool of fixed-size blocks for copied names, text and raw values. A bit per
+// block marks it used; bits are claimed and released atomically, as packets are copied
+// in the BLE stack's task and freed in the application's.
+#define POOL_WORDS ((CONFIG_BTHOME_POOL_BLOCKS + 31) / 32)
+
+static uint8_t pool[CONFIG_BTHOME_POOL_BLOCKS][CONFIG_BTHOME_MAX_DATA_LEN];
+static uint32_t pool_used[POOL_WORDS];
+
+static void *default_malloc(size_t size, void *ctx) {
+    (void)ctx;
+    if (size > CONFIG_BTHOME_MAX_DATA_LEN) {
+        return NULL;
+    }
+    for (size_t w = 0; w < POOL_WORDS; w++) {
+        uint32_t used = __atomic_load_n(&pool_used[w], __ATOMIC_RELAXED);
+        while (~used != 0) {
+            uint32_t bit = ~used & (used + 1);  // Lowest free block
+            size_t block = w * 32 + __builtin_ctz(bit);
+            if (block >= CONFIG_BTHOME_POOL_BLOCKS) {
+                break;
+            }
+            // On failure used is reloaded and the search repeated
+            if (__atomic_compare_exchange_n(&pool_used[w], &used, used | bit, false,
+                                            __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+                return pool[block];
+            }
+        }
+    }
+    return NULL;
+}
+
+static void *default_realloc(void *ptr, size_t size, void *ctx) {
+    (void)ctx;
+    return size <= CONFIG_BTHOME_MAX_DATA_LEN ? ptr : NULL;  // Blocks don't grow
+}
+
+static void default_free(void *ptr, void *ctx) {
+    (void)ctx;
+    size_t block = ((uint8_t *)ptr - pool[0]) / CONFIG_BTHOME_MAX_DATA_LEN;
+    __atomic_fetch_and(&pool_used[block / 32], ~((uint32_t)1 << (block % 32)), __ATOMIC_RELEASE);
+}
+#else
+static void *default_malloc(size_t size, void *ctx) {
+    (void)ctx;
+    return malloc(size);
+}
+
+static void *default_realloc(void *ptr, size_t size, void *ctx) {
+    (void)ctx;
+    return realloc(ptr, size);
+}
+
+static void default_free(void *ptr, void *ctx) {
+    (void)ctx;
+    free(ptr);
+}
+#endif
+
+static bthome_allocator_t allocator = {
+    .malloc_fn = default_malloc,
+    .realloc_fn = default_realloc,
+    .free_fn = default_free,
+    .ctx = NULL,
+};
+
+void bthome_set_allocator(const bthome_allocator_t *new_allocator) {
+    if (new_allocator) {
+        allocator = *new_allocator;
+    } else {
+        allocator.malloc_fn = default_malloc;
+        allocator.realloc_fn = default_realloc;
+        allocator.free_fn = default_free;
+        allocator.ctx = NULL;
+    }
+}
+
+void *bthome_malloc(size_t size) {
+    return allocator.malloc_fn(size, allocator.ctx);
+}
+
+void *bthome_realloc(void *ptr, size_t size) {
+    if (!ptr) {
+        return allocator.malloc_fn(size, allocator.ctx);
+    }
+    return allocator.realloc_fn(ptr, size, allocator.ctx);
+}
+
+void bthome_free(void *ptr) {
+    if (ptr) {
+        allocator.free_fn(ptr, allocator.ctx);
+    }
+}
+
+#if CONFIG_BTHOME_ENCODER || CONFIG_BTHOME_DECODER
+// Make room for one more measurement; returns the new slot (not yet counted), or NULL
+// if the packet is full or out of memory
+static bthome_measurement_t *append_measurement(bthome_packet_t *packet) {
+#if CONFIG_BTHOME_NO_HEAP
+    if (packet->measurement_count == CONFIG_BTHOME_MAX_MEASUREMENTS) {
+        return NULL;
+    }
+#else
+    size_t new_size = (packet->measurement_count + 1) * sizeof(bthome_measurement_t);
+    bthome_measurement_t *new_measurements = bthome_realloc(packet->measurements, new_size);
+    if (!new_measurements) {
+        return NULL;
+    }
+    packet->measurements = new_measurements;
+#endif
+    return &packet->measurements[packet->measurement_count];
+}
+
+// Make room for one more event, like append_measurement()
+static bthome_event_t *append_event(bthome_packet_t *packet) {
+#if CONFIG_BTHOME_NO_HEAP
+    if (packet->event_count == CONFIG_BTHOME_MAX_EVENTS) {
+        return NULL;
+    }
+#else
+    size_t new_size = (packet->event_count + 1) * sizeof(bthome_event_t);
+    bthome_event_t *new_events = bthome_realloc(packet->events, new_size);
+    if (!new_events) {
+        return NULL;
+    }
+    packet->events = new_events;
+#endif
+    return &packet->events[packet->event_count];
+}
+#endif
+
 void bthome_packet_init(bthome_packet_t *packet) {
     memset(packet, 0, sizeof(bthome_packet_t));
     packet->device_info.version = BTHOME_VERSION;
+#if !CONFIG_BTHOME_NO_HEAP
     packet->measurements = NULL;
     packet->events = NULL;
+#endif
     packet->measurement_count = 0;
     packet->event_count = 0;
     packet->has_packet_id = false;
@@ -461,36 +769,41 @@ void bthome_packet_init(bthome_packet_t *packet) {
     packet->device_name_len = 0;
     packet->use_complete_name = true;
     packet->owns_data = false;
+    packet->encoded.len = 0;
+}
+
+void bthome_packet_invalidate(bthome_packet_t *packet) {
+    packet->encoded.len = 0;
 }
 
 void bthome_packet_free(bthome_packet_t *packet) {
-    if (packet->measurements) {
-        // Free any dynamically allocated data in measurements (only if packet owns the data)
-        if (packet->owns_data) {
-            for (size_t i = 0; i < packet->measurement_count; i++) {
-                bthome_measurement_t *m = &packet->measurements[i];
-                if (m->size == 0 && m->value.bytes_val.data != NULL) {
-                    // Free copied text/raw data
-                    free((void*)m->value.bytes_val.data);
-                }
+    // Free any dynamically allocated data in measurements (only if packet owns the data)
+    if (packet->owns_data) {
+        for (size_t i = 0; i < packet->measurement_count; i++) {
+            bthome_measurement_t *m = &packet->measurements[i];
+            if (m->size == 0 && m->value.bytes_val.data != NULL) {
+                // Free copied text/raw data
+                bthome_free((void*)m->value.bytes_val.data);
             }
         }
-        free(packet->measurements);
-        packet->measurements = NULL;
     }
-    if (packet->events) {
-        free(packet->events);
-        packet->events = NULL;
-    }
-    if (packet->owns_data && packet->device_name != NULL) {
+#if !CONFIG_BTHOME_NO_HEAP
+    bthome_free(packet->measurements);
+    packet->measurements = NULL;
+    bthome_free(packet->events);
+    packet->events = NULL;
+#endif
+    if (packet->owns_data && !packet->name_shared && packet->device_name != NULL) {
         // Free copied device name (only if packet owns the data)
-        free((void*)packet->device_name);
+        bthome_free((void*)packet->device_name);
         packet->device_name = NULL;
     }
     packet->measurement_count = 0;
     packet->event_count = 0;
     packet->device_name_len = 0;
     packet->owns_data = false;
+    packet->name_shared = false;
+    packet->encoded.len = 0;
 }
 
 int bthome_packet_copy(bthome_packet_t *dest, const bthome_packet_t *src) {
@@ -504,9 +817,13 @@ int bthome_packet_copy(bthome_packet_t *dest, const bthome_packet_t *src) {
     dest->use_complete_name = src->use_complete_name;
     dest->owns_data = true;  // Destination owns all copied data
     
-    // Copy device name if present
-    if (src->device_name != NULL && src->device_name_len > 0) {
-        char *name_copy = malloc(src->device_name_len);
+    // Copy device name if present; shared names outlive both packets
+    if (src->name_shared) {
+        dest->device_name = src->device_name;
+        dest->device_name_len = src->device_name_len;
+        dest->name_shared = true;
+    } else if (src->device_name != NULL && src->device_name_len > 0) {
+        char *name_copy = bthome_malloc(src->device_name_len);
         if (!name_copy) {
             return -1;  // Out of memory
         }
@@ -517,18 +834,20 @@ int bthome_packet_copy(bthome_packet_t *dest, const bthome_packet_t *src) {
     
     // Copy measurements
     if (src->measurement_count > 0) {
-        dest->measurements = malloc(src->measurement_count * sizeof(bthome_measurement_t));
+#if !CONFIG_BTHOME_NO_HEAP
+        dest->measurements = bthome_malloc(src->measurement_count * sizeof(bthome_measurement_t));
         if (!dest->measurements) {
             bthome_packet_free(dest);
             return -1;  // Out of memory
         }
+#endif
         
         for (size_t i = 0; i < src->measurement_count; i++) {
             dest->measurements[i] = src->measurements[i];
             
             // Deep copy variable-length data (text, raw)
             if (src->measurements[i].size == 0 && src->measurements[i].value.bytes_val.len > 0) {
-                uint8_t *data_copy = malloc(src->measurements[i].value.bytes_val.len);
+                uint8_t *data_copy = bthome_malloc(src->measurements[i].value.bytes_val.len);
                 if (!data_copy) {
                     dest->measurement_count = i;  // Set count for proper cleanup
                     bthome_packet_free(dest);
@@ -544,11 +863,13 @@ int bthome_packet_copy(bthome_packet_t *dest, const bthome_packet_t *src) {
     
     // Copy events
     if (src->event_count > 0) {
-        dest->events = malloc(src->event_count * sizeof(bthome_event_t));
+#if !CONFIG_BTHOME_NO_HEAP
+        dest->events = bthome_malloc(src->event_count * sizeof(bthome_event_t));
         if (!dest->events) {
             bthome_packet_free(dest);
             return -1;  // Out of memory
         }
+#endif
         memcpy(dest->events, src->events, src->event_count * sizeof(bthome_event_t));
         dest->event_count = src->event_count;
     }
@@ -556,13 +877,19 @@ int bthome_packet_copy(bthome_packet_t *dest, const bthome_packet_t *src) {
     return 0;
 }
 
+#if CONFIG_BTHOME_ENCODER
 void bthome_set_device_info(bthome_packet_t *packet, bool encrypted, bool trigger_based) {
     packet->device_info.encrypted = encrypted;
     packet->device_info.trigger_based = trigger_based;
     packet->device_info.version = BTHOME_VERSION;
+    packet->encoded.len = 0;
 }
 
 void bthome_set_packet_id(bthome_packet_t *packet, uint8_t packet_id) {
+    // A new ID value is patched into the cached encoding; adding the ID changes the layout
+    if (!packet->has_packet_id) {
+        packet->encoded.len = 0;
+    }
     packet->packet_id = packet_id;
     packet->has_packet_id = true;
 }
@@ -574,24 +901,25 @@ int bthome_set_device_name(bthome_packet_t *packet, const char *name, size_t len
     packet->device_name = name;
     packet->device_name_len = len;
     packet->use_complete_name = complete;
+    packet->name_shared = false;
+    packet->encoded.len = 0;
     return 0;
 }
 
 // Add measurement helper
 static int add_measurement(bthome_packet_t *packet, uint8_t object_id, 
                           bthome_value_t value, bool is_signed, uint8_t size) {
-    size_t new_size = (packet->measurement_count + 1) * sizeof(bthome_measurement_t);
-    bthome_measurement_t *new_measurements = realloc(packet->measurements, new_size);
-    if (!new_measurements) {
-        return -1;  // Out of memory
+    bthome_measurement_t *m = append_measurement(packet);
+    if (!m) {
+        return -1;  // Out of memory, or the packet is full
     }
     
-    packet->measurements = new_measurements;
-    packet->measurements[packet->measurement_count].object_id = object_id;
-    packet->measurements[packet->measurement_count].value = value;
-    packet->measurements[packet->measurement_count].is_signed = is_signed;
-    packet->measurements[packet->measurement_count].size = size;
+    m->object_id = object_id;
+    m->value = value;
+    m->is_signed = is_signed;
+    m->size = size;
     packet->measurement_count++;
+    packet->encoded.len = 0;
     
     return 0;
 }
@@ -658,33 +986,31 @@ int bthome_add_sensor_raw(bthome_packet_t *packet, const uint8_t *data, size_t l
 }
 
 int bthome_add_button_event(bthome_packet_t *packet, bthome_button_event_t event) {
-    size_t new_size = (packet->event_count + 1) * sizeof(bthome_event_t);
-    bthome_event_t *new_events = realloc(packet->events, new_size);
-    if (!new_events) {
-        return -1;  // Out of memory
+    bthome_event_t *e = append_event(packet);
+    if (!e) {
+        return -1;  // Out of memory, or the packet is full
     }
     
-    packet->events = new_events;
-    packet->events[packet->event_count].event_type = BTHOME_EVENT_BUTTON;
-    packet->events[packet->event_count].event_value = event;
-    packet->events[packet->event_count].steps = 0;
+    e->event_type = BTHOME_EVENT_BUTTON;
+    e->event_value = event;
+    e->steps = 0;
     packet->event_count++;
+    packet->encoded.len = 0;
     
     return 0;
 }
 
 int bthome_add_dimmer_event(bthome_packet_t *packet, bthome_dimmer_event_t event, uint8_t steps) {
-    size_t new_size = (packet->event_count + 1) * sizeof(bthome_event_t);
-    bthome_event_t *new_events = realloc(packet->events, new_size);
-    if (!new_events) {
-        return -1;  // Out of memory
+    bthome_event_t *e = append_event(packet);
+    if (!e) {
+        return -1;  // Out of memory, or the packet is full
     }
     
-    packet->events = new_events;
-    packet->events[packet->event_count].event_type = BTHOME_EVENT_DIMMER;
-    packet->events[packet->event_count].event_value = event;
-    packet->events[packet->event_count].steps = steps;
+    e->event_type = BTHOME_EVENT_DIMMER;
+    e->event_value = event;
+    e->steps = steps;
     packet->event_count++;
+    packet->encoded.len = 0;
     
     return 0;
 }
@@ -792,8 +1118,22 @@ int bthome_encode(const bthome_packet_t *packet, uint8_t *buffer, size_t buffer_
     return offset;
 }
 
-int bthome_encode_advertisement(const bthome_packet_t *packet, uint8_t *buffer, 
-                                 size_t buffer_size, bool include_flags) {
+// Copy the cached advertisement with the current packet ID
+static int encode_from_cache(const bthome_packet_t *packet, uint8_t *buffer, size_t buffer_size) {
+    const bthome_encoded_adv_t *encoded = &packet->encoded;
+    if (encoded->len > buffer_size) {
+        return -1;
+    }
+    memcpy(buffer, encoded->data, encoded->len);
+    if (encoded->packet_id_offset >= 0) {
+        buffer[encoded->packet_id_offset] = packet->packet_id;
+    }
+    return encoded->len;
+}
+
+// Encode the advertisement; sets *packet_id_offset to where the packet ID value went, or -1
+static int encode_advertisement(const bthome_packet_t *packet, uint8_t *buffer, size_t buffer_size,
+                                bool include_flags, int8_t *packet_id_offset) {
     size_t offset = 0;
     
     // Add flags AD element
@@ -827,18 +1167,46 @@ int bthome_encode_advertisement(const bthome_packet_t *packet, uint8_t *buffer,
     // Write service data length (UUID + device info + data - excluding length and type bytes)
     buffer[service_data_len_offset] = service_data_len + 1;  // +1 for the type byte
     
+    // Packet ID value follows the UUID, device info and packet ID object ID
+    *packet_id_offset = packet->has_packet_id ? (int8_t)(offset + 4) : -1;
     return offset + service_data_len;
 }
 
+int bthome_encode_advertisement(const bthome_packet_t *packet, uint8_t *buffer, 
+                                 size_t buffer_size, bool include_flags) {
+    int8_t packet_id_offset;
+    return encode_advertisement(packet, buffer, buffer_size, include_flags, &packet_id_offset);
+}
+
+int bthome_encode_advertisement_cached(bthome_packet_t *packet, uint8_t *buffer,
+                                       size_t buffer_size, bool include_flags) {
+    bthome_encoded_adv_t *encoded = &packet->encoded;
+    if (encoded->len > 0 && encoded->include_flags == include_flags) {
+        return encode_from_cache(packet, buffer, buffer_size);
+    }
+
+    int8_t packet_id_offset;
+    int len = encode_advertisement(packet, buffer, buffer_size, include_flags, &packet_id_offset);
+    if (len > 0 && len <= BTHOME_ADV_MAX_LEN) {
+        memcpy(encoded->data, buffer, len);
+        encoded->len = len;
+        encoded->include_flags = include_flags;
+        encoded->packet_id_offset = packet_id_offset;
+    }
+    return len;
+}
+
+#endif // CONFIG_BTHOME_ENCODER
+
+#if CONFIG_BTHOME_DECODER
 // Decoding functions
 
-int bthome_decode(const uint8_t *data, size_t len, bthome_packet_t *packet) {
+// Decode service data, appending its objects to those already in packet
+static int decode_service_data(const uint8_t *data, size_t len, bthome_packet_t *packet) {
     if (len < 3) {
         return -1;  // Data too short
     }
     
-    bthome_packet_init(packet);
-    
     size_t offset = 0;
     
     // Read and verify UUID
@@ -864,6 +1232,7 @@ int bthome_decode(const uint8_t *data, size_t len, bthome_packet_t *packet) {
         uint8_t object_id = data[offset++];
         
         if (offset >= len) {
+            bthome_packet_free(packet);
             return -4;  // Incomplete data
         }
         
@@ -878,25 +1247,23 @@ int bthome_decode(const uint8_t *data, size_t len, bthome_packet_t *packet) {
         if (bthome_is_event(object_id)) {
             uint8_t event_value = data[offset++];
             
-            bthome_event_t *new_events = realloc(packet->events, 
-                                                  (packet->event_count + 1) * sizeof(bthome_event_t));
-            if (!new_events) {
+            bthome_event_t *e = append_event(packet);
+            if (!e) {
                 bthome_packet_free(packet);
-                return -5;  // Out of memory
+                return -5;  // Out of memory, or too many events
             }
             
-            packet->events = new_events;
-            packet->events[packet->event_count].event_type = object_id;
-            packet->events[packet->event_count].event_value = event_value;
+            e->event_type = object_id;
+            e->event_value = event_value;
             
             if (object_id == BTHOME_EVENT_DIMMER && event_value != BTHOME_DIMMER_NONE) {
                 if (offset >= len) {
                     bthome_packet_free(packet);
                     return -4;
                 }
-                packet->events[packet->event_count].steps = data[offset++];
+                e->steps = data[offset++];
             } else {
-                packet->events[packet->event_count].steps = 0;
+                e->steps = 0;
             }
             
             packet->event_count++;
@@ -920,67 +1287,29 @@ int bthome_decode(const uint8_t *data, size_t len, bthome_packet_t *packet) {
             return -4;  // Incomplete data
         }
         
-        bthome_measurement_t *new_measurements = realloc(packet->measurements,
-                                                         (packet->measurement_count + 1) * sizeof(bthome_measurement_t));
-        if (!new_measurements) {
+        bthome_measurement_t *m = append_measurement(packet);
+        if (!m) {
             bthome_packet_free(packet);
-            return -5;  // Out of memory
+            return -5;  // Out of memory, or too many measurements
         }
         
-        packet->measurements = new_measurements;
-        bthome_measurement_t *m = &packet->measurements[packet->measurement_count];
         m->object_id = object_id;
         m->size = size;
         
         // Determine if signed based on object ID
-        bool is_signed = (object_id == 0x02 || object_id == 0x08 || 
-                         object_id == 0x3F || object_id == 0x45 ||
-                         (object_id >= 0x57 && object_id <= 0x5D));
+        bool is_signed = bthome_is_signed(object_id);
         m->is_signed = is_signed;
         
         // Variable length data
         if (object_id == BTHOME_SENSOR_TEXT || object_id == BTHOME_SENSOR_RAW) {
+            m->size = 0;  // Variable length, as for bthome_add_sensor_text()/bthome_add_sensor_raw()
             m->value.bytes_val.data = data + offset;
             m->value.bytes_val.len = size;
-            offset += size;
         } else {
             // Fixed length data
-            if (is_signed) {
-                switch (size) {
-                    case 1:
-                        m->value.sint8_val = (int8_t)data[offset];
-                        offset++;
-                        break;
-                    case 2:
-                        m->value.sint16_val = read_sint16_le(data + offset);
-                        offset += 2;
-                        break;
-                    case 4:
-                        m->value.sint32_val = read_sint32_le(data + offset);
-                        offset += 4;
-                        break;
-                }
-            } else {
-                switch (size) {
-                    case 1:
-                        m->value.uint8_val = data[offset];
-                        offset++;
-                        break;
-                    case 2:
-                        m->value.uint16_val = read_uint16_le(data + offset);
-                        offset += 2;
-                        break;
-                    case 3:
-                        m->value.uint32_val = read_uint24_le(data + offset);
-                        offset += 3;
-                        break;
-                    case 4:
-                        m->value.uint32_val = read_uint32_le(data + offset);
-                        offset += 4;
-                        break;
-                }
-            }
+            bthome_read_value(data + offset, size, is_signed, &m->value);
         }
+        offset += size;
         
         packet->measurement_count++;
     }
@@ -988,12 +1317,20 @@ int bthome_decode(const uint8_t *data, size_t len, bthome_packet_t *packet) {
     return 0;
 }
 
+int bthome_decode(const uint8_t *data, size_t len, bthome_packet_t *packet) {
+    bthome_packet_init(packet);
+    return decode_service_data(data, len, packet);
+}
+
 int bthome_decode_advertisement(const uint8_t *data, size_t len, bthome_packet_t *packet) {
     size_t offset = 0;
     bool found_service_data = false;
     
+    bthome_packet_init(packet);
+    
     while (offset < len) {
         if (offset + 2 > len) {
+            bthome_packet_free(packet);
             return -1;  // Invalid AD structure
         }
         
@@ -1003,16 +1340,19 @@ int bthome_decode_advertisement(const uint8_t *data, size_t len, bthome_packet_t
         }
         
         if (offset + ad_len > len) {
+            bthome_packet_free(packet);
             return -1;  // AD element extends beyond data
         }
         
         uint8_t ad_type = data[offset++];
         ad_len--;  // Subtract type byte from length
         
-        // Look for Service Data - 16-bit UUID
-        if (ad_type == 0x16) {
-            int result = bthome_decode(data + offset, ad_len, packet);
+        // Look for Service Data - 16-bit UUID. An advertisement merged with its scan
+        // response may carry several; their objects are combined into one packet.
+        if (ad_type == 0x16 && ad_len >= 2 && read_uint16_le(data + offset) == BTHOME_UUID_LE) {
+            int result = decode_service_data(data + offset, ad_len, packet);
             if (result < 0) {
+                bthome_packet_free(packet);
                 return result;
             }
             found_service_data = true;
@@ -1033,3 +1373,4 @@ int bthome_decode_advertisement(const uint8_t *data, size_t len, bthome_packet_t
     
     return 0;
 }
+#endif // CONFIG_BTHOME_DECODER
@@ -1,23 +1,170 @@
 #include "bthome_ble.h"
 #include "bthome.h"
+#include "bthome_scanner_core.h"
+#include "bthome_internal.h"
 #include "esp_log.h"
 #include "esp_bt.h"
 #include "esp_bt_main.h"
 #include "esp_gap_ble_api.h"
+#include "esp_timer.h"
+#include "nvs.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "freertos/event_groups.h"
+#include <stdlib.h>
 #include <string.h>
 
 static const char *TAG = "bthome_ble";
 
+#if CONFIG_BTHOME_BLE_SCANNER
+// Batch dispatch task parameters
+#define DISPATCH_TASK_STACK_SIZE 4096
+#define DISPATCH_TASK_PRIORITY   5
+
+// How often the adaptive scan scheduler is re-evaluated
+#define SCAN_SCHED_PERIOD_MS 1000
+
+// Asynchronous init task parameters
+#define INIT_TASK_STACK_SIZE 4096
+#define INIT_TASK_PRIORITY   5
+
+// Entries passed from the GAP handler to the dispatch task or poller
+typedef enum {
+    QUEUE_ITEM_PACKET,  // A received packet
+    QUEUE_ITEM_FLUSH,   // Deliver the pending batch now
+    QUEUE_ITEM_EXIT,    // Deliver the pending batch and stop the dispatch task
+} queue_item_kind_t;
+
+typedef struct {
+    queue_item_kind_t kind;
+    bthome_ble_scan_result_t result;
+} queue_item_t;
+
+// Checkpoint blob stored in NVS; the device cache holds no pointers, so it is saved as-is
+#define CHECKPOINT_KEY     "scanner"
+#define CHECKPOINT_VERSION 2
+
+typedef struct {
+    uint32_t version;
+    uint32_t size;                     // sizeof(bthome_device_cache_t) when written
+    bthome_device_cache_t cache;
+} checkpoint_blob_t;
+
+// Advertisements held during an active scan until their scan response arrives
+#define PENDING_MERGE_SLOTS 8
+
+typedef struct {
+    bool used;
+    esp_bd_addr_t addr;
+    int rssi;
+    int64_t received_us;               // esp_timer time the advertisement was received
+    uint8_t len;
+    uint8_t data[ESP_BLE_ADV_DATA_LEN_MAX];
+} pending_adv_t;
+
 // Scanner state
 static struct {
     bool initialized;
     bool scanning;
     bthome_ble_scanner_config_t config;
+    QueueHandle_t queue;               // Batched/polled delivery queue
+    TaskHandle_t dispatch_task;        // Batch dispatch task
+    volatile uint32_t dropped;         // Packets dropped because the queue was full
+    bool merging;                      // Join advertisements with their scan responses
+    pending_adv_t pending[PENDING_MERGE_SLOTS];
+    bthome_scanner_core_t core;        // Filter, device cache (valid until deinit) and scan scheduler
+    SemaphoreHandle_t core_lock;       // Guards core against the application and the timers
+    bool checkpointing;                // Save core.device_cache to NVS
+    volatile bool checkpoint_dirty;    // core.device_cache changed since the last checkpoint
+    char nvs_namespace[16];
+    esp_timer_handle_t checkpoint_timer;
+    esp_ble_scan_params_t scan_params;  // Parameters handed to the stack
+    esp_timer_handle_t sched_timer;
+    volatile bool rescheduling;        // Scan stopped to apply new parameters, restart it
+    bool timing;                       // Record latency histograms
+    bthome_ble_latency_stats_t latency; // Each histogram has a single writer; read without locking
 } scanner_state = {0};
+#endif // CONFIG_BTHOME_BLE_SCANNER
+
+#if CONFIG_BTHOME_BLE_ADVERTISER
+// Advertiser state
+static struct {
+    bool initialized;
+    bool advertising;
+    bool start_pending;                // Start advertising once the data has been set
+    bthome_ble_advertiser_config_t config;
+    esp_ble_adv_params_t adv_params;
+    uint8_t packet_id;                 // Last packet ID sent when auto_packet_id is set
+    uint8_t adv_data[ESP_BLE_ADV_DATA_LEN_MAX]; // Encoded advertisement handed to the stack
+    bthome_packet_t packet;            // Copy of the packet being broadcast, with its cached encoding
+} advertiser_state = {0};
+#endif // CONFIG_BTHOME_BLE_ADVERTISER
+
+// Number of initialized scanner/advertiser users of the BLE stack
+static uint8_t ble_stack_users = 0;
+
+// When each init stage completed
+static bthome_ble_boot_timing_t boot_timing = {0};
+
+#if CONFIG_BTHOME_BLE_SCANNER
+// Scanner readiness (BTHOME_BLE_EVENT_* bits); created on first use and never deleted,
+// so waiters stay valid across deinit
+static EventGroupHandle_t scanner_events = NULL;
+
+// Serializes checkpoint saves (timer, bthome_ble_scanner_checkpoint_now() and deinit),
+// so an older snapshot can't be written after a newer one; never deleted
+static SemaphoreHandle_t checkpoint_lock = NULL;
+
+// Asynchronous init request, copied so the caller's structures needn't outlive the call
+static struct {
+    volatile bool in_progress;         // Set before the init task is created, cleared by it when done
+    bool has_checkpoint;
+    bthome_ble_checkpoint_config_t checkpoint;
+    char nvs_namespace[16];
+    bool has_config;
+    bthome_ble_scanner_config_t config;
+#if CONFIG_BTHOME_NO_HEAP
+    TaskHandle_t finished;             // Suspended init task still to be deleted
+#endif
+} init_request = {0};
+
+#if CONFIG_BTHOME_NO_HEAP
+// Static storage for everything the scanner would otherwise allocate
+static StaticQueue_t queue_buffer;
+static uint8_t queue_storage[CONFIG_BTHOME_BLE_MAX_QUEUE_LENGTH * sizeof(queue_item_t)];
+static bthome_ble_scan_result_t batch_storage[CONFIG_BTHOME_BLE_MAX_BATCH_SIZE];
+static StaticTask_t dispatch_task_buffer;
+static StackType_t dispatch_task_stack[DISPATCH_TASK_STACK_SIZE];
+static StaticTask_t init_task_buffer;
+static StackType_t init_task_stack[INIT_TASK_STACK_SIZE];
+static StaticSemaphore_t core_lock_buffer;
+static StaticEventGroup_t scanner_events_buffer;
+static StaticSemaphore_t checkpoint_lock_buffer;
+static checkpoint_blob_t checkpoint_blob;
+
+// A task deleting itself is only cleaned up later by the idle task, and its static
+// memory must not be reused before then. Static tasks therefore suspend themselves
+// when done and are deleted here, which takes effect at once.
+static void delete_finished_task(TaskHandle_t task) {
+    while (eTaskGetState(task) != eSuspended) {
+        vTaskDelay(1);
+    }
+    vTaskDelete(task);
+}
+
+// End the calling task, to be deleted with delete_finished_task()
+#define END_TASK() vTaskSuspend(NULL)
+#else
+#define END_TASK() vTaskDelete(NULL)
+#endif
+#endif // CONFIG_BTHOME_BLE_SCANNER
 
 // Forward declarations
 static void gap_event_handler(esp_gap_ble_cb_event_t event, esp_ble_gap_cb_param_t *param);
 
+#if CONFIG_BTHOME_BLE_SCANNER
 void bthome_ble_scanner_get_default_config(bthome_ble_scanner_config_t *config) {
     config->scan_duration = 0;  // Continuous
     config->scan_type = BLE_SCAN_TYPE_PASSIVE;
@@ -27,11 +174,194 @@ void bthome_ble_scanner_get_default_config(bthome_ble_scanner_config_t *config)
     config->scan_window = 0x30;    // 30ms
     config->callback = NULL;
     config->user_data = NULL;
+    config->delivery_mode = BTHOME_BLE_DELIVERY_CALLBACK;
+    config->batch_callback = NULL;
+#if CONFIG_BTHOME_NO_HEAP
+    config->batch_size = CONFIG_BTHOME_BLE_MAX_BATCH_SIZE < 16 ? CONFIG_BTHOME_BLE_MAX_BATCH_SIZE : 16;
+    config->batch_timeout_ms = 1000;
+    config->queue_length = CONFIG_BTHOME_BLE_MAX_QUEUE_LENGTH < 32 ? CONFIG_BTHOME_BLE_MAX_QUEUE_LENGTH : 32;
+#else
+    config->batch_size = 16;
+    config->batch_timeout_ms = 1000;
+    config->queue_length = 32;
+#endif
+    config->filter = NULL;
+    config->scan_response_window_ms = 100;
+    config->intern_names = true;
+    config->adaptive = false;
+    config->collect_latency = false;
+    bthome_scan_sched_get_default_config(&config->adaptive_config);
 }
 
-esp_err_t bthome_ble_scanner_init(void) {
-    if (scanner_state.initialized) {
-        ESP_LOGW(TAG, "Scanner already initialized");
+static void free_queued_results(void) {
+    queue_item_t item;
+    while (xQueueReceive(scanner_state.queue, &item, 0) == pdTRUE) {
+        if (item.kind == QUEUE_ITEM_PACKET) {
+            bthome_packet_free(&item.result.packet);
+        }
+    }
+}
+
+// Note the first packet handed to the application, whichever way it is delivered
+static void record_first_delivery(void) {
+    if (boot_timing.first_packet_us == 0) {
+        boot_timing.first_packet_us = esp_timer_get_time();
+        xEventGroupSetBits(scanner_events, BTHOME_BLE_EVENT_FIRST_PACKET);
+        ESP_LOGI(TAG, "First BTHome packet delivered %lld us after init started",
+                 (long long)(boot_timing.first_packet_us - boot_timing.init_start_us));
+    }
+}
+
+static void deliver_batch(bthome_ble_scan_result_t *batch, size_t count) {
+    if (count == 0) {
+        return;
+    }
+    record_first_delivery();
+    int64_t start_us = scanner_state.timing ? esp_timer_get_time() : 0;
+    scanner_state.config.batch_callback(batch, count, scanner_state.config.user_data);
+    if (scanner_state.timing) {
+        bthome_histogram_record(&scanner_state.latency.callback, esp_timer_get_time() - start_us);
+    }
+    for (size_t i = 0; i < count; i++) {
+        bthome_packet_free(&batch[i].packet);
+    }
+}
+
+// Collects packets from the queue and delivers them every batch_size packets
+// or batch_timeout_ms after the first pending packet, whichever comes first
+static void dispatch_task(void *arg) {
+    bthome_ble_scan_result_t *batch = arg;
+    size_t count = 0;
+    TickType_t batch_start = 0;
+    TickType_t batch_timeout = pdMS_TO_TICKS(scanner_state.config.batch_timeout_ms);
+    queue_item_t item;
+
+    while (true) {
+        TickType_t wait = portMAX_DELAY;
+        if (count > 0) {
+            TickType_t elapsed = xTaskGetTickCount() - batch_start;
+            wait = elapsed < batch_timeout ? batch_timeout - elapsed : 0;
+        }
+
+        if (xQueueReceive(scanner_state.queue, &item, wait) != pdTRUE) {
+            // Timed out waiting for the batch to fill
+            deliver_batch(batch, count);
+            count = 0;
+            continue;
+        }
+
+        if (item.kind == QUEUE_ITEM_PACKET) {
+            if (count == 0) {
+                batch_start = xTaskGetTickCount();
+            }
+            batch[count++] = item.result;
+            if (count < scanner_state.config.batch_size) {
+                continue;
+            }
+        }
+
+        deliver_batch(batch, count);
+        count = 0;
+
+        if (item.kind == QUEUE_ITEM_EXIT) {
+            break;
+        }
+    }
+
+#if !CONFIG_BTHOME_NO_HEAP
+    bthome_free(batch);
+#endif
+    scanner_state.dispatch_task = NULL;
+    END_TASK();
+}
+
+static void delivery_teardown(void) {
+    if (scanner_state.dispatch_task) {
+#if CONFIG_BTHOME_NO_HEAP
+        TaskHandle_t task = scanner_state.dispatch_task;
+#endif
+        queue_item_t item = { .kind = QUEUE_ITEM_EXIT };
+        xQueueSend(scanner_state.queue, &item, portMAX_DELAY);
+        while (scanner_state.dispatch_task) {
+            vTaskDelay(1);
+        }
+#if CONFIG_BTHOME_NO_HEAP
+        delete_finished_task(task);
+#endif
+    }
+    if (scanner_state.queue) {
+        free_queued_results();
+        vQueueDelete(scanner_state.queue);
+        scanner_state.queue = NULL;
+    }
+}
+
+static esp_err_t delivery_setup(const bthome_ble_scanner_config_t *config) {
+    if (config->delivery_mode == BTHOME_BLE_DELIVERY_CALLBACK) {
+        return ESP_OK;
+    }
+
+#if CONFIG_BTHOME_NO_HEAP
+    scanner_state.queue = xQueueCreateStatic(config->queue_length, sizeof(queue_item_t),
+                                             queue_storage, &queue_buffer);
+#else
+    scanner_state.queue = xQueueCreate(config->queue_length, sizeof(queue_item_t));
+#endif
+    if (!scanner_state.queue) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    if (config->delivery_mode == BTHOME_BLE_DELIVERY_BATCH) {
+#if CONFIG_BTHOME_NO_HEAP
+        scanner_state.dispatch_task = xTaskCreateStatic(dispatch_task, "bthome_dispatch",
+                                                        DISPATCH_TASK_STACK_SIZE, batch_storage,
+                                                        DISPATCH_TASK_PRIORITY, dispatch_task_stack,
+                                                        &dispatch_task_buffer);
+#else
+        bthome_ble_scan_result_t *batch = bthome_malloc(config->batch_size * sizeof(bthome_ble_scan_result_t));
+        if (!batch) {
+            delivery_teardown();
+            return ESP_ERR_NO_MEM;
+        }
+        if (xTaskCreate(dispatch_task, "bthome_dispatch", DISPATCH_TASK_STACK_SIZE, batch,
+                        DISPATCH_TASK_PRIORITY, &scanner_state.dispatch_task) != pdPASS) {
+            bthome_free(batch);
+            delivery_teardown();
+            return ESP_ERR_NO_MEM;
+        }
+#endif
+    }
+
+    return ESP_OK;
+}
+
+int bthome_ble_scanner_poll(bthome_ble_scan_result_t *out, size_t max, uint32_t timeout_ms) {
+    if (!scanner_state.queue || scanner_state.config.delivery_mode != BTHOME_BLE_DELIVERY_POLL) {
+        return -1;  // Polling not enabled
+    }
+
+    size_t count = 0;
+    TickType_t wait = pdMS_TO_TICKS(timeout_ms);
+    queue_item_t item;
+    while (count < max && xQueueReceive(scanner_state.queue, &item, wait) == pdTRUE) {
+        out[count++] = item.result;
+        wait = 0;
+    }
+    if (count > 0) {
+        record_first_delivery();
+    }
+    return count;
+}
+
+uint32_t bthome_ble_scanner_get_dropped_count(void) {
+    return scanner_state.dropped;
+}
+
+#endif // CONFIG_BTHOME_BLE_SCANNER
+
+// Bring up the controller and Bluedroid for the first user (scanner or advertiser)
+static esp_err_t ble_stack_acquire(void) {
+    if (ble_stack_users++ > 0) {
         return ESP_OK;
     }
 
@@ -48,16 +378,18 @@ esp_err_t bthome_ble_scanner_init(void) {
     ret = esp_bt_controller_init(&bt_cfg);
     if (ret != ESP_OK) {
         ESP_LOGE(TAG, "Failed to initialize BT controller: %s", esp_err_to_name(ret));
-        return ret;
+        goto fail;
     }
+    boot_timing.controller_init_us = esp_timer_get_time();
 
     // Enable BT controller in BLE mode
     ret = esp_bt_controller_enable(ESP_BT_MODE_BLE);
     if (ret != ESP_OK) {
         ESP_LOGE(TAG, "Failed to enable BT controller: %s", esp_err_to_name(ret));
         esp_bt_controller_deinit();
-        return ret;
+        goto fail;
     }
+    boot_timing.controller_enable_us = esp_timer_get_time();
 
     // Initialize Bluedroid
     ret = esp_bluedroid_init();
@@ -65,8 +397,9 @@ esp_err_t bthome_ble_scanner_init(void) {
         ESP_LOGE(TAG, "Failed to initialize Bluedroid: %s", esp_err_to_name(ret));
         esp_bt_controller_disable();
         esp_bt_controller_deinit();
-        return ret;
+        goto fail;
     }
+    boot_timing.bluedroid_init_us = esp_timer_get_time();
 
     // Enable Bluedroid
     ret = esp_bluedroid_enable();
@@ -75,8 +408,9 @@ esp_err_t bthome_ble_scanner_init(void) {
         esp_bluedroid_deinit();
         esp_bt_controller_disable();
         esp_bt_controller_deinit();
-        return ret;
+        goto fail;
     }
+    boot_timing.bluedroid_enable_us = esp_timer_get_time();
 
     // Register GAP callback
     ret = esp_ble_gap_register_callback(gap_event_handler);
@@ -86,16 +420,334 @@ esp_err_t bthome_ble_scanner_init(void) {
         esp_bluedroid_deinit();
         esp_bt_controller_disable();
         esp_bt_controller_deinit();
-        return ret;
+        goto fail;
+    }
+    boot_timing.gap_register_us = esp_timer_get_time();
+
+    return ESP_OK;
+
+fail:
+    ble_stack_users = 0;
+    return ret;
+}
+
+// Shut down the controller and Bluedroid once the last user is gone
+static void ble_stack_release(void) {
+    if (ble_stack_users == 0 || --ble_stack_users > 0) {
+        return;
+    }
+
+    esp_bluedroid_disable();
+    esp_bluedroid_deinit();
+    esp_bt_controller_disable();
+    esp_bt_controller_deinit();
+}
+
+#if CONFIG_BTHOME_BLE_SCANNER
+void bthome_ble_checkpoint_get_default_config(bthome_ble_checkpoint_config_t *config) {
+    config->nvs_namespace = "bthome";
+    config->interval_ms = 10 * 60 * 1000;  // 10 minutes
+}
+
+// Load the device cache from NVS; leaves it empty if there is no usable checkpoint
+static void checkpoint_restore(void) {
+    nvs_handle_t handle;
+    if (nvs_open(scanner_state.nvs_namespace, NVS_READONLY, &handle) != ESP_OK) {
+        return;  // Nothing saved yet
+    }
+
+#if CONFIG_BTHOME_NO_HEAP
+    checkpoint_blob_t *blob = &checkpoint_blob;  // No timer or application save runs yet
+#else
+    checkpoint_blob_t *blob = bthome_malloc(sizeof(checkpoint_blob_t));
+#endif
+    size_t len = sizeof(checkpoint_blob_t);
+    if (blob && nvs_get_blob(handle, CHECKPOINT_KEY, blob, &len) == ESP_OK &&
+        len == sizeof(checkpoint_blob_t) && blob->version == CHECKPOINT_VERSION &&
+        blob->size == sizeof(bthome_device_cache_t)) {
+        memcpy(&scanner_state.core.device_cache, &blob->cache, sizeof(bthome_device_cache_t));
+        ESP_LOGI(TAG, "Restored %u interned names from checkpoint",
+                 (unsigned)scanner_state.core.device_cache.name_count);
+    }
+#if !CONFIG_BTHOME_NO_HEAP
+    bthome_free(blob);
+#endif
+    nvs_close(handle);
+}
+
+// Write the device cache to NVS if it changed since the last write
+static esp_err_t checkpoint_save(void) {
+    // Held from the snapshot through the write
+    xSemaphoreTake(checkpoint_lock, portMAX_DELAY);
+    if (!scanner_state.checkpoint_dirty) {
+        xSemaphoreGive(checkpoint_lock);
+        return ESP_OK;
+    }
+
+#if CONFIG_BTHOME_NO_HEAP
+    checkpoint_blob_t *blob = &checkpoint_blob;
+#else
+    checkpoint_blob_t *blob = bthome_malloc(sizeof(checkpoint_blob_t));
+    if (!blob) {
+        xSemaphoreGive(checkpoint_lock);
+        return ESP_ERR_NO_MEM;
+    }
+#endif
+    blob->version = CHECKPOINT_VERSION;
+    blob->size = sizeof(bthome_device_cache_t);
+
+    // Snapshot under the lock, then write without holding up the GAP handler
+    xSemaphoreTake(scanner_state.core_lock, portMAX_DELAY);
+    memcpy(&blob->cache, &scanner_state.core.device_cache, sizeof(bthome_device_cache_t));
+    scanner_state.checkpoint_dirty = false;
+    xSemaphoreGive(scanner_state.core_lock);
+
+    nvs_handle_t handle;
+    esp_err_t ret = nvs_open(scanner_state.nvs_namespace, NVS_READWRITE, &handle);
+    if (ret == ESP_OK) {
+        ret = nvs_set_blob(handle, CHECKPOINT_KEY, blob, sizeof(checkpoint_blob_t));
+        if (ret == ESP_OK) {
+            ret = nvs_commit(handle);
+        }
+        nvs_close(handle);
+    }
+#if !CONFIG_BTHOME_NO_HEAP
+    bthome_free(blob);
+#endif
+
+    if (ret != ESP_OK) {
+        ESP_LOGW(TAG, "Failed to write checkpoint: %s", esp_err_to_name(ret));
+        scanner_state.checkpoint_dirty = true;  // Retry next interval
+    }
+    xSemaphoreGive(checkpoint_lock);
+    return ret;
+}
+
+static void checkpoint_timer_callback(void *arg) {
+    checkpoint_save();
+}
+
+// Create the event group on first use
+static esp_err_t ensure_scanner_events(void) {
+    if (!scanner_events) {
+#if CONFIG_BTHOME_NO_HEAP
+        scanner_events = xEventGroupCreateStatic(&scanner_events_buffer);
+#else
+        scanner_events = xEventGroupCreate();
+#endif
+    }
+    return scanner_events ? ESP_OK : ESP_ERR_NO_MEM;
+}
+
+EventGroupHandle_t bthome_ble_scanner_get_event_group(void) {
+    ensure_scanner_events();
+    return scanner_events;
+}
+
+void bthome_ble_scanner_get_boot_timing(bthome_ble_boot_timing_t *timing) {
+    *timing = boot_timing;
+}
+
+esp_err_t bthome_ble_scanner_init(void) {
+    return bthome_ble_scanner_init_with_checkpoint(NULL);
+}
+
+esp_err_t bthome_ble_scanner_init_with_checkpoint(const bthome_ble_checkpoint_config_t *checkpoint) {
+    if (scanner_state.initialized) {
+        ESP_LOGW(TAG, "Scanner already initialized");
+        return ESP_OK;
+    }
+
+    if (ensure_scanner_events() != ESP_OK) {
+        return ESP_ERR_NO_MEM;
+    }
+    xEventGroupClearBits(scanner_events, BTHOME_BLE_EVENT_READY | BTHOME_BLE_EVENT_SCANNING |
+                                         BTHOME_BLE_EVENT_FAILED | BTHOME_BLE_EVENT_FIRST_PACKET);
+    memset(&boot_timing, 0, sizeof(boot_timing));
+    boot_timing.init_start_us = esp_timer_get_time();
+
+    if (checkpoint && (!checkpoint->nvs_namespace || checkpoint->interval_ms == 0 ||
+                       strlen(checkpoint->nvs_namespace) >= sizeof(scanner_state.nvs_namespace))) {
+        ESP_LOGE(TAG, "Invalid checkpoint configuration");
+        return ESP_ERR_INVALID_ARG;
+    }
+
+#if CONFIG_BTHOME_NO_HEAP
+    scanner_state.core_lock = xSemaphoreCreateMutexStatic(&core_lock_buffer);
+#else
+    scanner_state.core_lock = xSemaphoreCreateMutex();
+#endif
+    if (!scanner_state.core_lock) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    bthome_scanner_core_init(&scanner_state.core);
+    scanner_state.checkpointing = checkpoint != NULL;
+    scanner_state.checkpoint_dirty = false;
+
+    esp_err_t ret;
+    if (checkpoint) {
+        if (!checkpoint_lock) {
+#if CONFIG_BTHOME_NO_HEAP
+            checkpoint_lock = xSemaphoreCreateMutexStatic(&checkpoint_lock_buffer);
+#else
+            checkpoint_lock = xSemaphoreCreateMutex();
+#endif
+        }
+        if (!checkpoint_lock) {
+            ret = ESP_ERR_NO_MEM;
+            goto fail;
+        }
+        strcpy(scanner_state.nvs_namespace, checkpoint->nvs_namespace);
+        checkpoint_restore();
+
+        const esp_timer_create_args_t timer_args = {
+            .callback = checkpoint_timer_callback,
+            .name = "bthome_checkpoint",
+        };
+        ret = esp_timer_create(&timer_args, &scanner_state.checkpoint_timer);
+        if (ret == ESP_OK) {
+            ret = esp_timer_start_periodic(scanner_state.checkpoint_timer,
+                                           (uint64_t)checkpoint->interval_ms * 1000);
+        }
+        if (ret != ESP_OK) {
+            ESP_LOGE(TAG, "Failed to start checkpoint timer: %s", esp_err_to_name(ret));
+            goto fail;
+        }
+    }
+
+    ret = ble_stack_acquire();
+    if (ret != ESP_OK) {
+        goto fail;
     }
 
     scanner_state.initialized = true;
     scanner_state.scanning = false;
-    ESP_LOGI(TAG, "BTHome BLE scanner initialized");
+    boot_timing.init_done_us = esp_timer_get_time();
+    xEventGroupSetBits(scanner_events, BTHOME_BLE_EVENT_READY);
+    ESP_LOGI(TAG, "BTHome BLE scanner initialized in %lld us",
+             (long long)(boot_timing.init_done_us - boot_timing.init_start_us));
+
+    return ESP_OK;
+
+fail:
+    if (scanner_state.checkpoint_timer) {
+        esp_timer_stop(scanner_state.checkpoint_timer);
+        esp_timer_delete(scanner_state.checkpoint_timer);
+        scanner_state.checkpoint_timer = NULL;
+    }
+    scanner_state.checkpointing = false;
+    vSemaphoreDelete(scanner_state.core_lock);
+    scanner_state.core_lock = NULL;
+    return ret;
+}
+
+static void init_task(void *arg) {
+    esp_err_t ret = bthome_ble_scanner_init_with_checkpoint(
+        init_request.has_checkpoint ? &init_request.checkpoint : NULL);
+    if (ret == ESP_OK && init_request.has_config) {
+        ret = bthome_ble_scanner_start(&init_request.config);
+    }
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Asynchronous init failed: %s", esp_err_to_name(ret));
+        xEventGroupSetBits(scanner_events, BTHOME_BLE_EVENT_FAILED);
+    }
+
+    init_request.in_progress = false;
+    END_TASK();
+}
+
+esp_err_t bthome_ble_scanner_init_async(const bthome_ble_checkpoint_config_t *checkpoint,
+                                        const bthome_ble_scanner_config_t *config) {
+    if (init_request.in_progress) {
+        ESP_LOGE(TAG, "Asynchronous init already in progress");
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    esp_err_t ret = ensure_scanner_events();
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    xEventGroupClearBits(scanner_events, BTHOME_BLE_EVENT_FAILED);
+
+    init_request.has_checkpoint = checkpoint != NULL;
+    if (checkpoint) {
+        if (!checkpoint->nvs_namespace ||
+            strlen(checkpoint->nvs_namespace) >= sizeof(init_request.nvs_namespace)) {
+            ESP_LOGE(TAG, "Invalid checkpoint configuration");
+            return ESP_ERR_INVALID_ARG;
+        }
+        init_request.checkpoint = *checkpoint;
+        strcpy(init_request.nvs_namespace, checkpoint->nvs_namespace);
+        init_request.checkpoint.nvs_namespace = init_request.nvs_namespace;
+    }
+    init_request.has_config = config != NULL;
+    if (config) {
+        init_request.config = *config;
+    }
 
+    // The task may finish before the create call returns, so it can't be tracked by its handle
+    init_request.in_progress = true;
+#if CONFIG_BTHOME_NO_HEAP
+    if (init_request.finished) {
+        delete_finished_task(init_request.finished);
+    }
+    init_request.finished = xTaskCreateStatic(init_task, "bthome_init", INIT_TASK_STACK_SIZE, NULL,
+                                              INIT_TASK_PRIORITY, init_task_stack, &init_task_buffer);
+#else
+    if (xTaskCreate(init_task, "bthome_init", INIT_TASK_STACK_SIZE, NULL, INIT_TASK_PRIORITY,
+                    NULL) != pdPASS) {
+        init_request.in_progress = false;
+        return ESP_ERR_NO_MEM;
+    }
+#endif
     return ESP_OK;
 }
 
+void bthome_ble_scanner_get_latency_stats(bthome_ble_latency_stats_t *stats) {
+    memcpy(stats, &scanner_state.latency, sizeof(bthome_ble_latency_stats_t));
+}
+
+void bthome_ble_scanner_reset_latency_stats(void) {
+    bthome_histogram_reset(&scanner_state.latency.arrival_to_decoded);
+    bthome_histogram_reset(&scanner_state.latency.decode);
+    bthome_histogram_reset(&scanner_state.latency.callback);
+}
+
+esp_err_t bthome_ble_scanner_checkpoint_now(void) {
+    if (!scanner_state.initialized || !scanner_state.checkpointing) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    return checkpoint_save();
+}
+
+int bthome_ble_scanner_get_known_devices(bthome_ble_scan_result_t *out, size_t max) {
+    if (!scanner_state.initialized) {
+        return -1;
+    }
+
+    size_t count = 0;
+    xSemaphoreTake(scanner_state.core_lock, portMAX_DELAY);
+    for (size_t i = 0; i < BTHOME_DEVICE_CACHE_SIZE && count < max; i++) {
+        const bthome_device_entry_t *entry = &scanner_state.core.device_cache.devices[i];
+        bthome_packet_t packet;
+        if (!entry->used || bthome_device_cache_last_packet(&scanner_state.core.device_cache, entry, &packet) != 0) {
+            continue;
+        }
+
+        // The copy owns its data, since the entry changes with the next advertisement
+        bthome_ble_scan_result_t *result = &out[count];
+        memcpy(result->addr, entry->addr, sizeof(esp_bd_addr_t));
+        result->rssi = entry->rssi;
+        if (bthome_packet_copy(&result->packet, &packet) == 0) {
+            count++;
+        }
+        bthome_packet_free(&packet);
+    }
+    xSemaphoreGive(scanner_state.core_lock);
+    return count;
+}
+
 esp_err_t bthome_ble_scanner_deinit(void) {
     if (!scanner_state.initialized) {
         return ESP_OK;
@@ -104,12 +756,26 @@ esp_err_t bthome_ble_scanner_deinit(void) {
     if (scanner_state.scanning) {
         bthome_ble_scanner_stop();
     }
+    if (scanner_state.sched_timer) {
+        esp_timer_stop(scanner_state.sched_timer);
+        esp_timer_delete(scanner_state.sched_timer);
+        scanner_state.sched_timer = NULL;
+    }
+    delivery_teardown();
 
-    esp_bluedroid_disable();
-    esp_bluedroid_deinit();
-    esp_bt_controller_disable();
-    esp_bt_controller_deinit();
+    ble_stack_release();
+
+    if (scanner_state.checkpoint_timer) {
+        esp_timer_stop(scanner_state.checkpoint_timer);
+        esp_timer_delete(scanner_state.checkpoint_timer);
+        scanner_state.checkpoint_timer = NULL;
+        checkpoint_save();  // Don't lose changes since the last interval
+    }
+    scanner_state.checkpointing = false;
+    vSemaphoreDelete(scanner_state.core_lock);
+    scanner_state.core_lock = NULL;
 
+    xEventGroupClearBits(scanner_events, BTHOME_BLE_EVENT_READY | BTHOME_BLE_EVENT_SCANNING);
     scanner_state.initialized = false;
     ESP_LOGI(TAG, "BTHome BLE scanner deinitialized");
 
@@ -150,31 +816,102 @@ bool bthome_ble_is_bthome_advertisement(const uint8_t *adv_data, uint8_t adv_dat
     return false;
 }
 
-static void process_scan_result(esp_ble_gap_cb_param_t *scan_result) {
-    if (!scanner_state.config.callback) {
+// Hand a decoded packet to the queue; the queued copy owns its data
+static void enqueue_result(esp_bd_addr_t addr, int rssi, const bthome_packet_t *packet) {
+    queue_item_t item = { .kind = QUEUE_ITEM_PACKET };
+    memcpy(item.result.addr, addr, sizeof(esp_bd_addr_t));
+    item.result.rssi = rssi;
+    if (bthome_packet_copy(&item.result.packet, packet) != 0) {
+        scanner_state.dropped++;
         return;
     }
+    if (xQueueSend(scanner_state.queue, &item, 0) != pdTRUE) {
+        bthome_packet_free(&item.result.packet);
+        scanner_state.dropped++;
+    }
+}
 
-    uint8_t *adv_data = scan_result->scan_rst.ble_adv;
-    uint8_t adv_data_len = scan_result->scan_rst.adv_data_len;
-    
-    // Check if this is a BTHome advertisement
-    if (!bthome_ble_is_bthome_advertisement(adv_data, adv_data_len)) {
-        return;
+static uint32_t sched_now_ms(void) {
+    return (uint32_t)(esp_timer_get_time() / 1000);
+}
+
+// Restart the scan with the scheduler's new parameters
+// The stack only accepts new parameters while stopped, so the scan is stopped here and
+// restarted with them from the GAP event handler.
+static void apply_scan_sched(void) {
+    scanner_state.scan_params.scan_interval = scanner_state.core.sched.scan_interval;
+    scanner_state.scan_params.scan_window = scanner_state.core.sched.scan_window;
+    ESP_LOGD(TAG, "Scan interval now %u (duty %u permille)", scanner_state.core.sched.scan_interval,
+             bthome_scan_sched_duty_permille(&scanner_state.core.sched));
+
+    if (!scanner_state.scanning || scanner_state.rescheduling) {
+        return;  // Picked up by the next (re)start
     }
-    
-    // Decode the BTHome packet
+    scanner_state.rescheduling = true;
+    if (esp_ble_gap_stop_scanning() != ESP_OK) {
+        scanner_state.rescheduling = false;
+    }
+}
+
+static void sched_timer_callback(void *arg) {
+    xSemaphoreTake(scanner_state.core_lock, portMAX_DELAY);
+    bool changed = bthome_scan_sched_update(&scanner_state.core.sched, sched_now_ms());
+    xSemaphoreGive(scanner_state.core_lock);
+    if (changed) {
+        apply_scan_sched();
+    }
+}
+
+// Filter, decode and deliver advertising data (possibly followed by its scan response)
+// received_us is when the GAP event for the (first half of the) data arrived
+static void process_adv_data(esp_bd_addr_t addr, int rssi, const uint8_t *adv_data, size_t adv_data_len,
+                             int64_t received_us) {
+    bool queued = scanner_state.config.delivery_mode != BTHOME_BLE_DELIVERY_CALLBACK;
+
+    // Filter and decode the BTHome packet
+    int64_t decode_start_us = scanner_state.timing ? esp_timer_get_time() : 0;
     bthome_packet_t packet;
-    int result = bthome_decode_advertisement(adv_data, adv_data_len, &packet);
-    
+    int result = bthome_scanner_core_decode(&scanner_state.core, addr, adv_data, adv_data_len,
+                                            rssi, &packet);
+    if (result > 0) {
+        return;  // Not BTHome, or not subscribed to
+    }
+    if (result == 0 && scanner_state.timing) {
+        int64_t decoded_us = esp_timer_get_time();
+        bthome_histogram_record(&scanner_state.latency.decode, decoded_us - decode_start_us);
+        bthome_histogram_record(&scanner_state.latency.arrival_to_decoded, decoded_us - received_us);
+    }
+
+    bool sched_changed = false;
     if (result == 0) {
+        xSemaphoreTake(scanner_state.core_lock, portMAX_DELAY);
+        uint32_t intern_failures = scanner_state.core.device_cache.intern_failures;
+        sched_changed = bthome_scanner_core_record(&scanner_state.core, addr, rssi, adv_data,
+                                                   adv_data_len, &packet, sched_now_ms());
+        scanner_state.checkpoint_dirty = true;
+        bool intern_failed = scanner_state.core.device_cache.intern_failures != intern_failures;
+        xSemaphoreGive(scanner_state.core_lock);
+        if (intern_failed) {
+            ESP_LOGW(TAG, "Couldn't intern a device name (%lu so far)",
+                     (unsigned long)scanner_state.core.device_cache.intern_failures);
+        }
+    }
+    if (sched_changed) {
+        apply_scan_sched();
+    }
+    
+    if (result == 0 && queued) {
+        enqueue_result(addr, rssi, &packet);
+        bthome_packet_free(&packet);
+    } else if (result == 0) {
         // Call user callback
-        scanner_state.config.callback(
-            scan_result->scan_rst.bda,
-            scan_result->scan_rst.rssi,
-            &packet,
-            scanner_state.config.user_data
-        );
+        record_first_delivery();
+        int64_t callback_start_us = scanner_state.timing ? esp_timer_get_time() : 0;
+        scanner_state.config.callback(addr, rssi, &packet, scanner_state.config.user_data);
+        if (scanner_state.timing) {
+            bthome_histogram_record(&scanner_state.latency.callback,
+                                    esp_timer_get_time() - callback_start_us);
+        }
         
         // Free the packet resources
         bthome_packet_free(&packet);
@@ -183,14 +920,131 @@ static void process_scan_result(esp_ble_gap_cb_param_t *scan_result) {
     }
 }
 
+// Deliver a held advertisement without a scan response and free its slot
+static void release_pending(pending_adv_t *pending) {
+    pending->used = false;
+    process_adv_data(pending->addr, pending->rssi, pending->data, pending->len, pending->received_us);
+}
+
+// Deliver held advertisements whose scan response didn't arrive in time (all if flush)
+static void expire_pending(int64_t now_us, bool flush) {
+    int64_t window_us = (int64_t)scanner_state.config.scan_response_window_ms * 1000;
+    for (size_t i = 0; i < PENDING_MERGE_SLOTS; i++) {
+        pending_adv_t *pending = &scanner_state.pending[i];
+        if (pending->used && (flush || now_us - pending->received_us >= window_us)) {
+            release_pending(pending);
+        }
+    }
+}
+
+static pending_adv_t *find_pending(const esp_bd_addr_t addr) {
+    for (size_t i = 0; i < PENDING_MERGE_SLOTS; i++) {
+        if (scanner_state.pending[i].used &&
+            memcmp(scanner_state.pending[i].addr, addr, sizeof(esp_bd_addr_t)) == 0) {
+            return &scanner_state.pending[i];
+        }
+    }
+    return NULL;
+}
+
+// Hold an advertisement until its scan response arrives, evicting the oldest if full
+static void hold_pending(esp_bd_addr_t addr, int rssi, const uint8_t *data, uint8_t len, int64_t now_us) {
+    pending_adv_t *slot = NULL;
+    for (size_t i = 0; i < PENDING_MERGE_SLOTS; i++) {
+        pending_adv_t *pending = &scanner_state.pending[i];
+        if (!pending->used) {
+            slot = pending;
+            break;
+        }
+        if (!slot || pending->received_us < slot->received_us) {
+            slot = pending;
+        }
+    }
+    if (slot->used) {
+        release_pending(slot);
+    }
+
+    slot->used = true;
+    memcpy(slot->addr, addr, sizeof(esp_bd_addr_t));
+    slot->rssi = rssi;
+    slot->received_us = now_us;
+    slot->len = len;
+    memcpy(slot->data, data, len);
+}
+
+static void process_scan_result(esp_ble_gap_cb_param_t *scan_result) {
+    bool queued = scanner_state.config.delivery_mode != BTHOME_BLE_DELIVERY_CALLBACK;
+    if (queued ? !scanner_state.queue : !scanner_state.config.callback) {
+        return;
+    }
+
+    struct ble_scan_result_evt_param *rst = &scan_result->scan_rst;
+    size_t len = rst->adv_data_len + rst->scan_rsp_len;
+    if (len > sizeof(rst->ble_adv)) {
+        return;
+    }
+
+    int64_t now_us = scanner_state.timing || scanner_state.merging ? esp_timer_get_time() : 0;
+    if (!scanner_state.merging) {
+        process_adv_data(rst->bda, rst->rssi, rst->ble_adv, len, now_us);
+        return;
+    }
+
+    expire_pending(now_us, false);
+    pending_adv_t *pending = find_pending(rst->bda);
+
+    if (rst->ble_evt_type == ESP_BLE_EVT_SCAN_RSP) {
+        if (!pending) {
+            // Nothing held for this device; the response may carry BTHome data on its own
+            process_adv_data(rst->bda, rst->rssi, rst->ble_adv, len, now_us);
+            return;
+        }
+        // The report repeats the advertisement ahead of the response; keep the held copy
+        uint8_t merged[2 * ESP_BLE_ADV_DATA_LEN_MAX];
+        int merged_len = bthome_scanner_core_merge_response(pending->data, pending->len, rst->ble_adv,
+                                                            rst->adv_data_len, rst->scan_rsp_len,
+                                                            merged, sizeof(merged));
+        if (merged_len < 0) {
+            release_pending(pending);
+            process_adv_data(rst->bda, rst->rssi, rst->ble_adv, len, now_us);
+            return;
+        }
+        pending->used = false;
+        process_adv_data(rst->bda, rst->rssi, merged, merged_len, pending->received_us);
+        return;
+    }
+
+    if (pending) {
+        release_pending(pending);  // A new advertisement replaces one whose response never came
+    }
+
+    // Only scannable advertisements get a scan response, and only those carrying
+    // BTHome data are held for one
+    bool scannable = rst->ble_evt_type == ESP_BLE_EVT_CONN_ADV ||
+                     rst->ble_evt_type == ESP_BLE_EVT_DISC_ADV;
+    if (!scannable || rst->scan_rsp_len > 0 || rst->adv_data_len > ESP_BLE_ADV_DATA_LEN_MAX ||
+        !bthome_ble_is_bthome_advertisement(rst->ble_adv, rst->adv_data_len)) {
+        process_adv_data(rst->bda, rst->rssi, rst->ble_adv, len, now_us);
+        return;
+    }
+    hold_pending(rst->bda, rst->rssi, rst->ble_adv, rst->adv_data_len, now_us);
+}
+
+#endif // CONFIG_BTHOME_BLE_SCANNER
+
 static void gap_event_handler(esp_gap_ble_cb_event_t event, esp_ble_gap_cb_param_t *param) {
     switch (event) {
+#if CONFIG_BTHOME_BLE_SCANNER
         case ESP_GAP_BLE_SCAN_PARAM_SET_COMPLETE_EVT:
             if (param->scan_param_cmpl.status == ESP_BT_STATUS_SUCCESS) {
                 ESP_LOGI(TAG, "Scan parameters set successfully");
+                if (boot_timing.scan_params_set_us == 0) {
+                    boot_timing.scan_params_set_us = esp_timer_get_time();
+                }
                 esp_ble_gap_start_scanning(scanner_state.config.scan_duration);
             } else {
                 ESP_LOGE(TAG, "Failed to set scan parameters: %d", param->scan_param_cmpl.status);
+                xEventGroupSetBits(scanner_events, BTHOME_BLE_EVENT_FAILED);
             }
             break;
 
@@ -198,9 +1052,14 @@ static void gap_event_handler(esp_gap_ble_cb_event_t event, esp_ble_gap_cb_param
             if (param->scan_start_cmpl.status == ESP_BT_STATUS_SUCCESS) {
                 ESP_LOGI(TAG, "Scan started successfully");
                 scanner_state.scanning = true;
+                if (boot_timing.scan_started_us == 0) {
+                    boot_timing.scan_started_us = esp_timer_get_time();
+                }
+                xEventGroupSetBits(scanner_events, BTHOME_BLE_EVENT_SCANNING);
             } else {
                 ESP_LOGE(TAG, "Failed to start scan: %d", param->scan_start_cmpl.status);
                 scanner_state.scanning = false;
+                xEventGroupSetBits(scanner_events, BTHOME_BLE_EVENT_FAILED);
             }
             break;
 
@@ -213,7 +1072,9 @@ static void gap_event_handler(esp_gap_ble_cb_event_t event, esp_ble_gap_cb_param
                     
                 case ESP_GAP_SEARCH_INQ_CMPL_EVT:
                     ESP_LOGI(TAG, "Scan complete");
+                    expire_pending(0, true);
                     scanner_state.scanning = false;
+                    xEventGroupClearBits(scanner_events, BTHOME_BLE_EVENT_SCANNING);
                     break;
                     
                 default:
@@ -221,20 +1082,75 @@ static void gap_event_handler(esp_gap_ble_cb_event_t event, esp_ble_gap_cb_param
             }
             break;
 
+#endif // CONFIG_BTHOME_BLE_SCANNER
+
+#if CONFIG_BTHOME_BLE_ADVERTISER
+        case ESP_GAP_BLE_ADV_DATA_RAW_SET_COMPLETE_EVT:
+            if (param->adv_data_raw_cmpl.status != ESP_BT_STATUS_SUCCESS) {
+                ESP_LOGE(TAG, "Failed to set advertising data: %d", param->adv_data_raw_cmpl.status);
+                advertiser_state.start_pending = false;
+            } else if (advertiser_state.start_pending) {
+                advertiser_state.start_pending = false;
+                esp_ble_gap_start_advertising(&advertiser_state.adv_params);
+            }
+            break;
+
+        case ESP_GAP_BLE_ADV_START_COMPLETE_EVT:
+            if (param->adv_start_cmpl.status == ESP_BT_STATUS_SUCCESS) {
+                ESP_LOGI(TAG, "Advertising started successfully");
+                advertiser_state.advertising = true;
+            } else {
+                ESP_LOGE(TAG, "Failed to start advertising: %d", param->adv_start_cmpl.status);
+                advertiser_state.advertising = false;
+            }
+            break;
+
+        case ESP_GAP_BLE_ADV_STOP_COMPLETE_EVT:
+            if (param->adv_stop_cmpl.status == ESP_BT_STATUS_SUCCESS) {
+                ESP_LOGI(TAG, "Advertising stopped successfully");
+            } else {
+                ESP_LOGE(TAG, "Failed to stop advertising: %d", param->adv_stop_cmpl.status);
+            }
+            advertiser_state.advertising = false;
+            break;
+#endif // CONFIG_BTHOME_BLE_ADVERTISER
+
+#if CONFIG_BTHOME_BLE_SCANNER
         case ESP_GAP_BLE_SCAN_STOP_COMPLETE_EVT:
+            if (scanner_state.rescheduling) {
+                // Stopped by the adaptive scheduler: restart with the new parameters
+                scanner_state.rescheduling = false;
+                if (param->scan_stop_cmpl.status == ESP_BT_STATUS_SUCCESS &&
+                    esp_ble_gap_set_scan_params(&scanner_state.scan_params) != ESP_OK) {
+                    ESP_LOGE(TAG, "Failed to apply adaptive scan parameters");
+                    scanner_state.scanning = false;
+                    xEventGroupClearBits(scanner_events, BTHOME_BLE_EVENT_SCANNING);
+                    xEventGroupSetBits(scanner_events, BTHOME_BLE_EVENT_FAILED);
+                }
+                break;
+            }
             if (param->scan_stop_cmpl.status == ESP_BT_STATUS_SUCCESS) {
                 ESP_LOGI(TAG, "Scan stopped successfully");
             } else {
                 ESP_LOGE(TAG, "Failed to stop scan: %d", param->scan_stop_cmpl.status);
             }
             scanner_state.scanning = false;
+            xEventGroupClearBits(scanner_events, BTHOME_BLE_EVENT_SCANNING);
+            expire_pending(0, true);
+            if (scanner_state.dispatch_task) {
+                // Don't hold back a partial batch once scanning has stopped
+                queue_item_t item = { .kind = QUEUE_ITEM_FLUSH };
+                xQueueSend(scanner_state.queue, &item, 0);
+            }
             break;
+#endif // CONFIG_BTHOME_BLE_SCANNER
 
         default:
             break;
     }
 }
 
+#if CONFIG_BTHOME_BLE_SCANNER
 esp_err_t bthome_ble_scanner_start(const bthome_ble_scanner_config_t *config) {
     if (!scanner_state.initialized) {
         ESP_LOGE(TAG, "Scanner not initialized");
@@ -246,24 +1162,102 @@ esp_err_t bthome_ble_scanner_start(const bthome_ble_scanner_config_t *config) {
         return ESP_ERR_INVALID_STATE;
     }
 
-    if (!config || !config->callback) {
-        ESP_LOGE(TAG, "Invalid configuration or missing callback");
+    if (!config) {
+        ESP_LOGE(TAG, "Invalid configuration");
         return ESP_ERR_INVALID_ARG;
     }
 
+    switch (config->delivery_mode) {
+        case BTHOME_BLE_DELIVERY_CALLBACK:
+            if (!config->callback) {
+                ESP_LOGE(TAG, "Missing callback");
+                return ESP_ERR_INVALID_ARG;
+            }
+            break;
+        case BTHOME_BLE_DELIVERY_BATCH:
+            if (!config->batch_callback || config->batch_size == 0 || config->queue_length == 0) {
+                ESP_LOGE(TAG, "Batched delivery requires batch_callback, batch_size and queue_length");
+                return ESP_ERR_INVALID_ARG;
+            }
+            break;
+        case BTHOME_BLE_DELIVERY_POLL:
+            if (config->queue_length == 0) {
+                ESP_LOGE(TAG, "Polled delivery requires queue_length");
+                return ESP_ERR_INVALID_ARG;
+            }
+            break;
+        default:
+            ESP_LOGE(TAG, "Invalid delivery mode");
+            return ESP_ERR_INVALID_ARG;
+    }
+#if CONFIG_BTHOME_NO_HEAP
+    if ((config->delivery_mode != BTHOME_BLE_DELIVERY_CALLBACK &&
+         config->queue_length > CONFIG_BTHOME_BLE_MAX_QUEUE_LENGTH) ||
+        (config->delivery_mode == BTHOME_BLE_DELIVERY_BATCH &&
+         config->batch_size > CONFIG_BTHOME_BLE_MAX_BATCH_SIZE)) {
+        ESP_LOGE(TAG, "queue_length or batch_size exceeds the static buffers");
+        return ESP_ERR_INVALID_ARG;
+    }
+#endif
+
+    // Compile the filter and reset the scheduler; the filter itself isn't retained
+    bthome_scan_sched_config_t sched_config = config->adaptive_config;
+    sched_config.scan_window = config->scan_window;
+    xSemaphoreTake(scanner_state.core_lock, portMAX_DELAY);
+    int result = bthome_scanner_core_configure(&scanner_state.core, config->filter, config->intern_names,
+                                               config->adaptive ? &sched_config : NULL, sched_now_ms());
+    xSemaphoreGive(scanner_state.core_lock);
+    if (result != 0) {
+        ESP_LOGE(TAG, "Invalid filter");
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    // Replace the delivery queue left over from a previous scan
+    delivery_teardown();
+
     // Store configuration
     memcpy(&scanner_state.config, config, sizeof(bthome_ble_scanner_config_t));
+    scanner_state.merging = config->scan_type == BLE_SCAN_TYPE_ACTIVE &&
+                            config->scan_response_window_ms > 0;
+    scanner_state.timing = config->collect_latency;
+    memset(scanner_state.pending, 0, sizeof(scanner_state.pending));
+
+    esp_err_t ret = delivery_setup(config);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to set up packet delivery: %s", esp_err_to_name(ret));
+        return ret;
+    }
 
     // Configure scan parameters
-    static esp_ble_scan_params_t scan_params = {0};
-    scan_params.scan_type = config->scan_type;
-    scan_params.own_addr_type = config->own_addr_type;
-    scan_params.scan_filter_policy = config->filter_policy;
-    scan_params.scan_interval = config->scan_interval;
-    scan_params.scan_window = config->scan_window;
-    scan_params.scan_duplicate = BLE_SCAN_DUPLICATE_DISABLE;
-
-    esp_err_t ret = esp_ble_gap_set_scan_params(&scan_params);
+    esp_ble_scan_params_t *scan_params = &scanner_state.scan_params;
+    scan_params->scan_type = config->scan_type;
+    scan_params->own_addr_type = config->own_addr_type;
+    scan_params->scan_filter_policy = config->filter_policy;
+    scan_params->scan_interval = config->scan_interval;
+    scan_params->scan_window = config->scan_window;
+    scan_params->scan_duplicate = BLE_SCAN_DUPLICATE_DISABLE;
+
+    scanner_state.rescheduling = false;
+    if (config->adaptive) {
+        scan_params->scan_interval = scanner_state.core.sched.scan_interval;
+        scan_params->scan_window = scanner_state.core.sched.scan_window;
+
+        if (!scanner_state.sched_timer) {
+            const esp_timer_create_args_t timer_args = {
+                .callback = sched_timer_callback,
+                .name = "bthome_sched",
+            };
+            ret = esp_timer_create(&timer_args, &scanner_state.sched_timer);
+            if (ret != ESP_OK) {
+                ESP_LOGE(TAG, "Failed to create scheduler timer: %s", esp_err_to_name(ret));
+                return ret;
+            }
+        }
+        esp_timer_stop(scanner_state.sched_timer);
+        esp_timer_start_periodic(scanner_state.sched_timer, (uint64_t)SCAN_SCHED_PERIOD_MS * 1000);
+    }
+
+    ret = esp_ble_gap_set_scan_params(scan_params);
     if (ret != ESP_OK) {
         ESP_LOGE(TAG, "Failed to set scan params: %s", esp_err_to_name(ret));
         return ret;
@@ -279,11 +1273,21 @@ esp_err_t bthome_ble_scanner_stop(void) {
         return ESP_ERR_INVALID_STATE;
     }
 
+    if (scanner_state.sched_timer) {
+        esp_timer_stop(scanner_state.sched_timer);
+    }
+
     if (!scanner_state.scanning) {
         ESP_LOGW(TAG, "Scanner not running");
         return ESP_OK;
     }
 
+    // A stop already in flight for rescheduling now completes as a real stop
+    if (scanner_state.rescheduling) {
+        scanner_state.rescheduling = false;
+        return ESP_OK;
+    }
+
     esp_err_t ret = esp_ble_gap_stop_scanning();
     if (ret != ESP_OK) {
         ESP_LOGE(TAG, "Failed to stop scanning: %s", esp_err_to_name(ret));
@@ -292,3 +1296,180 @@ esp_err_t bthome_ble_scanner_stop(void) {
 
     return ESP_OK;
 }
+
+#endif // CONFIG_BTHOME_BLE_SCANNER
+
+#if CONFIG_BTHOME_BLE_ADVERTISER
+void bthome_ble_advertiser_get_default_config(bthome_ble_advertiser_config_t *config) {
+    config->adv_interval_min = 0x320;  // 500ms
+    config->adv_interval_max = 0x640;  // 1s
+    config->own_addr_type = BLE_ADDR_TYPE_PUBLIC;
+    config->channel_map = ADV_CHNL_ALL;
+    config->include_flags = true;
+    config->auto_packet_id = true;
+}
+
+esp_err_t bthome_ble_advertiser_init(void) {
+    if (advertiser_state.initialized) {
+        ESP_LOGW(TAG, "Advertiser already initialized");
+        return ESP_OK;
+    }
+
+    esp_err_t ret = ble_stack_acquire();
+    if (ret != ESP_OK) {
+        return ret;
+    }
+
+    advertiser_state.initialized = true;
+    advertiser_state.advertising = false;
+    advertiser_state.start_pending = false;
+    bthome_packet_init(&advertiser_state.packet);
+    ESP_LOGI(TAG, "BTHome BLE advertiser initialized");
+
+    return ESP_OK;
+}
+
+esp_err_t bthome_ble_advertiser_deinit(void) {
+    if (!advertiser_state.initialized) {
+        return ESP_OK;
+    }
+
+    if (advertiser_state.advertising) {
+        bthome_ble_advertiser_stop();
+    }
+
+    ble_stack_release();
+
+    bthome_packet_free(&advertiser_state.packet);
+    advertiser_state.initialized = false;
+    ESP_LOGI(TAG, "BTHome BLE advertiser deinitialized");
+
+    return ESP_OK;
+}
+
+// Encode a packet straight into the buffer handed to the stack; re-sending the same
+// packet only patches the packet ID into its cached encoding
+static esp_err_t set_adv_data(bthome_packet_t *packet) {
+    if (advertiser_state.config.auto_packet_id) {
+        bthome_set_packet_id(packet, advertiser_state.packet_id + 1);
+    }
+
+    int len = bthome_encode_advertisement_cached(packet, advertiser_state.adv_data,
+                                                 sizeof(advertiser_state.adv_data),
+                                                 advertiser_state.config.include_flags);
+    if (len < 0) {
+        ESP_LOGE(TAG, "Packet does not fit in an advertisement");
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    // Replacing the data of a running advertisement takes effect without restarting it
+    esp_err_t ret = esp_ble_gap_config_adv_data_raw(advertiser_state.adv_data, len);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to set advertising data: %s", esp_err_to_name(ret));
+        return ret;
+    }
+
+    if (advertiser_state.config.auto_packet_id) {
+        advertiser_state.packet_id++;
+    }
+    return ESP_OK;
+}
+
+// Broadcast a copy of the packet, replacing the stored one only if it could be set
+static esp_err_t set_packet(const bthome_packet_t *packet) {
+    bthome_packet_t copy;
+    if (bthome_packet_copy(&copy, packet) != 0) {
+        ESP_LOGE(TAG, "Failed to copy packet");
+        return ESP_ERR_NO_MEM;
+    }
+    esp_err_t ret = set_adv_data(&copy);
+    if (ret != ESP_OK) {
+        bthome_packet_free(&copy);
+        return ret;
+    }
+    bthome_packet_free(&advertiser_state.packet);
+    advertiser_state.packet = copy;
+    return ESP_OK;
+}
+
+esp_err_t bthome_ble_advertiser_start(const bthome_ble_advertiser_config_t *config,
+                                      const bthome_packet_t *packet) {
+    if (!advertiser_state.initialized) {
+        ESP_LOGE(TAG, "Advertiser not initialized");
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    if (advertiser_state.advertising || advertiser_state.start_pending) {
+        ESP_LOGW(TAG, "Advertiser already running");
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    if (!config || !packet) {
+        ESP_LOGE(TAG, "Invalid configuration or missing packet");
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    // Store configuration
+    memcpy(&advertiser_state.config, config, sizeof(bthome_ble_advertiser_config_t));
+
+    // BTHome advertisements are broadcast only
+    memset(&advertiser_state.adv_params, 0, sizeof(advertiser_state.adv_params));
+    advertiser_state.adv_params.adv_int_min = config->adv_interval_min;
+    advertiser_state.adv_params.adv_int_max = config->adv_interval_max;
+    advertiser_state.adv_params.adv_type = ADV_TYPE_NONCONN_IND;
+    advertiser_state.adv_params.own_addr_type = config->own_addr_type;
+    advertiser_state.adv_params.channel_map = config->channel_map;
+    advertiser_state.adv_params.adv_filter_policy = ADV_FILTER_ALLOW_SCAN_ANY_CON_ANY;
+
+    // Advertising starts in the GAP event handler once the data is set
+    advertiser_state.start_pending = true;
+    esp_err_t ret = set_packet(packet);
+    if (ret != ESP_OK) {
+        advertiser_state.start_pending = false;
+    }
+    return ret;
+}
+
+esp_err_t bthome_ble_advertiser_update(const bthome_packet_t *packet) {
+    if (!advertiser_state.initialized) {
+        ESP_LOGE(TAG, "Advertiser not initialized");
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    if (!packet) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    return set_packet(packet);
+}
+
+esp_err_t bthome_ble_advertiser_resend(void) {
+    if (!advertiser_state.initialized || (!advertiser_state.advertising && !advertiser_state.start_pending)) {
+        ESP_LOGE(TAG, "Advertiser not running");
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    return set_adv_data(&advertiser_state.packet);
+}
+
+esp_err_t bthome_ble_advertiser_stop(void) {
+    if (!advertiser_state.initialized) {
+        ESP_LOGE(TAG, "Advertiser not initialized");
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    advertiser_state.start_pending = false;
+    if (!advertiser_state.advertising) {
+        ESP_LOGW(TAG, "Advertiser not running");
+        return ESP_OK;
+    }
+
+    esp_err_t ret = esp_ble_gap_stop_advertising();
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to stop advertising: %s", esp_err_to_name(ret));
+        return ret;
+    }
+
+    return ESP_OK;
+}
+#endif // CONFIG_BTHOME_BLE_ADVERTISER
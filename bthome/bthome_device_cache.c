@@ -0,0 +1,182 @@
+#include <stdlib.h>
+#include <string.h>
+#include "bthome.h"
+#include "bthome_device_cache.h"
+#include "bthome_internal.h"
+
+void bthome_device_cache_init(bthome_device_cache_t *cache) {
+    memset(cache, 0, sizeof(bthome_device_cache_t));
+}
+
+bthome_device_entry_t *bthome_device_cache_lookup(bthome_device_cache_t *cache, const uint8_t *addr) {
+    bthome_device_entry_t *slot = NULL;
+    cache->clock++;
+
+    for (size_t i = 0; i < BTHOME_DEVICE_CACHE_SIZE; i++) {
+        bthome_device_entry_t *entry = &cache->devices[i];
+        if (entry->used && memcmp(entry->addr, addr, sizeof(entry->addr)) == 0) {
+            entry->last_seen = cache->clock;
+            return entry;
+        }
+        // Prefer a free entry, otherwise the least recently seen device
+        if (!slot || (slot->used && (!entry->used || entry->last_seen < slot->last_seen))) {
+            slot = entry;
+        }
+    }
+
+    memset(slot, 0, sizeof(bthome_device_entry_t));
+    slot->used = true;
+    memcpy(slot->addr, addr, sizeof(slot->addr));
+    slot->last_seen = cache->clock;
+    slot->name = -1;
+    return slot;
+}
+
+// Find the least recently used name that no remembered device uses, or -1 if all are in use
+static int reclaimable_name(const bthome_device_cache_t *cache) {
+    bool in_use[BTHOME_NAME_POOL_SIZE] = { false };
+    for (size_t i = 0; i < BTHOME_DEVICE_CACHE_SIZE; i++) {
+        if (cache->devices[i].used && cache->devices[i].name >= 0) {
+            in_use[cache->devices[i].name] = true;
+        }
+    }
+
+    int oldest = -1;
+    for (size_t i = 0; i < cache->name_count; i++) {
+        if (!in_use[i] && (oldest < 0 || cache->names[i].last_used < cache->names[oldest].last_used)) {
+            oldest = i;
+        }
+    }
+    return oldest;
+}
+
+// Find or add a name in the pool; returns its index, or -1 if it can't be interned
+static int intern_name(bthome_device_cache_t *cache, const char *name, size_t len, bool complete) {
+    if (len > BTHOME_NAME_MAX_LEN) {
+        cache->intern_failures++;
+        return -1;
+    }
+
+    for (size_t i = 0; i < cache->name_count; i++) {
+        bthome_interned_name_t *interned = &cache->names[i];
+        if (interned->len == len && interned->complete == complete &&
+            memcmp(interned->name, name, len) == 0) {
+            interned->last_used = cache->clock;
+            return i;
+        }
+    }
+
+    // A full pool reuses a name no device needs any more; packets may still point at it,
+    // so it is overwritten in place rather than moved
+    int index = cache->name_count;
+    if (cache->name_count == BTHOME_NAME_POOL_SIZE) {
+        index = reclaimable_name(cache);
+        if (index < 0) {
+            cache->intern_failures++;
+            return -1;
+        }
+    } else {
+        cache->name_count++;
+    }
+
+    bthome_interned_name_t *interned = &cache->names[index];
+    memcpy(interned->name, name, len);
+    interned->name[len] = '\0';
+    interned->len = len;
+    interned->complete = complete;
+    interned->last_used = cache->clock;
+    return index;
+}
+
+// Intern the packet's name (if any) as the device's name
+static int remember_name(bthome_device_cache_t *cache, bthome_device_entry_t *entry,
+                         const bthome_packet_t *packet) {
+    if (packet->device_name != NULL && packet->device_name_len > 0) {
+        // The device's previous name may be reclaimed for its new one
+        int16_t previous = entry->name;
+        entry->name = -1;
+        int index = intern_name(cache, packet->device_name, packet->device_name_len,
+                                packet->use_complete_name);
+        if (index < 0) {
+            entry->name = previous;
+            return -1;
+        }
+        entry->name = index;
+    }
+    return 0;
+}
+
+const bthome_interned_name_t *bthome_device_cache_find_name(const bthome_device_cache_t *cache,
+                                                            const uint8_t *addr) {
+    for (size_t i = 0; i < BTHOME_DEVICE_CACHE_SIZE; i++) {
+        const bthome_device_entry_t *entry = &cache->devices[i];
+        if (entry->used && memcmp(entry->addr, addr, sizeof(entry->addr)) == 0) {
+            return entry->name >= 0 ? &cache->names[entry->name] : NULL;
+        }
+    }
+    return NULL;
+}
+
+int bthome_device_cache_remember_name(bthome_device_cache_t *cache, const uint8_t *addr,
+                                      const bthome_packet_t *packet) {
+    return remember_name(cache, bthome_device_cache_lookup(cache, addr), packet);
+}
+
+int bthome_device_cache_attach_name(bthome_device_cache_t *cache, const uint8_t *addr,
+                                    bthome_packet_t *packet) {
+    bthome_device_entry_t *entry = bthome_device_cache_lookup(cache, addr);
+
+    if (remember_name(cache, entry, packet) != 0) {
+        return -1;
+    }
+    if (entry->name < 0) {
+        return 0;  // No name known for this device yet
+    }
+
+    if (packet->owns_data && !packet->name_shared && packet->device_name != NULL) {
+        bthome_free((void *)packet->device_name);
+    }
+
+    const bthome_interned_name_t *interned = &cache->names[entry->name];
+    packet->device_name = interned->name;
+    packet->device_name_len = interned->len;
+    packet->use_complete_name = interned->complete;
+    packet->name_shared = true;
+    bthome_packet_invalidate(packet);
+    return 0;
+}
+
+bthome_device_entry_t *bthome_device_cache_record(bthome_device_cache_t *cache, const uint8_t *addr,
+                                                  int rssi, const uint8_t *adv, size_t len,
+                                                  const bthome_packet_t *packet) {
+    bthome_device_entry_t *entry = bthome_device_cache_lookup(cache, addr);
+    entry->rssi = rssi < INT8_MIN ? INT8_MIN : rssi > INT8_MAX ? INT8_MAX : rssi;
+    entry->has_packet_id = packet->has_packet_id;
+    entry->packet_id = packet->packet_id;
+    if (len <= sizeof(entry->adv)) {
+        memcpy(entry->adv, adv, len);
+        entry->adv_len = len;
+    }
+    return entry;
+}
+
+int bthome_device_cache_last_packet(const bthome_device_cache_t *cache, const bthome_device_entry_t *entry,
+                                    bthome_packet_t *packet) {
+    if (entry->adv_len == 0) {
+        bthome_packet_init(packet);
+        return -1;
+    }
+
+    int result = bthome_decode_advertisement(entry->adv, entry->adv_len, packet);
+    if (result != 0) {
+        return result;
+    }
+    if (entry->name >= 0) {
+        const bthome_interned_name_t *interned = &cache->names[entry->name];
+        packet->device_name = interned->name;
+        packet->device_name_len = interned->len;
+        packet->use_complete_name = interned->complete;
+        packet->name_shared = true;
+    }
+    return 0;
+}
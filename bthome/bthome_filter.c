@@ -0,0 +1,155 @@
+#include <string.h>
+#include "bthome.h"
+#include "bthome_filter.h"
+#include "bthome_internal.h"
+
+static void set_bit(uint32_t *bits, uint8_t index) {
+    bits[index >> 5] |= (uint32_t)1 << (index & 0x1F);
+}
+
+static bool test_bit(const uint32_t *bits, uint8_t index) {
+    return (bits[index >> 5] >> (index & 0x1F)) & 1;
+}
+
+void bthome_filter_init(bthome_filter_t *filter) {
+    memset(filter, 0, sizeof(bthome_filter_t));
+    filter->min_rssi = INT8_MIN;
+}
+
+void bthome_filter_add_object(bthome_filter_t *filter, uint8_t object_id) {
+    set_bit(filter->object_ids, object_id);
+}
+
+int bthome_filter_compile(const bthome_filter_t *filter, bthome_matcher_t *matcher) {
+    memset(matcher, 0, sizeof(bthome_matcher_t));
+
+    memcpy(matcher->wanted_ids, filter->object_ids, sizeof(matcher->wanted_ids));
+    if (filter->event_types & BTHOME_FILTER_EVENT_BUTTON) {
+        set_bit(matcher->wanted_ids, BTHOME_EVENT_BUTTON);
+    }
+    if (filter->event_types & BTHOME_FILTER_EVENT_DIMMER) {
+        set_bit(matcher->wanted_ids, BTHOME_EVENT_DIMMER);
+    }
+
+    matcher->any_content = true;
+    for (size_t i = 0; i < 8; i++) {
+        if (matcher->wanted_ids[i]) {
+            matcher->any_content = false;
+            break;
+        }
+    }
+
+    matcher->min_rssi = filter->min_rssi;
+
+    for (size_t i = 0; i < BTHOME_FILTER_MAX_NAME_PREFIXES; i++) {
+        const char *prefix = filter->name_prefixes[i];
+        if (prefix == NULL) {
+            continue;
+        }
+        size_t len = strlen(prefix);
+        if (len > BTHOME_FILTER_MAX_PREFIX_LEN) {
+            return -1;  // Prefix can never match a local name
+        }
+        memcpy(matcher->prefixes[matcher->prefix_count], prefix, len);
+        matcher->prefix_lens[matcher->prefix_count] = len;
+        matcher->prefix_count++;
+    }
+
+    return 0;
+}
+
+static bool name_matches(const bthome_matcher_t *matcher, const uint8_t *name, size_t len) {
+    for (size_t i = 0; i < matcher->prefix_count; i++) {
+        if (matcher->prefix_lens[i] <= len &&
+            memcmp(matcher->prefixes[i], name, matcher->prefix_lens[i]) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Walk the objects in BTHome service data (after the UUID) looking for a wanted object ID
+// Returns 1 on a match, 0 if none matched, negative if the data can't be decoded
+static int service_data_matches(const bthome_matcher_t *matcher, const uint8_t *data, size_t len) {
+    if (len < 1) {
+        return -1;
+    }
+
+    size_t offset = 0;
+    uint8_t device_info = data[offset++];
+    if (device_info & BTHOME_DEVICE_INFO_ENCRYPTED) {
+        return -1;  // Objects are not visible; the decoder rejects these too
+    }
+
+    if (matcher->any_content) {
+        return 1;
+    }
+
+    while (offset < len) {
+        uint8_t object_id = data[offset++];
+        if (test_bit(matcher->wanted_ids, object_id)) {
+            return 1;
+        }
+
+        size_t size = bthome_value_len(object_id, data + offset, len - offset);
+        if (size == 0) {
+            return -1;
+        }
+        offset += size;
+    }
+
+    return 0;
+}
+
+bool bthome_matcher_match(const bthome_matcher_t *matcher, const uint8_t *adv_data,
+                          size_t adv_data_len, int rssi) {
+    return bthome_matcher_match_named(matcher, adv_data, adv_data_len, rssi, NULL, 0);
+}
+
+bool bthome_matcher_match_named(const bthome_matcher_t *matcher, const uint8_t *adv_data,
+                                size_t adv_data_len, int rssi, const char *known_name,
+                                size_t known_name_len) {
+    if (rssi < matcher->min_rssi) {
+        return false;
+    }
+
+    bool content_ok = false;
+    bool name_ok = matcher->prefix_count == 0;
+    bool has_name = false;
+    size_t offset = 0;
+
+    while (offset + 1 < adv_data_len) {
+        uint8_t ad_len = adv_data[offset++];
+        if (ad_len == 0) {
+            continue;
+        }
+        if (offset + ad_len > adv_data_len) {
+            return false;
+        }
+
+        uint8_t ad_type = adv_data[offset];
+        const uint8_t *ad_data = adv_data + offset + 1;
+        size_t ad_data_len = ad_len - 1;
+
+        if (ad_type == 0x16 && ad_data_len >= 2 &&
+            (ad_data[0] | (ad_data[1] << 8)) == BTHOME_UUID_LE) {
+            int result = service_data_matches(matcher, ad_data + 2, ad_data_len - 2);
+            if (result < 0) {
+                return false;
+            }
+            content_ok = content_ok || result > 0;  // Any element of a merged advert will do
+        } else if (ad_type == 0x09 || ad_type == 0x08) {
+            has_name = true;
+            name_ok = name_ok || name_matches(matcher, ad_data, ad_data_len);
+        }
+
+        offset += ad_len;
+    }
+
+    // Devices often send their name only in some advertisements or the scan response
+    if (!name_ok && !has_name && known_name != NULL) {
+        name_ok = name_matches(matcher, (const uint8_t *)known_name, known_name_len);
+    }
+
+    return content_ok && name_ok;
+}
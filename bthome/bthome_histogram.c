@@ -0,0 +1,55 @@
+#include <string.h>
+#include "bthome_histogram.h"
+
+void bthome_histogram_reset(bthome_histogram_t *histogram) {
+    memset(histogram, 0, sizeof(bthome_histogram_t));
+}
+
+static size_t bucket_of(uint32_t duration_us) {
+    if (duration_us == 0) {
+        return 0;
+    }
+    size_t bucket = 32 - __builtin_clz(duration_us);  // 1 for 1us, 2 for 2-3us, ...
+    return bucket < BTHOME_HISTOGRAM_BUCKETS ? bucket : BTHOME_HISTOGRAM_BUCKETS - 1;
+}
+
+void bthome_histogram_record(bthome_histogram_t *histogram, uint32_t duration_us) {
+    histogram->buckets[bucket_of(duration_us)]++;
+    histogram->total_us += duration_us;
+    if (duration_us > histogram->max_us) {
+        histogram->max_us = duration_us;
+    }
+    histogram->count++;
+}
+
+uint32_t bthome_histogram_bucket_floor(size_t bucket) {
+    return bucket == 0 ? 0 : (uint32_t)1 << (bucket - 1);
+}
+
+uint32_t bthome_histogram_percentile(const bthome_histogram_t *histogram, uint8_t percent) {
+    // Sum the buckets rather than trusting count, which may be a sample ahead
+    uint64_t count = 0;
+    for (size_t i = 0; i < BTHOME_HISTOGRAM_BUCKETS; i++) {
+        count += histogram->buckets[i];
+    }
+    if (count == 0) {
+        return 0;
+    }
+
+    uint64_t rank = (count * (percent > 100 ? 100 : percent) + 99) / 100;
+    if (rank == 0) {
+        rank = 1;
+    }
+    uint64_t seen = 0;
+    for (size_t i = 0; i < BTHOME_HISTOGRAM_BUCKETS; i++) {
+        seen += histogram->buckets[i];
+        if (seen >= rank) {
+            if (i == BTHOME_HISTOGRAM_BUCKETS - 1) {
+                return histogram->max_us;
+            }
+            uint32_t upper = bthome_histogram_bucket_floor(i + 1) - (i == 0 ? 0 : 1);
+            return upper < histogram->max_us ? upper : histogram->max_us;
+        }
+    }
+    return histogram->max_us;
+}
@@ -0,0 +1,292 @@
+#include <string.h>
+#include "bthome.h"
+#include "bthome_history.h"
+#include "bthome_internal.h"
+
+#define DATA_BITS (sizeof(((bthome_history_block_t *)0)->data) * 8)
+
+// Variable-length codes: a unary prefix selects the payload width. Timestamps are
+// encoded as delta-of-delta and values as deltas, both zig-zag encoded, so a regular
+// interval and an unchanged value cost a single bit each.
+typedef struct {
+    uint8_t prefix_bits;
+    uint8_t payload_bits;
+} code_t;
+
+static const code_t timestamp_codes[] = { { 1, 0 }, { 2, 3 }, { 3, 7 }, { 4, 12 }, { 4, 34 } };
+static const code_t value_codes[] = { { 1, 0 }, { 2, 3 }, { 3, 7 }, { 4, 16 }, { 4, 64 } };
+#define CODE_COUNT 5
+
+static uint64_t zigzag(int64_t value) {
+    return ((uint64_t)value << 1) ^ (uint64_t)(value >> 63);
+}
+
+static int64_t unzigzag(uint64_t value) {
+    return (int64_t)(value >> 1) ^ -(int64_t)(value & 1);
+}
+
+// Index of the shortest code whose payload holds value
+static size_t choose_code(const code_t *codes, uint64_t value) {
+    for (size_t i = 0; i < CODE_COUNT - 1; i++) {
+        if (codes[i].payload_bits == 0 ? value == 0 : value < ((uint64_t)1 << codes[i].payload_bits)) {
+            return i;
+        }
+    }
+    return CODE_COUNT - 1;
+}
+
+static size_t code_len(const code_t *codes, uint64_t value) {
+    const code_t *code = &codes[choose_code(codes, value)];
+    return code->prefix_bits + code->payload_bits;
+}
+
+static void write_bits(bthome_history_block_t *block, uint64_t value, uint8_t count) {
+    for (uint8_t i = count; i > 0; i--) {
+        size_t bit = block->bits++;
+        if ((value >> (i - 1)) & 1) {
+            block->data[bit >> 3] |= 0x80 >> (bit & 7);
+        }
+    }
+}
+
+static uint64_t read_bits(const bthome_history_block_t *block, uint16_t *bit, uint8_t count) {
+    uint64_t value = 0;
+    for (uint8_t i = 0; i < count; i++) {
+        value = (value << 1) | ((block->data[*bit >> 3] >> (7 - (*bit & 7))) & 1);
+        (*bit)++;
+    }
+    return value;
+}
+
+// Prefixes are 0, 10, 110, 1110 and 1111
+static void write_code(bthome_history_block_t *block, const code_t *codes, uint64_t value) {
+    size_t index = choose_code(codes, value);
+    const code_t *code = &codes[index];
+    uint8_t prefix = index < CODE_COUNT - 1 ? ((1 << index) - 1) << 1 : (1 << code->prefix_bits) - 1;
+    write_bits(block, prefix, code->prefix_bits);
+    write_bits(block, value, code->payload_bits);
+}
+
+static uint64_t read_code(const bthome_history_block_t *block, uint16_t *bit, const code_t *codes) {
+    size_t index = 0;
+    while (index < CODE_COUNT - 1 && read_bits(block, bit, 1) == 1) {
+        index++;
+    }
+    return read_bits(block, bit, codes[index].payload_bits);
+}
+
+int bthome_history_init(bthome_history_t *history, void *mem, size_t size, size_t max_series) {
+    memset(history, 0, sizeof(bthome_history_t));
+
+    size_t series_size = max_series * sizeof(bthome_history_series_t);
+    series_size = (series_size + 7) & ~(size_t)7;
+    if (size < series_size + sizeof(bthome_history_block_t)) {
+        return -1;
+    }
+
+    size_t block_count = (size - series_size) / sizeof(bthome_history_block_t);
+    if (block_count > BTHOME_HISTORY_NONE) {
+        block_count = BTHOME_HISTORY_NONE;  // Block indexes are 16-bit
+    }
+
+    history->series = mem;
+    history->max_series = max_series;
+    history->blocks = (bthome_history_block_t *)((uint8_t *)mem + series_size);
+    history->block_count = block_count;
+
+    // Chain all blocks into the free list
+    for (size_t i = 0; i < block_count; i++) {
+        history->blocks[i].series = BTHOME_HISTORY_NONE;
+        history->blocks[i].next = i + 1 < block_count ? i + 1 : BTHOME_HISTORY_NONE;
+    }
+    history->free_block = 0;
+    return 0;
+}
+
+static bthome_history_series_t *find_series(const bthome_history_t *history, const uint8_t *addr,
+                                             uint8_t object_id, uint8_t instance) {
+    for (size_t i = 0; i < history->series_count; i++) {
+        bthome_history_series_t *series = &history->series[i];
+        if (series->object_id == object_id && series->instance == instance &&
+            memcmp(series->addr, addr, sizeof(series->addr)) == 0) {
+            return series;
+        }
+    }
+    return NULL;
+}
+
+// Take a free block, reusing the oldest block of any series if none is free
+static uint16_t allocate_block(bthome_history_t *history) {
+    if (history->free_block == BTHOME_HISTORY_NONE) {
+        bthome_history_series_t *oldest = NULL;
+        for (size_t i = 0; i < history->series_count; i++) {
+            bthome_history_series_t *series = &history->series[i];
+            if (series->head != BTHOME_HISTORY_NONE &&
+                (!oldest || history->blocks[series->head].first_timestamp <
+                            history->blocks[oldest->head].first_timestamp)) {
+                oldest = series;
+            }
+        }
+
+        uint16_t index = oldest->head;
+        oldest->head = history->blocks[index].next;
+        if (oldest->head == BTHOME_HISTORY_NONE) {
+            oldest->tail = BTHOME_HISTORY_NONE;
+        }
+        history->blocks[index].next = BTHOME_HISTORY_NONE;
+        history->free_block = index;
+    }
+
+    uint16_t index = history->free_block;
+    history->free_block = history->blocks[index].next;
+    return index;
+}
+
+int bthome_history_append(bthome_history_t *history, const uint8_t *addr, uint8_t object_id,
+                          uint8_t instance, uint32_t timestamp, int64_t value) {
+    bthome_history_series_t *series = find_series(history, addr, object_id, instance);
+    if (!series) {
+        if (history->series_count == history->max_series) {
+            return -1;  // Series table full
+        }
+        series = &history->series[history->series_count++];
+        memcpy(series->addr, addr, sizeof(series->addr));
+        series->object_id = object_id;
+        series->instance = instance;
+        series->head = BTHOME_HISTORY_NONE;
+        series->tail = BTHOME_HISTORY_NONE;
+    }
+
+    if (series->tail != BTHOME_HISTORY_NONE) {
+        if (timestamp < series->last_timestamp) {
+            return -2;  // Out of order
+        }
+
+        int64_t delta = (int64_t)timestamp - series->last_timestamp;
+        uint64_t timestamp_code = zigzag(delta - series->last_delta);
+        uint64_t value_code = zigzag((int64_t)((uint64_t)value - (uint64_t)series->last_value));
+        bthome_history_block_t *block = &history->blocks[series->tail];
+
+        if (block->bits + code_len(timestamp_codes, timestamp_code) +
+            code_len(value_codes, value_code) <= DATA_BITS) {
+            write_code(block, timestamp_codes, timestamp_code);
+            write_code(block, value_codes, value_code);
+            block->count++;
+            series->last_timestamp = timestamp;
+            series->last_value = value;
+            series->last_delta = delta;
+            return 0;
+        }
+    }
+
+    // Start a new block holding this sample in its header
+    size_t series_index = series - history->series;
+    uint16_t index = allocate_block(history);
+    bthome_history_block_t *block = &history->blocks[index];
+    memset(block, 0, sizeof(bthome_history_block_t));
+    block->series = series_index;
+    block->next = BTHOME_HISTORY_NONE;
+    block->count = 1;
+    block->first_timestamp = timestamp;
+    block->first_value = value;
+
+    // The oldest block may have been this series' own tail
+    if (series->tail == BTHOME_HISTORY_NONE) {
+        series->head = index;
+    } else {
+        history->blocks[series->tail].next = index;
+    }
+    series->tail = index;
+    series->last_timestamp = timestamp;
+    series->last_value = value;
+    series->last_delta = 0;
+    return 0;
+}
+
+int bthome_history_append_packet(bthome_history_t *history, const uint8_t *addr,
+                                 const bthome_packet_t *packet, uint32_t timestamp) {
+    int appended = 0;
+    for (size_t i = 0; i < packet->measurement_count; i++) {
+        const bthome_measurement_t *m = &packet->measurements[i];
+        if (m->size == 0) {
+            continue;  // Text and raw values aren't time series
+        }
+
+        uint8_t instance = 0;
+        for (size_t j = 0; j < i; j++) {
+            instance += packet->measurements[j].object_id == m->object_id;
+        }
+
+        int result = bthome_history_append(history, addr, m->object_id, instance, timestamp,
+                                           bthome_get_raw_value(m));
+        if (result < 0) {
+            return result;
+        }
+        appended++;
+    }
+    return appended;
+}
+
+// Position the iterator at the first sample of a block
+static void enter_block(bthome_history_iter_t *iter, uint16_t index) {
+    iter->block = index;
+    iter->index = 0;
+    iter->bit = 0;
+    iter->delta = 0;
+}
+
+int bthome_history_query(const bthome_history_t *history, const uint8_t *addr, uint8_t object_id,
+                         uint8_t instance, uint32_t from, uint32_t to, bthome_history_iter_t *iter) {
+    const bthome_history_series_t *series = find_series(history, addr, object_id, instance);
+    if (!series) {
+        return -1;
+    }
+
+    iter->history = history;
+    iter->from = from;
+    iter->to = to;
+
+    // Skip whole blocks that end before the range: a block ends where the next one starts
+    uint16_t index = series->head;
+    while (index != BTHOME_HISTORY_NONE) {
+        uint16_t next = history->blocks[index].next;
+        if (next == BTHOME_HISTORY_NONE || history->blocks[next].first_timestamp >= from) {
+            break;
+        }
+        index = next;
+    }
+    enter_block(iter, index);
+    return 0;
+}
+
+bool bthome_history_next(bthome_history_iter_t *iter, uint32_t *timestamp, int64_t *value) {
+    while (iter->block != BTHOME_HISTORY_NONE) {
+        const bthome_history_block_t *block = &iter->history->blocks[iter->block];
+        if (iter->index == block->count) {
+            enter_block(iter, block->next);
+            continue;
+        }
+
+        if (iter->index == 0) {
+            iter->timestamp = block->first_timestamp;
+            iter->value = block->first_value;
+        } else {
+            iter->delta += unzigzag(read_code(block, &iter->bit, timestamp_codes));
+            iter->timestamp += iter->delta;
+            iter->value = (int64_t)((uint64_t)iter->value +
+                                    (uint64_t)unzigzag(read_code(block, &iter->bit, value_codes)));
+        }
+        iter->index++;
+
+        if (iter->timestamp > iter->to) {
+            iter->block = BTHOME_HISTORY_NONE;
+            return false;
+        }
+        if (iter->timestamp >= iter->from) {
+            *timestamp = iter->timestamp;
+            *value = iter->value;
+            return true;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,318 @@
+#include <stdlib.h>
+#include <string.h>
+#include "bthome.h"
+#include "bthome_pack.h"
+#include "bthome_internal.h"
+
+// Every object takes at least two bytes, which bounds the objects per advertisement
+#define MAX_OBJECTS_PER_ADV (BTHOME_ADV_MAX_LEN / 2)
+
+// A measurement or event to be placed
+typedef struct {
+    bool is_event;
+    size_t index;                  // Index into packet->measurements or packet->events
+    size_t size;                   // Encoded size including the object ID
+    uint32_t interval_ms;
+} pack_item_t;
+
+// An advertisement being filled
+typedef struct {
+    size_t free;                   // Bytes left for objects
+    uint32_t interval_ms;
+    size_t count;
+    size_t items[MAX_OBJECTS_PER_ADV]; // Indexes into the item array
+} pack_bin_t;
+
+static size_t measurement_size(const bthome_measurement_t *m) {
+    if (m->size == 0) {
+        return 2 + m->value.bytes_val.len;  // Object ID + length byte + data
+    }
+    return 1 + m->size;
+}
+
+static size_t event_size(const bthome_event_t *e) {
+    if (e->event_type == BTHOME_EVENT_DIMMER && e->event_value != BTHOME_DIMMER_NONE) {
+        return 3;
+    }
+    return 2;
+}
+
+// Sort by increasing interval, then by decreasing size
+static int compare_items(const void *a, const void *b) {
+    const pack_item_t *ia = a;
+    const pack_item_t *ib = b;
+    if (ia->interval_ms != ib->interval_ms) {
+        return ia->interval_ms < ib->interval_ms ? -1 : 1;
+    }
+    if (ia->size != ib->size) {
+        return ia->size > ib->size ? -1 : 1;
+    }
+    return 0;
+}
+
+// Find the packet ID value in encoded advertising data
+static int8_t find_packet_id_offset(const uint8_t *data, size_t len) {
+    size_t offset = 0;
+    while (offset + 1 < len) {
+        uint8_t ad_len = data[offset];
+        if (ad_len >= 6 && data[offset + 1] == 0x16 &&
+            (data[offset + 2] | (data[offset + 3] << 8)) == BTHOME_UUID_LE &&
+            data[offset + 5] == BTHOME_SENSOR_PACKET_ID) {
+            return offset + 6;  // Length, type, UUID, device info, object ID
+        }
+        offset += 1 + ad_len;
+    }
+    return -1;
+}
+
+// Encode one bin, keeping the objects in their original order
+static int encode_bin(const bthome_packet_t *packet, const pack_item_t *items, pack_bin_t *bin,
+                      bool with_name, bool include_flags, bthome_packed_adv_t *out) {
+    bthome_packet_t adv_packet = *packet;
+#if CONFIG_BTHOME_NO_HEAP
+    bthome_measurement_t *measurements = adv_packet.measurements;  // Inline in the copy
+    bthome_event_t *events = adv_packet.events;
+#else
+    bthome_measurement_t measurements[MAX_OBJECTS_PER_ADV];
+    bthome_event_t events[MAX_OBJECTS_PER_ADV];
+    adv_packet.measurements = measurements;
+    adv_packet.events = events;
+#endif
+    adv_packet.measurement_count = 0;
+    adv_packet.event_count = 0;
+    if (!with_name) {
+        adv_packet.device_name = NULL;
+        adv_packet.device_name_len = 0;
+    }
+
+    // Insertion sort by original position; bins hold few items
+    for (size_t i = 1; i < bin->count; i++) {
+        size_t item = bin->items[i];
+        size_t j = i;
+        while (j > 0 && items[bin->items[j - 1]].index > items[item].index) {
+            bin->items[j] = bin->items[j - 1];
+            j--;
+        }
+        bin->items[j] = item;
+    }
+
+    for (size_t i = 0; i < bin->count; i++) {
+        const pack_item_t *item = &items[bin->items[i]];
+        if (item->is_event) {
+            events[adv_packet.event_count++] = packet->events[item->index];
+        } else {
+            measurements[adv_packet.measurement_count++] = packet->measurements[item->index];
+        }
+    }
+
+    int len = bthome_encode_advertisement(&adv_packet, out->data, sizeof(out->data), include_flags);
+    if (len < 0) {
+        return len;
+    }
+    out->len = len;
+    out->interval_ms = bin->interval_ms;
+    out->packet_id_offset = packet->has_packet_id ? find_packet_id_offset(out->data, len) : -1;
+    return 0;
+}
+
+int bthome_pack_advertisements(const bthome_packet_t *packet, const uint32_t *intervals_ms,
+                               bool include_flags, bthome_packed_adv_t *out, size_t max_out) {
+    // Bytes every advertisement spends before its objects
+    size_t overhead = (include_flags ? 3 : 0) + 2 + 2 + 1 + (packet->has_packet_id ? 2 : 0);
+    size_t capacity = BTHOME_ADV_MAX_LEN - overhead;
+    size_t item_count = packet->measurement_count + packet->event_count;
+
+    if (item_count == 0) {
+        if (max_out < 1) {
+            return -2;
+        }
+        pack_bin_t bin = { .free = capacity, .interval_ms = 0, .count = 0 };
+        bool with_name = packet->device_name_len + 2 <= capacity;
+        return encode_bin(packet, NULL, &bin, with_name, include_flags, out) == 0 ? 1 : -1;
+    }
+
+#if CONFIG_BTHOME_NO_HEAP
+    // Every bin is opened for an item, so there are never more bins than items
+    pack_item_t items[CONFIG_BTHOME_MAX_MEASUREMENTS + CONFIG_BTHOME_MAX_EVENTS];
+    pack_bin_t bins[CONFIG_BTHOME_MAX_MEASUREMENTS + CONFIG_BTHOME_MAX_EVENTS];
+    if (max_out > item_count) {
+        max_out = item_count;
+    }
+#else
+    pack_item_t *items = bthome_malloc(item_count * sizeof(pack_item_t));
+    pack_bin_t *bins = bthome_malloc(max_out * sizeof(pack_bin_t));
+    if (!items || !bins) {
+        bthome_free(items);
+        bthome_free(bins);
+        return -5;  // Out of memory
+    }
+#endif
+
+    uint32_t shortest_interval = UINT32_MAX;
+    for (size_t i = 0; i < packet->measurement_count; i++) {
+        items[i].is_event = false;
+        items[i].index = i;
+        items[i].size = measurement_size(&packet->measurements[i]);
+        items[i].interval_ms = intervals_ms ? intervals_ms[i] : 0;
+        if (items[i].interval_ms < shortest_interval) {
+            shortest_interval = items[i].interval_ms;
+        }
+    }
+    if (shortest_interval == UINT32_MAX) {
+        shortest_interval = 0;
+    }
+    for (size_t i = 0; i < packet->event_count; i++) {
+        pack_item_t *item = &items[packet->measurement_count + i];
+        item->is_event = true;
+        item->index = i;
+        item->size = event_size(&packet->events[i]);
+        item->interval_ms = shortest_interval;
+    }
+
+    qsort(items, item_count, sizeof(pack_item_t), compare_items);
+
+    // First fit: bins are opened in order of increasing interval, so each item lands in
+    // the most frequently sent advertisement that still has room for it
+    size_t bin_count = 0;
+    int result = 0;
+    for (size_t i = 0; i < item_count && result == 0; i++) {
+        if (items[i].size > capacity) {
+            result = -1;  // Can never fit
+            break;
+        }
+
+        size_t b = 0;
+        while (b < bin_count && (bins[b].free < items[i].size || bins[b].count == MAX_OBJECTS_PER_ADV)) {
+            b++;
+        }
+        if (b == bin_count) {
+            if (bin_count == max_out) {
+                result = -2;  // Output too small
+                break;
+            }
+            bins[b].free = capacity;
+            bins[b].interval_ms = items[i].interval_ms;
+            bins[b].count = 0;
+            bin_count++;
+        }
+
+        bins[b].items[bins[b].count++] = i;
+        bins[b].free -= items[i].size;
+    }
+
+    // Add the name wherever it still fits
+    for (size_t b = 0; b < bin_count && result == 0; b++) {
+        bool with_name = packet->device_name != NULL && packet->device_name_len > 0 &&
+                         packet->device_name_len + 2 <= bins[b].free;
+        result = encode_bin(packet, items, &bins[b], with_name, include_flags, &out[b]);
+    }
+
+#if !CONFIG_BTHOME_NO_HEAP
+    bthome_free(items);
+    bthome_free(bins);
+#endif
+    return result < 0 ? result : (int)bin_count;
+}
+
+void bthome_pack_set_packet_id(bthome_packed_adv_t *adv, uint8_t packet_id) {
+    if (adv->packet_id_offset >= 0) {
+        adv->data[adv->packet_id_offset] = packet_id;
+    }
+}
+
+static uint64_t gcd(uint64_t a, uint64_t b) {
+    while (b != 0) {
+        uint64_t t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+// Assign each advertisement a starting slot so that it repeats every periods[i] slots
+// without colliding, trying the most frequent advertisements first
+static bool assign_slots(const uint32_t *periods, size_t count, uint8_t *schedule, size_t slots) {
+    memset(schedule, BTHOME_PACK_IDLE, slots);
+
+    bool placed[BTHOME_PACK_IDLE] = { false };
+    for (size_t n = 0; n < count; n++) {
+        size_t next = count;
+        for (size_t i = 0; i < count; i++) {
+            if (!placed[i] && (next == count || periods[i] < periods[next])) {
+                next = i;
+            }
+        }
+        placed[next] = true;
+
+        bool assigned = false;
+        for (size_t start = 0; start < periods[next] && !assigned; start++) {
+            bool free = true;
+            for (size_t slot = start; slot < slots && free; slot += periods[next]) {
+                free = schedule[slot] == BTHOME_PACK_IDLE;
+            }
+            if (free) {
+                for (size_t slot = start; slot < slots; slot += periods[next]) {
+                    schedule[slot] = next;
+                }
+                assigned = true;
+            }
+        }
+        if (!assigned) {
+            return false;
+        }
+    }
+    return true;
+}
+
+int bthome_pack_schedule(const bthome_packed_adv_t *advs, size_t count, uint32_t slot_ms,
+                         uint8_t *schedule, size_t max_slots) {
+    if (count == 0 || count >= BTHOME_PACK_IDLE || slot_ms == 0) {
+        return -2;
+    }
+
+    uint32_t periods[BTHOME_PACK_IDLE];
+    uint32_t shortest = UINT32_MAX;
+    for (size_t i = 0; i < count; i++) {
+        if (advs[i].interval_ms == 0) {
+            periods[i] = count;  // No interval required: one slot per round of all advertisements
+        } else {
+            periods[i] = advs[i].interval_ms / slot_ms;
+        }
+        if (periods[i] == 0) {
+            periods[i] = 1;
+        }
+        if (periods[i] < shortest) {
+            shortest = periods[i];
+        }
+    }
+
+    // Exact intervals: the cycle is the least common multiple of the periods
+    uint64_t cycle = 1;
+    for (size_t i = 0; i < count && cycle <= max_slots; i++) {
+        cycle = cycle / gcd(cycle, periods[i]) * periods[i];
+    }
+    if (cycle <= max_slots && assign_slots(periods, count, schedule, cycle)) {
+        return cycle;
+    }
+
+    // Harmonic intervals: shorten each period to the shortest one times a power of two,
+    // which can always be scheduled if there is room on average
+    cycle = shortest;
+    for (size_t i = 0; i < count; i++) {
+        uint32_t period = shortest;
+        while ((uint64_t)period * 2 <= periods[i]) {
+            period *= 2;
+        }
+        periods[i] = period;
+        if (period > cycle) {
+            cycle = period;
+        }
+    }
+    if (cycle > max_slots) {
+        return -2;  // Schedule too small
+    }
+    if (!assign_slots(periods, count, schedule, cycle)) {
+        return -1;  // More advertisements than slots
+    }
+    return cycle;
+}
@@ -0,0 +1,115 @@
+#include <math.h>
+#include <string.h>
+#include "bthome.h"
+#include "bthome_policy.h"
+#include "bthome_internal.h"
+
+void bthome_policy_init(bthome_policy_t *policy, uint32_t heartbeat_ms) {
+    memset(policy, 0, sizeof(bthome_policy_t));
+    policy->heartbeat_ms = heartbeat_ms;
+}
+
+int bthome_policy_set_deadband(bthome_policy_t *policy, uint8_t object_id, float absolute,
+                               float relative) {
+    size_t i = 0;
+    while (i < policy->rule_count && policy->rules[i].object_id != object_id) {
+        i++;
+    }
+    if (i == BTHOME_POLICY_MAX_RULES) {
+        return -1;
+    }
+    if (i == policy->rule_count) {
+        policy->rule_count++;
+    }
+    policy->rules[i].object_id = object_id;
+    policy->rules[i].absolute = absolute;
+    policy->rules[i].relative = relative;
+    return 0;
+}
+
+// Value compared between samples: the raw value, or an FNV-1a hash of text and raw bytes
+static int64_t sample_value(const bthome_measurement_t *m) {
+    if (m->size != 0) {
+        return bthome_get_raw_value(m);
+    }
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < m->value.bytes_val.len; i++) {
+        hash = (hash ^ m->value.bytes_val.data[i]) * 16777619u;
+    }
+    return hash;
+}
+
+static const bthome_policy_rule_t *find_rule(const bthome_policy_t *policy, uint8_t object_id) {
+    for (size_t i = 0; i < policy->rule_count; i++) {
+        if (policy->rules[i].object_id == object_id) {
+            return &policy->rules[i];
+        }
+    }
+    return NULL;
+}
+
+// Compare a sample with the last sent packet
+static bthome_policy_reason_t compare(const bthome_policy_t *policy, const bthome_packet_t *packet) {
+    if (packet->measurement_count != policy->value_count) {
+        return BTHOME_POLICY_CHANGE;
+    }
+
+    bthome_policy_reason_t reason = BTHOME_POLICY_SKIP;
+    for (size_t i = 0; i < packet->measurement_count; i++) {
+        const bthome_measurement_t *m = &packet->measurements[i];
+        const bthome_policy_value_t *sent = &policy->values[i];
+        if (m->object_id != sent->object_id) {
+            return BTHOME_POLICY_CHANGE;
+        }
+
+        int64_t value = sample_value(m);
+        if (value == sent->raw) {
+            continue;
+        }
+        if (bthome_is_binary_sensor(m->object_id)) {
+            return BTHOME_POLICY_BINARY;  // Takes precedence over other changes
+        }
+
+        const bthome_policy_rule_t *rule = m->size != 0 ? find_rule(policy, m->object_id) : NULL;
+        if (rule == NULL) {
+            reason = BTHOME_POLICY_CHANGE;
+            continue;
+        }
+        float factor = bthome_get_scaling_factor(m->object_id);
+        float change = fabsf((float)(value - sent->raw) * factor);
+        float last = fabsf((float)sent->raw * factor);
+        if (change > rule->absolute && change > rule->relative * last) {
+            reason = BTHOME_POLICY_CHANGE;
+        }
+    }
+    return reason;
+}
+
+bthome_policy_reason_t bthome_policy_sample(bthome_policy_t *policy, const bthome_packet_t *packet,
+                                            uint32_t now_ms) {
+    bthome_policy_reason_t reason;
+    if (!policy->sent) {
+        reason = BTHOME_POLICY_FIRST;
+    } else if (packet->event_count > 0) {
+        reason = BTHOME_POLICY_EVENT;
+    } else {
+        reason = compare(policy, packet);
+        if (reason == BTHOME_POLICY_SKIP && policy->heartbeat_ms > 0 &&
+            now_ms - policy->sent_ms >= policy->heartbeat_ms) {
+            reason = BTHOME_POLICY_HEARTBEAT;
+        }
+    }
+    if (reason == BTHOME_POLICY_SKIP) {
+        return reason;
+    }
+
+    policy->sent = true;
+    policy->sent_ms = now_ms;
+    policy->value_count = 0;
+    for (size_t i = 0; i < packet->measurement_count && i < BTHOME_POLICY_MAX_VALUES; i++) {
+        policy->values[i].object_id = packet->measurements[i].object_id;
+        policy->values[i].raw = sample_value(&packet->measurements[i]);
+        policy->value_count++;
+    }
+    return reason;
+}
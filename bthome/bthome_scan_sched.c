@@ -0,0 +1,260 @@
+#include <string.h>
+#include "bthome_scan_sched.h"
+
+// Expected captures per target latency; missing all of them happens e^-3 (~5%) of the time
+#define CAPTURES_PER_LATENCY 3
+
+// Gaps more than this many eighths of the period are taken to include missed advertisements
+#define LONG_GAP_EIGHTHS 12
+
+// Intervals tried when avoiding resonance, spread over the longest acceptable interval
+// down to SWEEP_SPAN_DIVISOR-ths less
+#define SWEEP_CANDIDATES   16
+#define SWEEP_SPAN_DIVISOR 8
+
+// Consecutive long gaps after which the device is taken to have slowed down
+#define LONG_GAPS_TO_SLOW 4
+
+void bthome_scan_sched_get_default_config(bthome_scan_sched_config_t *config) {
+    config->scan_window = 0x30;               // 30ms
+    config->max_scan_interval = BTHOME_SCAN_SCHED_MAX_UNITS;
+    config->min_duty_permille = 50;           // 5%
+    config->target_latency_ms = 5 * 60 * 1000;
+    config->learn_ms = 60 * 1000;
+    config->burst_ms = 2000;
+    config->hold_ms = 10 * 1000;
+}
+
+void bthome_scan_sched_init(bthome_scan_sched_t *sched, const bthome_scan_sched_config_t *config,
+                            uint32_t now_ms) {
+    memset(sched, 0, sizeof(bthome_scan_sched_t));
+    sched->config = *config;
+    if (sched->config.scan_window < BTHOME_SCAN_SCHED_MIN_UNITS) {
+        sched->config.scan_window = BTHOME_SCAN_SCHED_MIN_UNITS;
+    }
+    if (sched->config.min_duty_permille == 0) {
+        sched->config.min_duty_permille = 1;
+    }
+    sched->start_ms = now_ms;
+    sched->learning = true;
+    sched->changed_ms = now_ms;
+    sched->scan_window = sched->config.scan_window;
+    sched->scan_interval = sched->config.scan_window;  // Continuous while learning
+}
+
+static bthome_scan_sched_device_t *find_device(bthome_scan_sched_t *sched, const uint8_t addr[6],
+                                               uint32_t now_ms) {
+    bthome_scan_sched_device_t *free_slot = NULL;
+    bthome_scan_sched_device_t *oldest = NULL;
+    for (size_t i = 0; i < BTHOME_SCAN_SCHED_MAX_DEVICES; i++) {
+        bthome_scan_sched_device_t *device = &sched->devices[i];
+        if (!device->used) {
+            if (!free_slot) {
+                free_slot = device;
+            }
+            continue;
+        }
+        if (memcmp(device->addr, addr, 6) == 0) {
+            return device;
+        }
+        if (!oldest || now_ms - device->last_seen_ms > now_ms - oldest->last_seen_ms) {
+            oldest = device;
+        }
+    }
+
+    bthome_scan_sched_device_t *device = free_slot ? free_slot : oldest;
+    memset(device, 0, sizeof(bthome_scan_sched_device_t));
+    device->used = true;
+    memcpy(device->addr, addr, 6);
+    device->last_seen_ms = now_ms;
+    return device;
+}
+
+// Refine the period estimate from the gap since the previous packet
+static void learn_period(bthome_scan_sched_device_t *device, uint32_t gap_ms) {
+    if (gap_ms == 0) {
+        return;
+    }
+    if (device->period_ms == 0 || gap_ms < device->period_ms * 3 / 4) {
+        // Shorter gaps mean earlier ones included misses
+        device->period_ms = gap_ms;
+        device->long_gaps = 0;
+        return;
+    }
+    if ((uint64_t)gap_ms * 8 <= (uint64_t)device->period_ms * LONG_GAP_EIGHTHS) {
+        // Track drift
+        device->period_ms = (uint32_t)((int64_t)device->period_ms +
+                                       ((int64_t)gap_ms - device->period_ms) / 8);
+        device->long_gaps = 0;
+        return;
+    }
+
+    // Gaps that are always long mean the device now advertises less often
+    if (device->long_gaps == 0 || gap_ms < device->long_gap_ms) {
+        device->long_gap_ms = gap_ms;
+    }
+    if (++device->long_gaps >= LONG_GAPS_TO_SLOW) {
+        device->period_ms = device->long_gap_ms;
+        device->long_gaps = 0;
+    }
+}
+
+// How evenly a device's advertisements sweep across the scan interval: the closest any of the
+// next interval / window advertisements lands to the first one's phase (up to the window length)
+// A periodic advertiser whose period is close to a multiple of the scan interval keeps
+// landing at the same phase, and if that is outside the window it goes unheard for a long time.
+static uint32_t sweep_score(uint32_t period_ms, uint32_t interval_us, uint32_t window_us) {
+    uint32_t step = (uint32_t)((uint64_t)period_ms * 1000 % interval_us);
+    uint32_t steps = interval_us / window_us;
+    uint32_t phase = 0;
+    uint32_t closest = window_us;
+    for (uint32_t k = 1; k <= steps; k++) {
+        phase = (phase + step) % interval_us;
+        uint32_t distance = phase < interval_us - phase ? phase : interval_us - phase;
+        if (distance < closest) {
+            closest = distance;
+        }
+    }
+    return closest;
+}
+
+// Among intervals slightly shorter than the longest acceptable one, pick the one that
+// sweeps the learned devices' advertisements across the window most evenly
+static uint16_t pick_interval(const bthome_scan_sched_t *sched, uint32_t longest) {
+    uint32_t window_us = (uint32_t)sched->config.scan_window * 625;
+    uint32_t span = longest / SWEEP_SPAN_DIVISOR;
+    if (longest - span < sched->config.scan_window) {
+        span = longest - sched->config.scan_window;
+    }
+
+    uint32_t best = longest;
+    uint32_t best_score = 0;
+    for (uint32_t n = 0; n < SWEEP_CANDIDATES; n++) {
+        uint32_t candidate = longest - span * n / SWEEP_CANDIDATES;
+        uint32_t score = window_us;
+        for (size_t i = 0; i < BTHOME_SCAN_SCHED_MAX_DEVICES && score > 0; i++) {
+            const bthome_scan_sched_device_t *device = &sched->devices[i];
+            if (!device->used || device->trigger_based || device->period_ms == 0) {
+                continue;
+            }
+            uint32_t device_score = sweep_score(device->period_ms, candidate * 625, window_us);
+            if (device_score < score) {
+                score = device_score;
+            }
+        }
+        if (score > best_score) {
+            best = candidate;
+            best_score = score;
+        }
+    }
+    return best;
+}
+
+// Scan interval that hears every tracked periodic device within the target latency
+static uint16_t target_interval(const bthome_scan_sched_t *sched) {
+    const bthome_scan_sched_config_t *config = &sched->config;
+    if (sched->bursting || sched->learning) {
+        return config->scan_window;
+    }
+
+    // Capturing an advertisement is about as likely as the duty cycle, so
+    // latency / period advertisements need a duty cycle of CAPTURES_PER_LATENCY * period / latency
+    uint32_t duty = config->min_duty_permille;
+    for (size_t i = 0; i < BTHOME_SCAN_SCHED_MAX_DEVICES; i++) {
+        const bthome_scan_sched_device_t *device = &sched->devices[i];
+        if (!device->used || device->trigger_based || device->period_ms == 0) {
+            continue;
+        }
+        uint64_t needed = (uint64_t)CAPTURES_PER_LATENCY * 1000 * device->period_ms /
+                          (config->target_latency_ms ? config->target_latency_ms : 1);
+        if (needed > duty) {
+            duty = needed > 1000 ? 1000 : (uint32_t)needed;
+        }
+    }
+
+    uint32_t interval = (uint32_t)config->scan_window * 1000 / duty;
+    if (interval > config->max_scan_interval) {
+        interval = config->max_scan_interval;
+    }
+    if (interval > BTHOME_SCAN_SCHED_MAX_UNITS) {
+        interval = BTHOME_SCAN_SCHED_MAX_UNITS;
+    }
+    if (interval <= config->scan_window) {
+        return config->scan_window;
+    }
+    return pick_interval(sched, interval);
+}
+
+// Bursts and the end of learning switch modes, and take effect regardless of hold_ms
+static bool apply(bthome_scan_sched_t *sched, uint32_t now_ms, bool mode_changed) {
+    uint16_t interval = target_interval(sched);
+    if (interval == sched->scan_interval) {
+        return false;
+    }
+
+    if (!mode_changed) {
+        // Restarting the scan costs a few milliseconds of listening, so ignore small changes
+        uint32_t diff = interval > sched->scan_interval ? interval - sched->scan_interval
+                                                        : sched->scan_interval - interval;
+        if (diff * 8 < sched->scan_interval || now_ms - sched->changed_ms < sched->config.hold_ms) {
+            return false;
+        }
+    }
+
+    sched->scan_interval = interval;
+    sched->changed_ms = now_ms;
+    return true;
+}
+
+bool bthome_scan_sched_observe(bthome_scan_sched_t *sched, const uint8_t addr[6], bool trigger_based,
+                               uint32_t now_ms) {
+    bthome_scan_sched_device_t *device = find_device(sched, addr, now_ms);
+    uint32_t gap_ms = now_ms - device->last_seen_ms;
+    device->last_seen_ms = now_ms;
+
+    bool mode_changed = false;
+    if (trigger_based) {
+        device->trigger_based = true;
+        sched->burst_until_ms = now_ms + sched->config.burst_ms;
+        mode_changed = !sched->bursting;
+        sched->bursting = sched->config.burst_ms > 0;
+    } else {
+        device->trigger_based = false;
+        learn_period(device, gap_ms);
+    }
+
+    return apply(sched, now_ms, mode_changed);
+}
+
+bool bthome_scan_sched_update(bthome_scan_sched_t *sched, uint32_t now_ms) {
+    bool mode_changed = false;
+    if (sched->bursting && (int32_t)(now_ms - sched->burst_until_ms) >= 0) {
+        sched->bursting = false;
+        mode_changed = true;
+    }
+    if (sched->learning && now_ms - sched->start_ms >= sched->config.learn_ms) {
+        sched->learning = false;
+        mode_changed = true;
+    }
+
+    // Forget devices that have gone quiet, so they stop holding the duty cycle up
+    for (size_t i = 0; i < BTHOME_SCAN_SCHED_MAX_DEVICES; i++) {
+        bthome_scan_sched_device_t *device = &sched->devices[i];
+        if (!device->used) {
+            continue;
+        }
+        uint64_t timeout = (uint64_t)device->period_ms * 8;
+        if (timeout < sched->config.target_latency_ms) {
+            timeout = sched->config.target_latency_ms;
+        }
+        if (now_ms - device->last_seen_ms > timeout) {
+            device->used = false;
+        }
+    }
+
+    return apply(sched, now_ms, mode_changed);
+}
+
+uint16_t bthome_scan_sched_duty_permille(const bthome_scan_sched_t *sched) {
+    return (uint32_t)sched->scan_window * 1000 / sched->scan_interval;
+}
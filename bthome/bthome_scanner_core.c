@@ -0,0 +1,77 @@
+#include <string.h>
+#include "bthome.h"
+#include "bthome_scanner_core.h"
+
+void bthome_scanner_core_init(bthome_scanner_core_t *core) {
+    memset(core, 0, sizeof(bthome_scanner_core_t));
+    bthome_scanner_core_configure(core, NULL, true, NULL, 0);
+    bthome_device_cache_init(&core->device_cache);
+}
+
+int bthome_scanner_core_configure(bthome_scanner_core_t *core, const bthome_filter_t *filter,
+                                  bool intern_names, const bthome_scan_sched_config_t *adaptive,
+                                  uint32_t now_ms) {
+    // An empty filter matches every advertisement with unencrypted BTHome service data
+    bthome_filter_t match_all;
+    if (!filter) {
+        bthome_filter_init(&match_all);
+        filter = &match_all;
+    }
+    bthome_matcher_t matcher;
+    if (bthome_filter_compile(filter, &matcher) != 0) {
+        return -1;
+    }
+
+    core->matcher = matcher;
+    core->intern_names = intern_names;
+    core->adaptive = adaptive != NULL;
+    if (adaptive) {
+        bthome_scan_sched_init(&core->sched, adaptive, now_ms);
+    }
+    return 0;
+}
+
+int bthome_scanner_core_decode(const bthome_scanner_core_t *core, const uint8_t addr[6],
+                               const uint8_t *adv_data, size_t adv_data_len, int rssi,
+                               bthome_packet_t *packet) {
+    // Name prefixes fall back to the device's name for advertisements without one
+    const bthome_interned_name_t *known = NULL;
+    if (core->matcher.prefix_count > 0) {
+        known = bthome_device_cache_find_name(&core->device_cache, addr);
+    }
+
+    // Check if this is a BTHome advertisement we're subscribed to, before decoding it
+    if (!bthome_matcher_match_named(&core->matcher, adv_data, adv_data_len, rssi,
+                                    known ? known->name : NULL, known ? known->len : 0)) {
+        return 1;
+    }
+    return bthome_decode_advertisement(adv_data, adv_data_len, packet);
+}
+
+bool bthome_scanner_core_record(bthome_scanner_core_t *core, const uint8_t addr[6], int rssi,
+                                const uint8_t *adv_data, size_t adv_data_len, bthome_packet_t *packet,
+                                uint32_t now_ms) {
+    bthome_device_cache_record(&core->device_cache, addr, rssi, adv_data, adv_data_len, packet);
+    if (core->intern_names) {
+        // Falls back to the name in the scan buffer if it can't be interned
+        bthome_device_cache_attach_name(&core->device_cache, addr, packet);
+    } else if (core->matcher.prefix_count > 0) {
+        // Name prefix filters still need the name for advertisements without one
+        bthome_device_cache_remember_name(&core->device_cache, addr, packet);
+    }
+    if (core->adaptive) {
+        return bthome_scan_sched_observe(&core->sched, addr, packet->device_info.trigger_based, now_ms);
+    }
+    return false;
+}
+
+int bthome_scanner_core_merge_response(const uint8_t *adv, size_t adv_len, const uint8_t *report,
+                                       size_t report_adv_len, size_t scan_rsp_len, uint8_t *out,
+                                       size_t cap) {
+    if (adv_len + scan_rsp_len > cap) {
+        return -1;
+    }
+    memcpy(out, adv, adv_len);
+    memcpy(out + adv_len, report + report_adv_len, scan_rsp_len);
+    return adv_len + scan_rsp_len;
+}
@@ -0,0 +1,338 @@
+#include <string.h>
+#include "bthome.h"
+#include "bthome_serialize.h"
+
+static const char hex_digits[] = "0123456789ABCDEF";
+
+// Output cursor that keeps counting once the buffer is full
+typedef struct {
+    char *buf;
+    size_t cap;
+    size_t len;
+} writer_t;
+
+static void put_char(writer_t *w, char c) {
+    if (w->len + 1 < w->cap) {
+        w->buf[w->len] = c;
+    }
+    w->len++;
+}
+
+static void put_mem(writer_t *w, const char *s, size_t len) {
+    if (w->len + 1 < w->cap) {
+        size_t room = w->cap - 1 - w->len;
+        memcpy(w->buf + w->len, s, len < room ? len : room);
+    }
+    w->len += len;
+}
+
+static void put_str(writer_t *w, const char *s) {
+    put_mem(w, s, strlen(s));
+}
+
+static void put_uint(writer_t *w, uint64_t value) {
+    char digits[20];
+    size_t n = 0;
+    do {
+        digits[n++] = '0' + value % 10;
+        value /= 10;
+    } while (value != 0);
+    while (n > 0) {
+        put_char(w, digits[--n]);
+    }
+}
+
+static void put_int(writer_t *w, int64_t value) {
+    if (value < 0) {
+        put_char(w, '-');
+        put_uint(w, -(uint64_t)value);
+    } else {
+        put_uint(w, value);
+    }
+}
+
+// Write a fixed-size measurement's exact scaled value
+static void put_scaled(writer_t *w, const bthome_measurement_t *m) {
+    char text[BTHOME_VALUE_STR_LEN];
+    size_t len = bthome_format_value(m, text, sizeof(text));
+    put_mem(w, text, len);
+}
+
+// Write a JSON string, escaping quotes, backslashes and control characters
+static void put_json_string(writer_t *w, const char *s, size_t len) {
+    put_char(w, '"');
+    for (size_t i = 0; i < len; i++) {
+        unsigned char c = s[i];
+        if (c == '"' || c == '\\') {
+            put_char(w, '\\');
+            put_char(w, c);
+        } else if (c < 0x20) {
+            put_str(w, "\\u00");
+            put_char(w, hex_digits[c >> 4]);
+            put_char(w, hex_digits[c & 0x0F]);
+        } else {
+            put_char(w, c);
+        }
+    }
+    put_char(w, '"');
+}
+
+static void put_hex_string(writer_t *w, const uint8_t *data, size_t len) {
+    put_char(w, '"');
+    for (size_t i = 0; i < len; i++) {
+        put_char(w, hex_digits[data[i] >> 4]);
+        put_char(w, hex_digits[data[i] & 0x0F]);
+    }
+    put_char(w, '"');
+}
+
+static void put_mac(writer_t *w, const uint8_t *mac) {
+    put_char(w, '"');
+    for (size_t i = 0; i < 6; i++) {
+        if (i > 0) {
+            put_char(w, ':');
+        }
+        put_char(w, hex_digits[mac[i] >> 4]);
+        put_char(w, hex_digits[mac[i] & 0x0F]);
+    }
+    put_char(w, '"');
+}
+
+// Write the "id" and (if known) "name" members of an object
+static void put_object_id(writer_t *w, uint8_t object_id) {
+    put_str(w, "{\"id\":");
+    put_uint(w, object_id);
+    const char *name = bthome_get_object_name(object_id);
+    if (name) {
+        put_str(w, ",\"name\":");
+        put_json_string(w, name, strlen(name));
+    }
+}
+
+static void put_measurement(writer_t *w, const bthome_measurement_t *m) {
+    put_object_id(w, m->object_id);
+    put_str(w, ",\"value\":");
+    if (m->object_id == BTHOME_SENSOR_TEXT) {
+        put_json_string(w, (const char *)m->value.bytes_val.data, m->value.bytes_val.len);
+    } else if (m->size == 0) {
+        put_hex_string(w, m->value.bytes_val.data, m->value.bytes_val.len);
+    } else {
+        put_scaled(w, m);
+    }
+    const char *unit = bthome_get_object_unit(m->object_id);
+    if (unit && unit[0] != '\0') {
+        put_str(w, ",\"unit\":");
+        put_json_string(w, unit, strlen(unit));
+    }
+    put_char(w, '}');
+}
+
+static void put_event(writer_t *w, const bthome_event_t *e) {
+    put_object_id(w, e->event_type);
+    put_str(w, ",\"event\":");
+    put_uint(w, e->event_value);
+    if (e->event_type == BTHOME_EVENT_DIMMER && e->event_value != BTHOME_DIMMER_NONE) {
+        put_str(w, ",\"steps\":");
+        put_uint(w, e->steps);
+    }
+    put_char(w, '}');
+}
+
+size_t bthome_packet_to_json(const bthome_packet_t *packet, const uint8_t *mac, int rssi,
+                             char *buf, size_t cap) {
+    writer_t w = { .buf = buf, .cap = cap, .len = 0 };
+
+    put_char(&w, '{');
+    if (mac) {
+        put_str(&w, "\"mac\":");
+        put_mac(&w, mac);
+        put_str(&w, ",\"rssi\":");
+        put_int(&w, rssi);
+        put_char(&w, ',');
+    }
+    if (packet->device_name != NULL && packet->device_name_len > 0) {
+        put_str(&w, "\"name\":");
+        put_json_string(&w, packet->device_name, packet->device_name_len);
+        put_char(&w, ',');
+    }
+    if (packet->has_packet_id) {
+        put_str(&w, "\"packet_id\":");
+        put_uint(&w, packet->packet_id);
+        put_char(&w, ',');
+    }
+
+    put_str(&w, "\"measurements\":[");
+    for (size_t i = 0; i < packet->measurement_count; i++) {
+        if (i > 0) {
+            put_char(&w, ',');
+        }
+        put_measurement(&w, &packet->measurements[i]);
+    }
+    put_str(&w, "],\"events\":[");
+    for (size_t i = 0; i < packet->event_count; i++) {
+        if (i > 0) {
+            put_char(&w, ',');
+        }
+        put_event(&w, &packet->events[i]);
+    }
+    put_str(&w, "]}");
+
+    if (cap > 0) {
+        buf[w.len < cap ? w.len : cap - 1] = '\0';
+    }
+    return w.len;
+}
+
+// Line protocol can't escape a line break, and names come straight from the air,
+// so control characters are written as spaces
+static char lp_char(char c) {
+    return (unsigned char)c < 0x20 || c == 0x7F ? ' ' : c;
+}
+
+// Write a line protocol measurement name or tag value, escaping the characters that
+// would end it (the equals sign only matters in tags)
+static void put_lp_escaped(writer_t *w, const char *s, size_t len, bool is_tag) {
+    for (size_t i = 0; i < len; i++) {
+        char c = lp_char(s[i]);
+        if (c == ',' || c == ' ' || (is_tag && c == '=')) {
+            put_char(w, '\\');
+        }
+        put_char(w, c);
+    }
+}
+
+// Write a line protocol string field value
+static void put_lp_string(writer_t *w, const char *s, size_t len) {
+    put_char(w, '"');
+    for (size_t i = 0; i < len; i++) {
+        char c = lp_char(s[i]);
+        if (c == '"' || c == '\\') {
+            put_char(w, '\\');
+        }
+        put_char(w, c);
+    }
+    put_char(w, '"');
+}
+
+// Write a record's measurement name and tags (in key order, as InfluxDB prefers)
+// Several object IDs share a name (battery % and battery low are both "battery"), so
+// the ID is always tagged; repeats of an ID in one packet (e.g. two temperature
+// sensors) also get an index tag, or they would share a series and timestamp.
+static void put_lp_series(writer_t *w, const bthome_lp_tags_t *tags, uint8_t object_id, uint8_t instance) {
+    const char *name = bthome_get_object_name(object_id);
+    if (name) {
+        put_lp_escaped(w, name, strlen(name), false);
+    } else {
+        put_str(w, "object_");
+        put_uint(w, object_id);
+    }
+    put_str(w, ",id=0x");
+    put_char(w, hex_digits[object_id >> 4]);
+    put_char(w, hex_digits[object_id & 0x0F]);
+    if (instance > 0) {
+        put_str(w, ",index=");
+        put_uint(w, instance);
+    }
+    put_mem(w, tags->text, tags->len);
+}
+
+static void put_lp_end(writer_t *w, uint64_t timestamp_ns) {
+    if (timestamp_ns != 0) {
+        put_char(w, ' ');
+        put_uint(w, timestamp_ns);
+    }
+    put_char(w, '\n');
+}
+
+int bthome_lp_tags_init(bthome_lp_tags_t *tags, const uint8_t *mac, const char *name, size_t name_len) {
+    // Reserve the writer's NUL byte so the whole array can be used
+    char text[BTHOME_LP_TAGS_MAX_LEN + 1];
+    writer_t w = { .buf = text, .cap = sizeof(text), .len = 0 };
+
+    put_str(&w, ",mac=");
+    for (size_t i = 0; i < 6; i++) {
+        if (i > 0) {
+            put_char(&w, ':');
+        }
+        put_char(&w, hex_digits[mac[i] >> 4]);
+        put_char(&w, hex_digits[mac[i] & 0x0F]);
+    }
+    if (name != NULL && name_len > 0) {
+        put_str(&w, ",name=");
+        put_lp_escaped(&w, name, name_len, true);
+    }
+
+    if (w.len > BTHOME_LP_TAGS_MAX_LEN) {
+        return -1;
+    }
+    memcpy(tags->text, text, w.len);
+    tags->len = w.len;
+    return 0;
+}
+
+void bthome_lp_batch_init(bthome_lp_batch_t *batch, char *buf, size_t cap) {
+    batch->buf = buf;
+    batch->cap = cap;
+    bthome_lp_batch_reset(batch);
+}
+
+void bthome_lp_batch_reset(bthome_lp_batch_t *batch) {
+    batch->len = 0;
+    batch->lines = 0;
+    if (batch->cap > 0) {
+        batch->buf[0] = '\0';
+    }
+}
+
+int bthome_lp_append(bthome_lp_batch_t *batch, const bthome_lp_tags_t *tags,
+                     const bthome_packet_t *packet, uint64_t timestamp_ns) {
+    if (batch->len >= batch->cap) {
+        return -1;
+    }
+    writer_t w = { .buf = batch->buf + batch->len, .cap = batch->cap - batch->len, .len = 0 };
+
+    for (size_t i = 0; i < packet->measurement_count; i++) {
+        const bthome_measurement_t *m = &packet->measurements[i];
+        uint8_t instance = 0;
+        for (size_t j = 0; j < i; j++) {
+            instance += packet->measurements[j].object_id == m->object_id;
+        }
+        put_lp_series(&w, tags, m->object_id, instance);
+        put_str(&w, " value=");
+        if (m->object_id == BTHOME_SENSOR_TEXT) {
+            put_lp_string(&w, (const char *)m->value.bytes_val.data, m->value.bytes_val.len);
+        } else if (m->size == 0) {
+            put_hex_string(&w, m->value.bytes_val.data, m->value.bytes_val.len);
+        } else {
+            put_scaled(&w, m);
+        }
+        put_lp_end(&w, timestamp_ns);
+    }
+
+    for (size_t i = 0; i < packet->event_count; i++) {
+        const bthome_event_t *e = &packet->events[i];
+        uint8_t instance = 0;
+        for (size_t j = 0; j < i; j++) {
+            instance += packet->events[j].event_type == e->event_type;
+        }
+        put_lp_series(&w, tags, e->event_type, instance);
+        put_str(&w, " event=");
+        put_uint(&w, e->event_value);
+        put_char(&w, 'i');
+        if (e->event_type == BTHOME_EVENT_DIMMER && e->event_value != BTHOME_DIMMER_NONE) {
+            put_str(&w, ",steps=");
+            put_uint(&w, e->steps);
+            put_char(&w, 'i');
+        }
+        put_lp_end(&w, timestamp_ns);
+    }
+
+    if (w.len >= w.cap) {
+        batch->buf[batch->len] = '\0';  // Drop the partial packet
+        return -1;
+    }
+    batch->len += w.len;
+    batch->buf[batch->len] = '\0';
+    batch->lines += packet->measurement_count + packet->event_count;
+    return packet->measurement_count + packet->event_count;
+}
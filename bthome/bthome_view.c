@@ -0,0 +1,156 @@
+#include <string.h>
+#include "bthome.h"
+#include "bthome_view.h"
+#include "bthome_internal.h"
+
+static bool test_bit(const uint32_t *bits, uint8_t index) {
+    return (bits[index >> 5] >> (index & 0x1F)) & 1;
+}
+
+// Number of distinct object IDs present below object_id
+static size_t rank(const uint32_t *bits, uint8_t object_id) {
+    size_t word = object_id >> 5;
+    size_t count = 0;
+    for (size_t i = 0; i < word; i++) {
+        count += __builtin_popcount(bits[i]);
+    }
+    uint32_t below = ((uint32_t)1 << (object_id & 0x1F)) - 1;
+    return count + __builtin_popcount(bits[word] & below);
+}
+
+int bthome_view_init(bthome_view_t *view, const uint8_t *data, size_t len) {
+    memset(view, 0, sizeof(bthome_view_t));
+
+    if (len < 3 || len > UINT8_MAX) {
+        return -1;  // Too short, or longer than an AD element (offsets are 8-bit)
+    }
+
+    if ((data[0] | (data[1] << 8)) != BTHOME_UUID_LE) {
+        return -2;  // Invalid UUID
+    }
+
+    uint8_t device_info = data[2];
+    view->device_info.encrypted = (device_info & BTHOME_DEVICE_INFO_ENCRYPTED) != 0;
+    view->device_info.trigger_based = (device_info & BTHOME_DEVICE_INFO_TRIGGER_BASED) != 0;
+    view->device_info.version = (device_info & BTHOME_DEVICE_INFO_VERSION_MASK) >>
+                                BTHOME_DEVICE_INFO_VERSION_SHIFT;
+    if (view->device_info.encrypted) {
+        return -3;  // Encrypted data not supported
+    }
+
+    view->data = data;
+    view->len = len;
+    view->sorted = true;
+
+    size_t offset = 3;
+    size_t distinct = 0;
+    while (offset < len) {
+        if (view->object_count >= BTHOME_VIEW_MAX_OBJECTS) {
+            memset(view, 0, sizeof(bthome_view_t));
+            return -6;  // Too many objects to index
+        }
+
+        uint8_t object_id = data[offset];
+        size_t value_len = bthome_value_len(object_id, data + offset + 1, len - offset - 1);
+        if (value_len == 0) {
+            memset(view, 0, sizeof(bthome_view_t));
+            return -4;  // Incomplete data
+        }
+
+        if (view->object_count == 0 || object_id != data[view->offsets[view->object_count - 1]]) {
+            if (view->object_count > 0 && object_id < data[view->offsets[view->object_count - 1]]) {
+                view->sorted = false;
+            }
+            if (test_bit(view->present, object_id)) {
+                view->sorted = false;  // Repeated later, not adjacent
+            }
+            view->first[distinct++] = view->object_count;
+            view->present[object_id >> 5] |= (uint32_t)1 << (object_id & 0x1F);
+        }
+
+        view->offsets[view->object_count++] = offset;
+        offset += 1 + value_len;
+    }
+
+    return 0;
+}
+
+bool bthome_view_has(const bthome_view_t *view, uint8_t object_id) {
+    return test_bit(view->present, object_id);
+}
+
+// Find the offset of an object ID's value; returns 0 if not present
+static size_t find_value(const bthome_view_t *view, uint8_t object_id, uint8_t instance) {
+    if (!test_bit(view->present, object_id)) {
+        return 0;
+    }
+
+    if (view->sorted) {
+        // Objects with the same ID are adjacent, and distinct IDs are in ascending order
+        size_t index = view->first[rank(view->present, object_id)] + instance;
+        if (index < view->object_count && view->data[view->offsets[index]] == object_id) {
+            return view->offsets[index] + 1;
+        }
+        return 0;
+    }
+
+    for (size_t i = 0; i < view->object_count; i++) {
+        if (view->data[view->offsets[i]] == object_id && instance-- == 0) {
+            return view->offsets[i] + 1;
+        }
+    }
+    return 0;
+}
+
+int bthome_view_get(const bthome_view_t *view, uint8_t object_id, uint8_t instance,
+                    bthome_measurement_t *out) {
+    if (bthome_is_event(object_id)) {
+        return -2;  // Use bthome_view_get_event()
+    }
+
+    size_t offset = find_value(view, object_id, instance);
+    if (offset == 0) {
+        return -1;  // Not present
+    }
+
+    const uint8_t *value = view->data + offset;
+    uint8_t size = bthome_get_object_size(object_id);
+
+    out->object_id = object_id;
+    out->is_signed = bthome_is_signed(object_id);
+
+    if (object_id == BTHOME_SENSOR_TEXT || object_id == BTHOME_SENSOR_RAW) {
+        out->size = 0;
+        out->value.bytes_val.len = value[0];
+        out->value.bytes_val.data = value + 1;
+        return 0;
+    }
+
+    // Unknown variable-length objects are read like bthome_decode() does
+    if (size == 0) {
+        size = *value++;
+    }
+    out->size = size;
+    bthome_read_value(value, size, out->is_signed, &out->value);
+    return 0;
+}
+
+int bthome_view_get_event(const bthome_view_t *view, uint8_t event_type, uint8_t instance,
+                          bthome_event_t *out) {
+    if (!bthome_is_event(event_type)) {
+        return -2;  // Use bthome_view_get()
+    }
+
+    size_t offset = find_value(view, event_type, instance);
+    if (offset == 0) {
+        return -1;  // Not present
+    }
+
+    out->event_type = event_type;
+    out->event_value = view->data[offset];
+    out->steps = 0;
+    if (event_type == BTHOME_EVENT_DIMMER && out->event_value != BTHOME_DIMMER_NONE) {
+        out->steps = view->data[offset + 1];
+    }
+    return 0;
+}
@@ -4,6 +4,7 @@
 #include <stdint.h>
 #include <stdbool.h>
 #include <stddef.h>
+#include "bthome_config.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -16,6 +17,9 @@ extern "C" {
 #define BTHOME_UUID_LE 0xFCD2
 #define BTHOME_UUID_BE 0xD2FC
 
+// Maximum length of legacy advertising data
+#define BTHOME_ADV_MAX_LEN 31
+
 // BTHome Device Information flags
 #define BTHOME_DEVICE_INFO_ENCRYPTED        (1 << 0)
 #define BTHOME_DEVICE_INFO_TRIGGER_BASED    (1 << 2)
@@ -196,12 +200,30 @@ typedef struct {
     uint8_t version;
 } bthome_device_info_t;
 
+// Last advertisement encoded from a packet, reused while the packet is unchanged
+typedef struct {
+    uint8_t data[BTHOME_ADV_MAX_LEN];
+    uint8_t len;                   // 0 = nothing cached
+    int8_t packet_id_offset;       // Offset of the packet ID value in data, or -1
+    bool include_flags;
+} bthome_encoded_adv_t;
+
 // BTHome packet structure
+// With CONFIG_BTHOME_NO_HEAP the measurements and events are stored inline, so copying
+// the structure copies them too; otherwise they are allocated as they are added.
 typedef struct {
     bthome_device_info_t device_info;
+#if CONFIG_BTHOME_NO_HEAP
+    bthome_measurement_t measurements[CONFIG_BTHOME_MAX_MEASUREMENTS];
+#else
     bthome_measurement_t *measurements;
+#endif
     size_t measurement_count;
+#if CONFIG_BTHOME_NO_HEAP
+    bthome_event_t events[CONFIG_BTHOME_MAX_EVENTS];
+#else
     bthome_event_t *events;
+#endif
     size_t event_count;
     uint8_t packet_id;
     bool has_packet_id;
@@ -209,8 +231,33 @@ typedef struct {
     size_t device_name_len;
     bool use_complete_name;  // true = 0x09 (complete), false = 0x08 (shortened)
     bool owns_data;  // true if packet owns and should free device_name and text/raw data buffers
+    bool name_shared;  // true if device_name is long-lived shared storage (e.g. interned), never copied or freed
+    bthome_encoded_adv_t encoded;  // Cache for bthome_encode_advertisement_cached(); see bthome_packet_invalidate()
 } bthome_packet_t;
 
+/**
+ * Heap allocator used for every allocation the component makes
+ * (packet contents, copies, batches and checkpoint buffers)
+ */
+typedef struct {
+    void *(*malloc_fn)(size_t size, void *ctx);
+    void *(*realloc_fn)(void *ptr, size_t size, void *ctx);  // Only called with a non-NULL ptr
+    void (*free_fn)(void *ptr, void *ctx);                   // Only called with a non-NULL ptr
+    void *ctx;                     // Passed to each function
+} bthome_allocator_t;
+
+/**
+ * Route the component's heap allocations through an allocator
+ * E.g. to place packets in PSRAM with heap_caps_malloc(), use fixed-size pools, or
+ * track allocations. Set it before creating any packets: memory is always returned to
+ * the allocator that is current at the time, so switching allocators with packets
+ * alive is undefined. FreeRTOS objects (queues, tasks) are not affected.
+ * With CONFIG_BTHOME_NO_HEAP the default allocator hands out blocks of
+ * CONFIG_BTHOME_MAX_DATA_LEN bytes from a static pool instead of the heap.
+ * @param allocator The allocator (copied), or NULL to restore the default
+ */
+void bthome_set_allocator(const bthome_allocator_t *allocator);
+
 // Encoder functions
 
 /**
@@ -223,13 +270,21 @@ void bthome_packet_init(bthome_packet_t *packet);
  */
 void bthome_packet_free(bthome_packet_t *packet);
 
+/**
+ * Discard the advertisement cached by bthome_encode_advertisement_cached()
+ * The bthome_set_*() and bthome_add_*() functions do this themselves; call it after
+ * changing the packet's fields directly, or the text, raw or name data it points to.
+ */
+void bthome_packet_invalidate(bthome_packet_t *packet);
+
 /**
  * Deep copy a BTHome packet
  * Allocates new memory for all dynamic data (measurements, events, device name, text/raw data)
  * so the copy remains valid even after the source packet is freed
  * @param dest Destination packet (must be initialized)
  * @param src Source packet to copy from
- * @return 0 on success, negative error code on failure (out of memory)
+ * @return 0 on success, negative error code on failure (out of memory, or with
+ *         CONFIG_BTHOME_NO_HEAP a name or text/raw value longer than CONFIG_BTHOME_MAX_DATA_LEN)
  */
 int bthome_packet_copy(bthome_packet_t *dest, const bthome_packet_t *src);
 
@@ -333,6 +388,20 @@ int bthome_encode(const bthome_packet_t *packet, uint8_t *buffer, size_t buffer_
 int bthome_encode_advertisement(const bthome_packet_t *packet, uint8_t *buffer, 
                                  size_t buffer_size, bool include_flags);
 
+/**
+ * Encode an advertisement like bthome_encode_advertisement(), caching the result in
+ * the packet
+ * Encoding the packet again before any other change returns the cached bytes, with
+ * only the packet ID updated, so re-sending an unchanged packet every advertising
+ * interval costs a copy. The bthome_set_*() and bthome_add_*() functions invalidate
+ * the cache; after changing the packet's fields directly, or the text, raw or name
+ * data it points to, call bthome_packet_invalidate(). As the cache is written, don't
+ * encode the same packet from two tasks at once.
+ * @return Number of bytes written, or negative error code
+ */
+int bthome_encode_advertisement_cached(bthome_packet_t *packet, uint8_t *buffer,
+                                       size_t buffer_size, bool include_flags);
+
 // Decoder functions
 
 /**
@@ -346,6 +415,8 @@ int bthome_decode(const uint8_t *data, size_t len, bthome_packet_t *packet);
 
 /**
  * Decode BTHome advertisement data (including AD elements)
+ * Objects from multiple BTHome service data elements (e.g. an advertisement followed
+ * by its scan response) are combined into one packet.
  * @param data The complete advertising data
  * @param len Length of the advertising data
  * @param packet Output packet structure
@@ -361,6 +432,22 @@ int bthome_decode_advertisement(const uint8_t *data, size_t len, bthome_packet_t
  */
 float bthome_get_scaled_value(const bthome_measurement_t *measurement, float factor);
 
+// Buffer size that holds any formatted fixed-size value, including the NUL
+#define BTHOME_VALUE_STR_LEN 16
+
+/**
+ * Format a measurement's scaled value as an exact decimal string
+ * Uses integer arithmetic only, with as many decimals as the object's scaling factor
+ * has (e.g. "25.00" for a temperature of 2500 * 0.01). Text measurements are copied
+ * as-is and raw measurements are written as hex.
+ * @param measurement The measurement to format
+ * @param buf Output buffer; always NUL-terminated if cap > 0
+ * @param cap Size of buf (BTHOME_VALUE_STR_LEN is enough for any fixed-size value)
+ * @return Length of the complete string (excluding the NUL); if this is cap or more
+ *         the output was truncated
+ */
+size_t bthome_format_value(const bthome_measurement_t *measurement, char *buf, size_t cap);
+
 // Helper functions
 
 /**
@@ -379,6 +466,11 @@ bool bthome_is_binary_sensor(uint8_t object_id);
  */
 bool bthome_is_event(uint8_t object_id);
 
+/**
+ * Check if an object ID carries a signed value
+ */
+bool bthome_is_signed(uint8_t object_id);
+
 /**
  * Get the scaling factor for a sensor object ID
  * Returns 1.0 for objects without scaling
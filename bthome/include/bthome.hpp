@@ -0,0 +1,635 @@
+#ifndef BTHOME_HPP
+#define BTHOME_HPP
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#if __cplusplus >= 202002L && __has_include(<span>)
+#include <span>
+#endif
+#include "bthome.h"
+
+static_assert(__cplusplus >= 201703L, "bthome.hpp needs C++17");
+
+namespace bthome {
+
+// Fixed-size objects: type name, object ID, raw type, width in bytes, and the scale as
+// multiplier / 10^decimals (the same table as bthome_get_object_size(),
+// bthome_is_signed() and bthome_get_scaling_factor())
+#define BTHOME_CPP_SENSORS(X) \
+    X(PacketId,              0x00, uint8_t,  1, 1, 0) \
+    X(Battery,               0x01, uint8_t,  1, 1, 0) \
+    X(Temperature,           0x02, int16_t,  2, 1, 2) \
+    X(Humidity,              0x03, uint16_t, 2, 1, 2) \
+    X(Pressure,              0x04, uint32_t, 3, 1, 2) \
+    X(Illuminance,           0x05, uint32_t, 3, 1, 2) \
+    X(MassKg,                0x06, uint16_t, 2, 1, 2) \
+    X(MassLb,                0x07, uint16_t, 2, 1, 2) \
+    X(Dewpoint,              0x08, int16_t,  2, 1, 2) \
+    X(CountUint8,            0x09, uint8_t,  1, 1, 0) \
+    X(EnergyUint24,          0x0A, uint32_t, 3, 1, 3) \
+    X(PowerUint24,           0x0B, uint32_t, 3, 1, 2) \
+    X(Voltage,               0x0C, uint16_t, 2, 1, 3) \
+    X(Pm25,                  0x0D, uint16_t, 2, 1, 0) \
+    X(Pm10,                  0x0E, uint16_t, 2, 1, 0) \
+    X(Co2,                   0x12, uint16_t, 2, 1, 0) \
+    X(Tvoc,                  0x13, uint16_t, 2, 1, 0) \
+    X(MoistureUint16,        0x14, uint16_t, 2, 1, 2) \
+    X(HumidityUint8,         0x2E, uint8_t,  1, 1, 0) \
+    X(MoistureUint8,         0x2F, uint8_t,  1, 1, 0) \
+    X(CountUint16,           0x3D, uint16_t, 2, 1, 0) \
+    X(CountUint32,           0x3E, uint32_t, 4, 1, 0) \
+    X(Rotation,              0x3F, int16_t,  2, 1, 1) \
+    X(DistanceMm,            0x40, uint16_t, 2, 1, 0) \
+    X(DistanceM,             0x41, uint16_t, 2, 1, 0) \
+    X(Duration,              0x42, uint32_t, 3, 1, 3) \
+    X(Current,               0x43, uint16_t, 2, 1, 3) \
+    X(Speed,                 0x44, uint16_t, 2, 1, 2) \
+    X(TemperatureSint16_1,   0x45, int16_t,  2, 1, 1) \
+    X(UvIndex,               0x46, uint8_t,  1, 1, 1) \
+    X(VolumeUint16_1,        0x47, uint16_t, 2, 1, 1) \
+    X(VolumeMl,              0x48, uint16_t, 2, 1, 0) \
+    X(VolumeFlowRate,        0x49, uint16_t, 2, 1, 3) \
+    X(Voltage_1,             0x4A, uint16_t, 2, 1, 1) \
+    X(GasUint24,             0x4B, uint32_t, 3, 1, 3) \
+    X(GasUint32,             0x4C, uint32_t, 4, 1, 3) \
+    X(EnergyUint32,          0x4D, uint32_t, 4, 1, 3) \
+    X(VolumeUint32,          0x4E, uint32_t, 4, 1, 3) \
+    X(Water,                 0x4F, uint32_t, 4, 1, 3) \
+    X(Timestamp,             0x50, uint32_t, 4, 1, 0) \
+    X(Acceleration,          0x51, uint16_t, 2, 1, 3) \
+    X(Gyroscope,             0x52, uint16_t, 2, 1, 3) \
+    X(VolumeStorage,         0x55, uint32_t, 4, 1, 3) \
+    X(Conductivity,          0x56, uint16_t, 2, 1, 0) \
+    X(TemperatureSint8,      0x57, int8_t,   1, 1, 0) \
+    X(TemperatureSint8_035,  0x58, int8_t,   1, 35, 2) \
+    X(CountSint8,            0x59, int8_t,   1, 1, 0) \
+    X(CountSint16,           0x5A, int16_t,  2, 1, 0) \
+    X(CountSint32,           0x5B, int32_t,  4, 1, 0) \
+    X(PowerSint32,           0x5C, int32_t,  4, 1, 2) \
+    X(CurrentSint16,         0x5D, int16_t,  2, 1, 3) \
+    X(Direction,             0x5E, uint16_t, 2, 1, 2) \
+    X(Precipitation,         0x5F, uint16_t, 2, 1, 1) \
+    X(Channel,               0x60, uint8_t,  1, 1, 0) \
+    X(RotationalSpeed,       0x61, uint16_t, 2, 1, 0) \
+    X(DeviceTypeId,          0xF0, uint16_t, 2, 1, 0) \
+    X(FirmwareVersionUint32, 0xF1, uint32_t, 4, 1, 0) \
+    X(FirmwareVersionUint24, 0xF2, uint32_t, 3, 1, 0)
+
+// Binary sensors (one byte, true or false), in namespace bthome::binary
+#define BTHOME_CPP_BINARY_SENSORS(X) \
+    X(GenericBoolean,  0x0F) \
+    X(Power,           0x10) \
+    X(Opening,         0x11) \
+    X(Battery,         0x15) \
+    X(BatteryCharging, 0x16) \
+    X(Co,              0x17) \
+    X(Cold,            0x18) \
+    X(Connectivity,    0x19) \
+    X(Door,            0x1A) \
+    X(GarageDoor,      0x1B) \
+    X(Gas,             0x1C) \
+    X(Heat,            0x1D) \
+    X(Light,           0x1E) \
+    X(Lock,            0x1F) \
+    X(Moisture,        0x20) \
+    X(Motion,          0x21) \
+    X(Moving,          0x22) \
+    X(Occupancy,       0x23) \
+    X(Plug,            0x24) \
+    X(Presence,        0x25) \
+    X(Problem,         0x26) \
+    X(Running,         0x27) \
+    X(Safety,          0x28) \
+    X(Smoke,           0x29) \
+    X(Sound,           0x2A) \
+    X(Tamper,          0x2B) \
+    X(Vibration,       0x2C) \
+    X(Window,          0x2D)
+
+namespace detail {
+
+constexpr double pow10(uint8_t n) {
+    double result = 1;
+    for (uint8_t i = 0; i < n; i++) {
+        result *= 10;
+    }
+    return result;
+}
+
+} // namespace detail
+
+/**
+ * A fixed-size object whose type carries its ID, width, sign and scale
+ * value holds the raw integer as sent, e.g. 2150 for 21.50 °C; the raw type is the
+ * narrowest one that holds the object, so a value of the wrong width doesn't convert
+ * silently. Derived is the concrete object type (Temperature etc.).
+ */
+template <typename Derived, uint8_t Id, typename RawType, uint8_t Width, uint8_t Multiplier, uint8_t Decimals>
+struct Object {
+    static_assert(Width >= 1 && Width <= 4 && Width <= sizeof(RawType), "Raw type too narrow");
+    static_assert(!std::is_signed<RawType>::value || Width == sizeof(RawType),
+                  "Signed objects fill their raw type");
+
+    using raw_type = RawType;
+    static constexpr uint8_t id = Id;
+    static constexpr uint8_t width = Width;
+    static constexpr bool is_signed = std::is_signed<RawType>::value;
+    static constexpr double scale = Multiplier / detail::pow10(Decimals);
+    static constexpr size_t max_encoded_size = 1 + Width;  // Object ID and value
+
+    RawType value;
+
+    constexpr Object() : value() {}
+    constexpr explicit Object(RawType raw) : value(raw) {}
+
+    // Object from a value in scaled units (e.g. 21.5 for temperature), rounded to the nearest step
+    static constexpr Derived from_scaled(double scaled) {
+        double steps = scaled / scale;
+        return Derived(static_cast<RawType>(steps >= 0 ? steps + 0.5 : steps - 0.5));
+    }
+
+    // Value in scaled units
+    constexpr double scaled() const {
+        return value * scale;
+    }
+
+    // Write the object ID and the little-endian value; returns the bytes written
+    constexpr size_t encode(uint8_t *out) const {
+        uint32_t bits = static_cast<uint32_t>(value);
+        out[0] = Id;
+        for (size_t i = 0; i < Width; i++) {
+            out[1 + i] = static_cast<uint8_t>(bits >> (8 * i));
+        }
+        return max_encoded_size;
+    }
+
+    // Read the little-endian value following the object ID
+    static constexpr Derived decode(const uint8_t *in) {
+        uint32_t bits = 0;
+        for (size_t i = 0; i < Width; i++) {
+            bits |= static_cast<uint32_t>(in[i]) << (8 * i);
+        }
+        if constexpr (std::is_same<RawType, bool>::value) {
+            return Derived(bits != 0);
+        } else {
+            // Signed values fill their type, so the conversion restores the sign
+            return Derived(static_cast<RawType>(static_cast<std::make_unsigned_t<RawType>>(bits)));
+        }
+    }
+};
+
+#define BTHOME_CPP_DEFINE_SENSOR(name, id, raw, width, multiplier, decimals) \
+    struct name : Object<name, id, raw, width, multiplier, decimals> { \
+        using Object::Object; \
+    };
+BTHOME_CPP_SENSORS(BTHOME_CPP_DEFINE_SENSOR)
+#undef BTHOME_CPP_DEFINE_SENSOR
+
+namespace binary {
+
+#define BTHOME_CPP_DEFINE_BINARY_SENSOR(name, id) \
+    struct name : Object<name, id, bool, 1, 1, 0> { \
+        using Object::Object; \
+    };
+BTHOME_CPP_BINARY_SENSORS(BTHOME_CPP_DEFINE_BINARY_SENSOR)
+#undef BTHOME_CPP_DEFINE_BINARY_SENSOR
+
+} // namespace binary
+
+// Button event
+struct ButtonEvent {
+    static constexpr uint8_t id = BTHOME_EVENT_BUTTON;
+    static constexpr size_t max_encoded_size = 2;
+
+    bthome_button_event_t event = BTHOME_BUTTON_NONE;
+
+    constexpr size_t encode(uint8_t *out) const {
+        out[0] = id;
+        out[1] = event;
+        return 2;
+    }
+};
+
+// Dimmer event; the step count is only sent with a rotation
+struct DimmerEvent {
+    static constexpr uint8_t id = BTHOME_EVENT_DIMMER;
+    static constexpr size_t max_encoded_size = 3;
+
+    bthome_dimmer_event_t event = BTHOME_DIMMER_NONE;
+    uint8_t steps = 0;
+
+    constexpr size_t encode(uint8_t *out) const {
+        out[0] = id;
+        out[1] = event;
+        if (event == BTHOME_DIMMER_NONE) {
+            return 2;
+        }
+        out[2] = steps;
+        return 3;
+    }
+};
+
+// Text object, as read by decode(); points into the decoded buffer
+struct Text {
+    static constexpr uint8_t id = BTHOME_SENSOR_TEXT;
+    std::string_view value;
+};
+
+// Raw object, as read by decode(); points into the decoded buffer
+struct Raw {
+    static constexpr uint8_t id = BTHOME_SENSOR_RAW;
+    const uint8_t *data;
+    size_t len;
+};
+
+// Object ID missing from the table above, read as length-prefixed bytes like bthome_decode() does
+struct UnknownObject {
+    uint8_t id;
+    const uint8_t *data;
+    size_t len;
+};
+
+// Local name from an advertisement, as read by decode_advertisement()
+struct DeviceName {
+    std::string_view name;
+    bool complete;                 // Complete (0x09) rather than shortened (0x08) name
+};
+
+// Combines lambdas into one visitor: bthome::overloaded{[](bthome::Temperature t) {...}, ...}
+template <typename... Handlers>
+struct overloaded : Handlers... {
+    using Handlers::operator()...;
+};
+template <typename... Handlers>
+overloaded(Handlers...) -> overloaded<Handlers...>;
+
+/**
+ * A packet with a fixed set of objects, sized and checked at compile time
+ * The objects are encoded in the order given, which BTHome wants to be ascending
+ * object ID with events last. Encoding needs no heap and no runtime dispatch, and
+ * works in constant expressions.
+ *
+ *     bthome::Packet<bthome::PacketId, bthome::Battery, bthome::Temperature> packet;
+ *     packet.get<bthome::Temperature>() = bthome::Temperature::from_scaled(21.5);
+ *     decltype(packet)::buffer_type adv;
+ *     size_t len = packet.encode(adv);
+ */
+template <typename... Objects>
+class Packet {
+public:
+    // Service data: UUID, device info and the objects
+    static constexpr size_t service_data_size = 3 + (Objects::max_encoded_size + ... + 0);
+
+    // Advertisement: the flags and the service data AD element
+    static constexpr size_t size = 3 + 2 + service_data_size;
+    static_assert(size <= BTHOME_ADV_MAX_LEN, "Objects don't fit in a legacy advertisement");
+
+    using buffer_type = std::array<uint8_t, size>;
+    using service_data_type = std::array<uint8_t, service_data_size>;
+
+    constexpr Packet() = default;
+    constexpr explicit Packet(Objects... objects) : objects_(objects...) {}
+
+    // Object by type (if it appears once) or by position
+    template <typename T>
+    constexpr T &get() { return std::get<T>(objects_); }
+    template <typename T>
+    constexpr const T &get() const { return std::get<T>(objects_); }
+    template <size_t I>
+    constexpr auto &get() { return std::get<I>(objects_); }
+    template <size_t I>
+    constexpr const auto &get() const { return std::get<I>(objects_); }
+
+    template <typename T>
+    constexpr void set(const T &object) { std::get<T>(objects_) = object; }
+
+    // Mark the device as sending on events rather than regularly
+    constexpr void set_trigger_based(bool trigger_based) { trigger_based_ = trigger_based; }
+
+    // Encode the service data, as bthome_encode() does; returns its length (less than
+    // service_data_size only for a dimmer event without rotation)
+    constexpr size_t encode_service_data(service_data_type &out) const {
+        return encode_service_data(out.data());
+    }
+
+    // Encode the advertisement with flags, as bthome_encode_advertisement() does; returns its length
+    constexpr size_t encode(buffer_type &out) const {
+        out[0] = 0x02;  // Length
+        out[1] = 0x01;  // Flags
+        out[2] = 0x06;  // LE General Discoverable Mode, BR/EDR Not Supported
+        size_t len = encode_service_data(out.data() + 5);
+        out[3] = static_cast<uint8_t>(len + 1);
+        out[4] = 0x16;  // Service Data - 16-bit UUID
+        return 5 + len;
+    }
+
+private:
+    constexpr size_t encode_service_data(uint8_t *out) const {
+        out[0] = BTHOME_UUID_LE & 0xFF;
+        out[1] = BTHOME_UUID_LE >> 8;
+        out[2] = (BTHOME_VERSION << BTHOME_DEVICE_INFO_VERSION_SHIFT) |
+                 (trigger_based_ ? BTHOME_DEVICE_INFO_TRIGGER_BASED : 0);
+        size_t offset = 3;
+        std::apply([&](const Objects &... objects) {
+            ((offset += objects.encode(out + offset)), ...);
+        }, objects_);
+        return offset;
+    }
+
+    std::tuple<Objects...> objects_;
+    bool trigger_based_ = false;
+};
+
+#if defined(__cpp_lib_span)
+template <typename T>
+using span = std::span<T>;
+#else
+// Stand-in for std::span before C++20: a pointer and a count
+template <typename T>
+class span {
+public:
+    constexpr span() noexcept : data_(nullptr), size_(0) {}
+    constexpr span(T *data, size_t size) noexcept : data_(data), size_(size) {}
+
+    constexpr T *data() const noexcept { return data_; }
+    constexpr size_t size() const noexcept { return size_; }
+    constexpr bool empty() const noexcept { return size_ == 0; }
+    constexpr T &operator[](size_t i) const { return data_[i]; }
+    constexpr T *begin() const noexcept { return data_; }
+    constexpr T *end() const noexcept { return data_ + size_; }
+
+private:
+    T *data_;
+    size_t size_;
+};
+#endif
+
+/**
+ * A bthome_packet_t that frees itself
+ * Movable but not copyable: a move takes over the packet's storage, leaving the
+ * source empty, and never allocates. Copies are explicit with copy_from(), which
+ * gives the packet its own copies of every name and text/raw value, so it stays
+ * valid after the buffer it was decoded from is gone. To hand a packet from a
+ * scanner callback to another task, copy it once and move it from then on:
+ *
+ *     bthome::OwnedPacket owned;
+ *     if (owned.copy_from(*packet) == 0) {
+ *         queue.push(std::move(owned));
+ *     }
+ *
+ * With CONFIG_BTHOME_NO_HEAP measurements and events are stored inline, so a move
+ * copies them along with the structure, still without allocating.
+ */
+class OwnedPacket {
+public:
+    OwnedPacket() noexcept { bthome_packet_init(&packet_); }
+
+    // Take over a packet's storage, leaving packet empty. A packet from
+    // bthome_decode() still points into the decoded buffer; use copy_from() instead.
+    static OwnedPacket adopt(bthome_packet_t &packet) noexcept {
+        OwnedPacket owned;
+        owned.packet_ = packet;
+        bthome_packet_init(&packet);
+        return owned;
+    }
+
+    OwnedPacket(OwnedPacket &&other) noexcept : packet_(other.packet_) {
+        bthome_packet_init(&other.packet_);
+    }
+
+    OwnedPacket &operator=(OwnedPacket &&other) noexcept {
+        if (this != &other) {
+            bthome_packet_free(&packet_);
+            packet_ = other.packet_;
+            bthome_packet_init(&other.packet_);
+        }
+        return *this;
+    }
+
+    OwnedPacket(const OwnedPacket &) = delete;
+    OwnedPacket &operator=(const OwnedPacket &) = delete;
+
+    ~OwnedPacket() { bthome_packet_free(&packet_); }
+
+    // Replace the contents with a deep copy of src, as bthome_packet_copy() does.
+    // Returns 0, or a negative error code with the packet left empty.
+    int copy_from(const bthome_packet_t &src) noexcept {
+        bthome_packet_free(&packet_);
+        return bthome_packet_copy(&packet_, &src);
+    }
+
+    // Give up ownership; the caller frees the returned packet with bthome_packet_free()
+    bthome_packet_t release() noexcept {
+        bthome_packet_t packet = packet_;
+        bthome_packet_init(&packet_);
+        return packet;
+    }
+
+    span<const bthome_measurement_t> measurements() const noexcept {
+        return span<const bthome_measurement_t>(packet_.measurements, packet_.measurement_count);
+    }
+
+    span<const bthome_event_t> events() const noexcept {
+        return span<const bthome_event_t>(packet_.events, packet_.event_count);
+    }
+
+    // Device name, empty if the packet has none
+    std::string_view name() const noexcept {
+        return packet_.device_name != nullptr ? std::string_view(packet_.device_name, packet_.device_name_len)
+                                              : std::string_view();
+    }
+
+    const bthome_device_info_t &device_info() const noexcept { return packet_.device_info; }
+
+    // The packet itself, for the C API (bthome_add_*(), bthome_encode_advertisement(), ...)
+    bthome_packet_t *get() noexcept { return &packet_; }
+    const bthome_packet_t *get() const noexcept { return &packet_; }
+
+private:
+    bthome_packet_t packet_;
+};
+
+namespace detail {
+
+// Call the visitor if it takes this object; objects it has no handler for are skipped
+template <typename Visitor, typename T>
+constexpr void visit(Visitor &visitor, const T &object) {
+    if constexpr (std::is_invocable<Visitor &, const T &>::value) {
+        visitor(object);
+    }
+}
+
+} // namespace detail
+
+/**
+ * Decode BTHome service data by calling the visitor with each object as its own type
+ * The visitor is any callable with operator() overloads for the objects of interest
+ * (bthome::Temperature, bthome::binary::Door, bthome::ButtonEvent, bthome::Text, ...,
+ * and bthome_device_info_t for the device info); objects without a matching overload
+ * are skipped. Objects are visited as they are read, in one pass with no intermediate
+ * packet, and the dispatch is a switch the compiler can inline the handlers into.
+ * Text and raw values point into data.
+ *
+ * As objects are visited before the whole buffer has been checked, a visitor may
+ * have seen part of a packet that then fails to decode.
+ * @param data The service data payload (starting with UUID)
+ * @param len Length of the service data
+ * @param visitor Handlers for the objects
+ * @return 0 on success, or the negative error code bthome_decode() would return
+ */
+template <typename Visitor>
+constexpr int decode(const uint8_t *data, size_t len, Visitor &&visitor) {
+    if (len < 3) {
+        return -1;  // Data too short
+    }
+    if ((data[0] | (data[1] << 8)) != BTHOME_UUID_LE) {
+        return -2;  // Invalid UUID
+    }
+
+    bthome_device_info_t device_info = {
+        (data[2] & BTHOME_DEVICE_INFO_ENCRYPTED) != 0,
+        (data[2] & BTHOME_DEVICE_INFO_TRIGGER_BASED) != 0,
+        static_cast<uint8_t>((data[2] & BTHOME_DEVICE_INFO_VERSION_MASK) >> BTHOME_DEVICE_INFO_VERSION_SHIFT),
+    };
+    if (device_info.encrypted) {
+        return -3;  // Encrypted data not supported
+    }
+    detail::visit(visitor, device_info);
+
+    size_t offset = 3;
+    while (offset < len) {
+        uint8_t object_id = data[offset++];
+        if (offset >= len) {
+            return -4;  // Incomplete data
+        }
+
+        switch (object_id) {
+#define BTHOME_CPP_DECODE_SENSOR(name, id, raw, width, multiplier, decimals) \
+            case id: \
+                if (offset + width > len) { \
+                    return -4; \
+                } \
+                detail::visit(visitor, name::decode(data + offset)); \
+                offset += width; \
+                break;
+            BTHOME_CPP_SENSORS(BTHOME_CPP_DECODE_SENSOR)
+#undef BTHOME_CPP_DECODE_SENSOR
+#define BTHOME_CPP_DECODE_BINARY_SENSOR(name, id) \
+            case id: \
+                detail::visit(visitor, binary::name::decode(data + offset)); \
+                offset++; \
+                break;
+            BTHOME_CPP_BINARY_SENSORS(BTHOME_CPP_DECODE_BINARY_SENSOR)
+#undef BTHOME_CPP_DECODE_BINARY_SENSOR
+            case BTHOME_EVENT_BUTTON:
+                detail::visit(visitor, ButtonEvent{static_cast<bthome_button_event_t>(data[offset++])});
+                break;
+            case BTHOME_EVENT_DIMMER: {
+                DimmerEvent event{static_cast<bthome_dimmer_event_t>(data[offset++]), 0};
+                if (event.event != BTHOME_DIMMER_NONE) {
+                    if (offset >= len) {
+                        return -4;
+                    }
+                    event.steps = data[offset++];
+                }
+                detail::visit(visitor, event);
+                break;
+            }
+            default: {
+                // Text, raw and unknown objects carry a length byte
+                size_t size = data[offset++];
+                if (offset + size > len) {
+                    return -4;
+                }
+                const uint8_t *value = data + offset;
+                offset += size;
+                if (object_id == BTHOME_SENSOR_TEXT) {
+                    detail::visit(visitor, Text{std::string_view(reinterpret_cast<const char *>(value), size)});
+                } else if (object_id == BTHOME_SENSOR_RAW) {
+                    detail::visit(visitor, Raw{value, size});
+                } else {
+                    detail::visit(visitor, UnknownObject{object_id, value, size});
+                }
+                break;
+            }
+        }
+    }
+    return 0;
+}
+
+/**
+ * Decode a complete advertisement, like bthome_decode_advertisement()
+ * Visits the objects of every BTHome service data element, and the local name as a
+ * bthome::DeviceName.
+ * @return 0 on success, or the negative error code bthome_decode_advertisement() would return
+ */
+template <typename Visitor>
+constexpr int decode_advertisement(const uint8_t *data, size_t len, Visitor &&visitor) {
+    bool found_service_data = false;
+    size_t offset = 0;
+    while (offset < len) {
+        if (offset + 2 > len) {
+            return -1;  // Invalid AD structure
+        }
+        uint8_t ad_len = data[offset++];
+        if (ad_len == 0) {
+            continue;
+        }
+        if (offset + ad_len > len) {
+            return -1;  // AD element extends beyond data
+        }
+        uint8_t ad_type = data[offset++];
+        ad_len--;
+
+        if (ad_type == 0x16 && ad_len >= 2 && (data[offset] | (data[offset + 1] << 8)) == BTHOME_UUID_LE) {
+            int result = decode(data + offset, ad_len, visitor);
+            if (result < 0) {
+                return result;
+            }
+            found_service_data = true;
+        } else if (ad_type == 0x09 || ad_type == 0x08) {
+            detail::visit(visitor, DeviceName{
+                std::string_view(reinterpret_cast<const char *>(data + offset), ad_len), ad_type == 0x09});
+        }
+        offset += ad_len;
+    }
+    return found_service_data ? 0 : -2;  // -2: no BTHome service data
+}
+
+namespace detail {
+
+// Pointer to a container's bytes; only casts when they aren't uint8_t already, so
+// decoding a std::array<uint8_t, N> still works in constant expressions
+template <typename Bytes>
+constexpr const uint8_t *byte_data(const Bytes &bytes) {
+    using element = std::remove_cv_t<std::remove_pointer_t<decltype(std::data(bytes))>>;
+    static_assert(sizeof(element) == 1, "Decoding takes bytes");
+    if constexpr (std::is_same<element, uint8_t>::value) {
+        return std::data(bytes);
+    } else {
+        return reinterpret_cast<const uint8_t *>(std::data(bytes));
+    }
+}
+
+} // namespace detail
+
+// Decode from any contiguous byte container: std::array, std::vector, std::span, ...
+template <typename Bytes, typename Visitor>
+constexpr auto decode(const Bytes &bytes, Visitor &&visitor) -> decltype(std::data(bytes), int()) {
+    return decode(detail::byte_data(bytes), std::size(bytes), std::forward<Visitor>(visitor));
+}
+
+template <typename Bytes, typename Visitor>
+constexpr auto decode_advertisement(const Bytes &bytes, Visitor &&visitor) -> decltype(std::data(bytes), int()) {
+    return decode_advertisement(detail::byte_data(bytes), std::size(bytes), std::forward<Visitor>(visitor));
+}
+
+} // namespace bthome
+
+#endif // BTHOME_HPP
@@ -0,0 +1,259 @@
+#ifndef BTHOME_ASYNC_HPP
+#define BTHOME_ASYNC_HPP
+
+#if !defined(__cpp_impl_coroutine)
+#error "bthome_async.hpp needs C++20 coroutines"
+#endif
+
+#include <array>
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <mutex>
+#include <optional>
+#include <utility>
+#include "bthome.hpp"
+#if CONFIG_BTHOME_DECODER
+#include "bthome_scanner_core.h"
+#endif
+
+namespace bthome {
+
+// A packet received from a device
+struct ScanResult {
+    std::array<uint8_t, 6> addr;
+    int rssi;
+    OwnedPacket packet;
+};
+
+/**
+ * Bounded stream of received packets for a coroutine to consume
+ * Producers push from any thread: the scanner callback (ble_callback()), or reports
+ * from another source run through the scanner core (push_report()). One coroutine
+ * consumes them:
+ *
+ *     while (std::optional<bthome::ScanResult> result = co_await stream.next()) {
+ *         ...
+ *     }
+ *
+ * If the consumer is waiting, a push resumes it directly on the producing thread, with
+ * no queue hop or task switch in between; like a per-packet callback, it should then
+ * be quick, or hand the packet on. Packets arriving while the consumer is busy are
+ * buffered up to the capacity and dropped beyond it.
+ *
+ * close() ends the stream once the buffered packets have been consumed, and cancel()
+ * ends it at once; either way next() then returns std::nullopt. Don't destroy the
+ * stream while a coroutine waits on it: cancel it first.
+ *
+ * The buffer is part of the stream, so the only allocations are the packet copies
+ * (see bthome_packet_copy()) and the consumer's coroutine frame.
+ */
+template <size_t Capacity>
+class PacketStream {
+    static_assert(Capacity > 0, "A stream buffers at least one packet");
+
+public:
+    PacketStream() = default;
+
+    PacketStream(const PacketStream &) = delete;
+    PacketStream &operator=(const PacketStream &) = delete;
+
+    // Add a packet; returns false if the stream is full or closed
+    bool push(ScanResult &&result) {
+        std::coroutine_handle<> waiter;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (closed_) {
+                return false;
+            }
+            if (count_ == Capacity) {
+                dropped_++;
+                return false;
+            }
+            buffer_[(head_ + count_) % Capacity] = std::move(result);
+            count_++;
+            std::swap(waiter, waiter_);
+        }
+        if (waiter) {
+            waiter.resume();
+        }
+        return true;
+    }
+
+    // Add a copy of a packet; returns false if the stream is full or closed, or the copy failed
+    bool push(const uint8_t addr[6], int rssi, const bthome_packet_t &packet) {
+        if (is_closed()) {
+            return false;  // Don't copy what push() would throw away
+        }
+        ScanResult result{{}, rssi, OwnedPacket()};
+        std::memcpy(result.addr.data(), addr, result.addr.size());
+        if (result.packet.copy_from(packet) != 0) {
+            return false;
+        }
+        return push(std::move(result));
+    }
+
+    // A bthome_ble_callback_t: set it as the scanner's callback with the stream as user_data
+    static void ble_callback(uint8_t *addr, int rssi, const bthome_packet_t *packet, void *user_data) {
+        static_cast<PacketStream *>(user_data)->push(addr, rssi, *packet);
+    }
+
+#if CONFIG_BTHOME_DECODER
+    /**
+     * Run an advertising report through a scanner core, as the ESP-IDF scanner's GAP
+     * handler does, and push the packet if it passes the filter and decodes
+     * Lets other radios, or a simulated one, feed the stream. Calls must be
+     * serialized, as bthome_scanner_core_record() does no locking.
+     * @return true if the packet was pushed
+     */
+    bool push_report(bthome_scanner_core_t &core, const uint8_t addr[6], int rssi,
+                     const uint8_t *adv_data, size_t adv_data_len, uint32_t now_ms) {
+        bthome_packet_t packet;
+        if (bthome_scanner_core_decode(&core, addr, adv_data, adv_data_len, rssi, &packet) != 0) {
+            return false;
+        }
+        bthome_scanner_core_record(&core, addr, rssi, adv_data, adv_data_len, &packet, now_ms);
+        bool pushed = push(addr, rssi, packet);
+        bthome_packet_free(&packet);
+        return pushed;
+    }
+#endif
+
+    // End the stream after the packets already buffered
+    void close() {
+        end(false);
+    }
+
+    // End the stream now, discarding buffered packets
+    void cancel() {
+        end(true);
+    }
+
+    bool is_closed() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return closed_;
+    }
+
+    // Packets dropped because the buffer was full
+    size_t dropped() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return dropped_;
+    }
+
+    // Awaitable for the next packet, or std::nullopt once the stream has ended
+    class NextAwaiter {
+    public:
+        explicit NextAwaiter(PacketStream &stream) : stream_(stream) {}
+
+        bool await_ready() {
+            std::lock_guard<std::mutex> lock(stream_.mutex_);
+            return stream_.count_ > 0 || stream_.closed_;
+        }
+
+        // Checks again under the lock, as a push may have come in since await_ready()
+        bool await_suspend(std::coroutine_handle<> handle) {
+            std::lock_guard<std::mutex> lock(stream_.mutex_);
+            if (stream_.count_ > 0 || stream_.closed_) {
+                return false;
+            }
+            stream_.waiter_ = handle;
+            return true;
+        }
+
+        std::optional<ScanResult> await_resume() {
+            std::lock_guard<std::mutex> lock(stream_.mutex_);
+            if (stream_.count_ == 0) {
+                return std::nullopt;
+            }
+            std::optional<ScanResult> result = std::move(stream_.buffer_[stream_.head_]);
+            stream_.buffer_[stream_.head_].reset();
+            stream_.head_ = (stream_.head_ + 1) % Capacity;
+            stream_.count_--;
+            return result;
+        }
+
+    private:
+        PacketStream &stream_;
+    };
+
+    // Only one coroutine may wait on the stream at a time
+    NextAwaiter next() { return NextAwaiter(*this); }
+
+private:
+    void end(bool discard) {
+        std::coroutine_handle<> waiter;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            closed_ = true;
+            if (discard) {
+                for (std::optional<ScanResult> &result : buffer_) {
+                    result.reset();
+                }
+                head_ = 0;
+                count_ = 0;
+            }
+            std::swap(waiter, waiter_);
+        }
+        if (waiter) {
+            waiter.resume();
+        }
+    }
+
+    mutable std::mutex mutex_;
+    std::array<std::optional<ScanResult>, Capacity> buffer_;  // Ring buffer
+    size_t head_ = 0;
+    size_t count_ = 0;
+    size_t dropped_ = 0;
+    bool closed_ = false;
+    std::coroutine_handle<> waiter_;
+};
+
+/**
+ * Minimal coroutine type for consumers of a PacketStream
+ * Starts running when called and keeps its frame until the Task is destroyed, so
+ * done() can be checked. Don't destroy a Task while its coroutine waits on a stream:
+ * cancel the stream first.
+ */
+class Task {
+public:
+    struct promise_type {
+        Task get_return_object() { return Task(std::coroutine_handle<promise_type>::from_promise(*this)); }
+        std::suspend_never initial_suspend() noexcept { return {}; }
+        std::suspend_always final_suspend() noexcept { return {}; }
+        void return_void() {}
+        void unhandled_exception() { std::terminate(); }
+    };
+
+    Task(Task &&other) noexcept : handle_(std::exchange(other.handle_, nullptr)) {}
+    Task &operator=(Task &&other) noexcept {
+        if (this != &other) {
+            if (handle_) {
+                handle_.destroy();
+            }
+            handle_ = std::exchange(other.handle_, nullptr);
+        }
+        return *this;
+    }
+    Task(const Task &) = delete;
+    Task &operator=(const Task &) = delete;
+
+    ~Task() {
+        if (handle_) {
+            handle_.destroy();
+        }
+    }
+
+    // Finished; only meaningful once whatever resumes the coroutine has stopped
+    bool done() const { return !handle_ || handle_.done(); }
+
+private:
+    explicit Task(std::coroutine_handle<promise_type> handle) : handle_(handle) {}
+
+    std::coroutine_handle<promise_type> handle_;
+};
+
+} // namespace bthome
+
+#endif // BTHOME_ASYNC_HPP
@@ -4,7 +4,12 @@
 #include <stdint.h>
 #include <stdbool.h>
 #include "bthome.h"
+#include "bthome_filter.h"
+#include "bthome_scan_sched.h"
+#include "bthome_histogram.h"
 #include "esp_gap_ble_api.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/event_groups.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -20,6 +25,36 @@ extern "C" {
 typedef void (*bthome_ble_callback_t)(esp_bd_addr_t addr, int rssi, 
                                        const bthome_packet_t *packet, void *user_data);
 
+/**
+ * A received BTHome packet together with the device that sent it
+ * The packet owns its data (see bthome_packet_copy()); release it with bthome_packet_free()
+ * Interned device names are shared rather than copied, and stay valid until the scanner
+ * is deinitialized.
+ */
+typedef struct {
+    esp_bd_addr_t addr;            // BLE address of the device
+    int rssi;                      // RSSI of the advertisement
+    bthome_packet_t packet;        // Decoded packet
+} bthome_ble_scan_result_t;
+
+/**
+ * Callback function type for batched BTHome packet delivery
+ * @param results Array of received packets, only valid for the duration of the callback
+ * @param count Number of entries in results
+ * @param user_data User-provided data pointer
+ */
+typedef void (*bthome_ble_batch_callback_t)(const bthome_ble_scan_result_t *results, size_t count,
+                                             void *user_data);
+
+/**
+ * How received packets are handed to the application
+ */
+typedef enum {
+    BTHOME_BLE_DELIVERY_CALLBACK = 0,  // callback is invoked per packet from the GAP event handler
+    BTHOME_BLE_DELIVERY_BATCH,         // batch_callback is invoked from a dispatch task
+    BTHOME_BLE_DELIVERY_POLL,          // packets are queued for bthome_ble_scanner_poll()
+} bthome_ble_delivery_mode_t;
+
 /**
  * BLE scanner configuration
  */
@@ -32,8 +67,74 @@ typedef struct {
     uint16_t scan_window;          // Scan window (units of 0.625ms)
     bthome_ble_callback_t callback; // Callback for received packets
     void *user_data;               // User data passed to callback
+    bthome_ble_delivery_mode_t delivery_mode; // Per-packet callback, batched callback or polling
+    bthome_ble_batch_callback_t batch_callback; // Callback for batched delivery
+    size_t batch_size;             // Deliver a batch once this many packets are pending
+    uint32_t batch_timeout_ms;     // ...or once the oldest pending packet is this old
+    size_t queue_length;           // Packets buffered for batched or polled delivery
+    const bthome_filter_t *filter; // Subscription filter, compiled by start (NULL = all BTHome adverts)
+    uint32_t scan_response_window_ms; // Active scans: wait this long to merge a scan response (0 = don't merge)
+    bool intern_names;             // Attach each device's interned name, even to adverts without one
+    bool adaptive;                 // Adapt scan_interval to the devices heard (scan_window is kept)
+    bthome_scan_sched_config_t adaptive_config; // Scheduler settings; its scan_window is taken from above
+    bool collect_latency;          // Record latency histograms (see bthome_ble_scanner_get_latency_stats())
 } bthome_ble_scanner_config_t;
 
+/**
+ * Scanner latency histograms, in microseconds, for decoded packets
+ */
+typedef struct {
+    bthome_histogram_t arrival_to_decoded; // GAP event arrival to decode finished (includes scan response merging)
+    bthome_histogram_t decode;             // Filtering and decoding
+    bthome_histogram_t callback;           // Per-packet callback, or batch callback per batch
+} bthome_ble_latency_stats_t;
+
+/**
+ * Scanner checkpoint configuration
+ * Known devices, their interned names, last advertisements and packet IDs are saved
+ * to NVS and restored at init, so the last known values are available immediately
+ * after a reset (see bthome_ble_scanner_get_known_devices()).
+ */
+typedef struct {
+    const char *nvs_namespace;     // NVS namespace (at most 15 characters); nvs_flash_init() must have been called
+    uint32_t interval_ms;          // Minimum time between writes; changes in between are batched into one write
+} bthome_ble_checkpoint_config_t;
+
+// Scanner event group bits (see bthome_ble_scanner_get_event_group())
+#define BTHOME_BLE_EVENT_READY        (1 << 0)  // Scanner initialized
+#define BTHOME_BLE_EVENT_SCANNING     (1 << 1)  // Scan running
+#define BTHOME_BLE_EVENT_FAILED       (1 << 2)  // Asynchronous init, or setting up the scan, failed
+#define BTHOME_BLE_EVENT_FIRST_PACKET (1 << 3)  // First BTHome packet delivered since init
+
+/**
+ * When each scanner init stage completed, in esp_timer_get_time() microseconds since boot
+ * Stages not reached (or skipped because the advertiser already brought up the stack) are 0.
+ */
+typedef struct {
+    int64_t init_start_us;         // bthome_ble_scanner_init*() called
+    int64_t controller_init_us;    // esp_bt_controller_init() done
+    int64_t controller_enable_us;  // esp_bt_controller_enable() done
+    int64_t bluedroid_init_us;     // esp_bluedroid_init() done
+    int64_t bluedroid_enable_us;   // esp_bluedroid_enable() done
+    int64_t gap_register_us;       // GAP callback registered
+    int64_t init_done_us;          // Scanner initialized
+    int64_t scan_params_set_us;    // Scan parameters accepted
+    int64_t scan_started_us;       // Scanning started
+    int64_t first_packet_us;       // First BTHome packet delivered (callback, batch or poll)
+} bthome_ble_boot_timing_t;
+
+/**
+ * BLE advertiser configuration
+ */
+typedef struct {
+    uint16_t adv_interval_min;     // Minimum advertising interval (units of 0.625ms)
+    uint16_t adv_interval_max;     // Maximum advertising interval (units of 0.625ms)
+    esp_ble_addr_type_t own_addr_type;
+    esp_ble_adv_channel_t channel_map;
+    bool include_flags;            // Include the flags AD element
+    bool auto_packet_id;           // Send a new packet ID with every start/update/resend
+} bthome_ble_advertiser_config_t;
+
 /**
  * Initialize the BTHome BLE scanner
  * Initializes the BLE controller and GAP
@@ -41,6 +142,73 @@ typedef struct {
  */
 esp_err_t bthome_ble_scanner_init(void);
 
+/**
+ * Initialize the BTHome BLE scanner, restoring and periodically saving its state to NVS
+ * @param checkpoint Checkpoint configuration (NULL = no checkpoint, like bthome_ble_scanner_init())
+ * @return ESP_OK on success, error code otherwise
+ */
+esp_err_t bthome_ble_scanner_init_with_checkpoint(const bthome_ble_checkpoint_config_t *checkpoint);
+
+/**
+ * Initialize the scanner, and optionally start scanning, from a background task
+ * Returns immediately. Progress is signalled through the event group: BTHOME_BLE_EVENT_READY
+ * once initialized, BTHOME_BLE_EVENT_SCANNING once scanning, or BTHOME_BLE_EVENT_FAILED.
+ * The configurations are copied.
+ * @param checkpoint Checkpoint configuration (NULL = no checkpoint)
+ * @param config Scanner configuration to start scanning with (NULL = only initialize)
+ * @return ESP_OK if the init task was started, error code otherwise
+ */
+esp_err_t bthome_ble_scanner_init_async(const bthome_ble_checkpoint_config_t *checkpoint,
+                                        const bthome_ble_scanner_config_t *config);
+
+/**
+ * Get the scanner's event group (BTHOME_BLE_EVENT_* bits)
+ * @return The event group, or NULL if it could not be created
+ */
+EventGroupHandle_t bthome_ble_scanner_get_event_group(void);
+
+/**
+ * Get the timestamps of the scanner's init stages and first packet
+ * @param timing Output timestamps
+ */
+void bthome_ble_scanner_get_boot_timing(bthome_ble_boot_timing_t *timing);
+
+/**
+ * Copy the latency histograms recorded while collect_latency is set
+ * Safe to call while scanning; nothing is paused or locked.
+ * @param stats Output histograms
+ */
+void bthome_ble_scanner_get_latency_stats(bthome_ble_latency_stats_t *stats);
+
+/**
+ * Clear the latency histograms
+ * Samples recorded at the same moment may be partly kept.
+ */
+void bthome_ble_scanner_reset_latency_stats(void);
+
+/**
+ * Get default checkpoint configuration
+ * @param config Configuration structure to populate with defaults
+ */
+void bthome_ble_checkpoint_get_default_config(bthome_ble_checkpoint_config_t *config);
+
+/**
+ * Write pending checkpoint changes now, e.g. before restarting for an OTA update
+ * @return ESP_OK on success, ESP_ERR_INVALID_STATE if checkpointing is not enabled,
+ *         error code otherwise
+ */
+esp_err_t bthome_ble_scanner_checkpoint_now(void);
+
+/**
+ * Get the last packet received from each known device
+ * With a checkpoint, this includes devices restored from NVS that haven't advertised
+ * since the reset. Each returned packet must be released with bthome_packet_free().
+ * @param out Array to receive the packets
+ * @param max Capacity of out
+ * @return Number of packets written to out, or negative error code if the scanner is not initialized
+ */
+int bthome_ble_scanner_get_known_devices(bthome_ble_scan_result_t *out, size_t max);
+
 /**
  * Deinitialize the BTHome BLE scanner
  * @return ESP_OK on success, error code otherwise
@@ -60,12 +228,80 @@ esp_err_t bthome_ble_scanner_start(const bthome_ble_scanner_config_t *config);
  */
 esp_err_t bthome_ble_scanner_stop(void);
 
+/**
+ * Retrieve received packets when using BTHOME_BLE_DELIVERY_POLL
+ * Waits up to timeout_ms for the first packet, then drains any further queued
+ * packets without blocking. Each returned packet must be released with bthome_packet_free().
+ * @param out Array to receive the packets
+ * @param max Capacity of out
+ * @param timeout_ms Maximum time to wait for the first packet (0 = don't wait)
+ * @return Number of packets written to out, or negative error code if polling is not enabled
+ */
+int bthome_ble_scanner_poll(bthome_ble_scan_result_t *out, size_t max, uint32_t timeout_ms);
+
+/**
+ * Get the number of packets dropped because the delivery queue was full
+ */
+uint32_t bthome_ble_scanner_get_dropped_count(void);
+
 /**
  * Get default scanner configuration
  * @param config Configuration structure to populate with defaults
  */
 void bthome_ble_scanner_get_default_config(bthome_ble_scanner_config_t *config);
 
+/**
+ * Initialize the BTHome BLE advertiser
+ * Initializes the BLE controller and GAP, unless the scanner already did
+ * @return ESP_OK on success, error code otherwise
+ */
+esp_err_t bthome_ble_advertiser_init(void);
+
+/**
+ * Deinitialize the BTHome BLE advertiser
+ * @return ESP_OK on success, error code otherwise
+ */
+esp_err_t bthome_ble_advertiser_deinit(void);
+
+/**
+ * Start broadcasting a BTHome packet
+ * The packet is copied and need not outlive the call.
+ * @param config Advertiser configuration
+ * @param packet The packet to broadcast (must fit in a 31-byte legacy advertisement)
+ * @return ESP_OK on success, ESP_ERR_INVALID_SIZE if the packet doesn't fit, error code otherwise
+ */
+esp_err_t bthome_ble_advertiser_start(const bthome_ble_advertiser_config_t *config,
+                                      const bthome_packet_t *packet);
+
+/**
+ * Replace the broadcast packet
+ * Updates the advertising data in place, without stopping and restarting advertising.
+ * @param packet The new packet to broadcast
+ * @return ESP_OK on success, ESP_ERR_INVALID_SIZE if the packet doesn't fit, error code otherwise
+ */
+esp_err_t bthome_ble_advertiser_update(const bthome_packet_t *packet);
+
+/**
+ * Broadcast the current packet again, with a new packet ID if auto_packet_id is set
+ * Patches the ID into the packet's cached encoding instead of encoding it again
+ * (see bthome_encode_advertisement_cached()), so a sensor can re-send unchanged
+ * readings every interval for the cost of a copy.
+ * @return ESP_OK on success, ESP_ERR_INVALID_STATE if not advertising, error code otherwise
+ */
+esp_err_t bthome_ble_advertiser_resend(void);
+
+/**
+ * Stop broadcasting
+ * @return ESP_OK on success, error code otherwise
+ */
+esp_err_t bthome_ble_advertiser_stop(void);
+
+/**
+ * Get default advertiser configuration
+ * @param config Configuration structure to populate with defaults
+ */
+void bthome_ble_advertiser_get_default_config(bthome_ble_advertiser_config_t *config);
+
 /**
  * Check if a BLE advertisement contains BTHome service data
  * @param adv_data Advertisement data
@@ -0,0 +1,37 @@
+#ifndef BTHOME_CONFIG_H
+#define BTHOME_CONFIG_H
+
+// Build options (see Kconfig). Host builds (tests, tools) have no sdkconfig.h and get
+// the defaults below, which can be overridden on the command line.
+#ifdef ESP_PLATFORM
+#include "sdkconfig.h"
+#else
+#ifndef CONFIG_BTHOME_ENCODER
+#define CONFIG_BTHOME_ENCODER 1
+#endif
+#ifndef CONFIG_BTHOME_DECODER
+#define CONFIG_BTHOME_DECODER 1
+#endif
+#ifndef CONFIG_BTHOME_OBJECT_STRINGS
+#define CONFIG_BTHOME_OBJECT_STRINGS 1
+#endif
+#ifndef CONFIG_BTHOME_NO_HEAP
+#define CONFIG_BTHOME_NO_HEAP 0
+#endif
+#if CONFIG_BTHOME_NO_HEAP
+#ifndef CONFIG_BTHOME_MAX_MEASUREMENTS
+#define CONFIG_BTHOME_MAX_MEASUREMENTS 16
+#endif
+#ifndef CONFIG_BTHOME_MAX_EVENTS
+#define CONFIG_BTHOME_MAX_EVENTS 4
+#endif
+#ifndef CONFIG_BTHOME_POOL_BLOCKS
+#define CONFIG_BTHOME_POOL_BLOCKS 32
+#endif
+#ifndef CONFIG_BTHOME_MAX_DATA_LEN
+#define CONFIG_BTHOME_MAX_DATA_LEN 32
+#endif
+#endif
+#endif
+
+#endif // BTHOME_CONFIG_H
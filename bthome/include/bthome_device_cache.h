@@ -0,0 +1,149 @@
+#ifndef BTHOME_DEVICE_CACHE_H
+#define BTHOME_DEVICE_CACHE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "bthome.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Number of devices remembered (least recently seen devices are forgotten first)
+#define BTHOME_DEVICE_CACHE_SIZE 32
+
+// Number of distinct names that can be interned (see CONFIG_BTHOME_NAME_POOL_SIZE)
+#ifdef CONFIG_BTHOME_NAME_POOL_SIZE
+#define BTHOME_NAME_POOL_SIZE CONFIG_BTHOME_NAME_POOL_SIZE
+#else
+#define BTHOME_NAME_POOL_SIZE 32
+#endif
+
+// Longest local name that fits a legacy advertisement
+#define BTHOME_NAME_MAX_LEN (BTHOME_ADV_MAX_LEN - 2)
+
+// Longest advertising data remembered per device (an advertisement plus its scan response)
+#define BTHOME_DEVICE_CACHE_ADV_LEN (2 * BTHOME_ADV_MAX_LEN)
+
+/**
+ * An interned device name
+ * The name is NUL-terminated, so it can also be used as a C string.
+ */
+typedef struct {
+    char name[BTHOME_NAME_MAX_LEN + 1];
+    uint8_t len;
+    bool complete;                 // Complete (0x09) rather than shortened (0x08) local name
+    uint32_t last_used;            // Cache clock value when the name was last interned
+} bthome_interned_name_t;
+
+/**
+ * A device seen by the cache
+ */
+typedef struct {
+    bool used;
+    uint8_t addr[6];
+    uint32_t last_seen;            // Cache clock value when the device was last seen
+    int16_t name;                  // Index into the name pool, -1 if no name is known
+    int8_t rssi;                   // RSSI of the last advertisement
+    bool has_packet_id;
+    uint8_t packet_id;             // Last packet ID received
+    uint8_t adv_len;               // Length of adv, 0 if nothing has been recorded
+    uint8_t adv[BTHOME_DEVICE_CACHE_ADV_LEN]; // Last advertising data, for re-decoding its values
+} bthome_device_entry_t;
+
+/**
+ * Per-device cache that interns device names and remembers each device's last advertisement
+ * Each distinct name is stored once and never moved, so packets can carry a pointer
+ * to it instead of copying the name. When the pool is full, the least recently used
+ * name that no remembered device uses is overwritten by the new one. The memory
+ * stays valid, but a packet kept from long before then (bthome_packet_copy() shares
+ * the name) may show the new name; copy the name itself to keep it for good.
+ * The cache contains no pointers, so it can be saved and restored as a single blob.
+ */
+typedef struct {
+    bthome_device_entry_t devices[BTHOME_DEVICE_CACHE_SIZE];
+    bthome_interned_name_t names[BTHOME_NAME_POOL_SIZE];
+    size_t name_count;
+    uint32_t clock;
+    uint32_t intern_failures;      // Names that couldn't be interned (too long, or every name in use)
+} bthome_device_cache_t;
+
+/**
+ * Initialize (or reset) a device cache
+ * Invalidates all names previously handed out by the cache.
+ */
+void bthome_device_cache_init(bthome_device_cache_t *cache);
+
+/**
+ * Look up a device, adding it if it hasn't been seen before
+ * @param cache The device cache
+ * @param addr The device's 6-byte BLE address
+ * @return The device's entry (never NULL; the least recently seen device is evicted if full)
+ */
+bthome_device_entry_t *bthome_device_cache_lookup(bthome_device_cache_t *cache, const uint8_t *addr);
+
+/**
+ * Find the name a device last advertised, without adding the device or touching its age
+ * @param cache The device cache
+ * @param addr The device's 6-byte BLE address
+ * @return The device's interned name, or NULL if the device or its name is unknown
+ */
+const bthome_interned_name_t *bthome_device_cache_find_name(const bthome_device_cache_t *cache,
+                                                            const uint8_t *addr);
+
+/**
+ * Remember a packet's device name for the device, leaving the packet unchanged
+ * Does nothing for a packet without a name.
+ * @param cache The device cache
+ * @param addr The device's 6-byte BLE address
+ * @param packet The packet carrying the name
+ * @return 0 on success, -1 if the name could not be interned (pool full or name too long)
+ */
+int bthome_device_cache_remember_name(bthome_device_cache_t *cache, const uint8_t *addr,
+                                      const bthome_packet_t *packet);
+
+/**
+ * Replace a packet's device name with the device's interned name
+ * A name in the packet is interned and remembered for the device; a packet without
+ * a name gets the last name the device advertised. Either way the packet's name is
+ * marked as shared, so bthome_packet_copy() and bthome_packet_free() leave it alone.
+ * @param cache The device cache
+ * @param addr The device's 6-byte BLE address
+ * @param packet The packet to update
+ * @return 0 on success, -1 if the name could not be interned (pool full or name too
+ *         long); the packet is left unchanged
+ */
+int bthome_device_cache_attach_name(bthome_device_cache_t *cache, const uint8_t *addr,
+                                    bthome_packet_t *packet);
+
+/**
+ * Remember a device's latest advertisement and packet ID
+ * @param cache The device cache
+ * @param addr The device's 6-byte BLE address
+ * @param rssi RSSI of the advertisement
+ * @param adv Advertising data the packet was decoded from
+ * @param len Length of adv (longer data is not recorded)
+ * @param packet The decoded packet
+ * @return The device's entry
+ */
+bthome_device_entry_t *bthome_device_cache_record(bthome_device_cache_t *cache, const uint8_t *addr,
+                                                  int rssi, const uint8_t *adv, size_t len,
+                                                  const bthome_packet_t *packet);
+
+/**
+ * Decode a device's last recorded advertisement
+ * The packet points into the cache entry and carries the device's interned name.
+ * @param cache The device cache
+ * @param entry The device's entry
+ * @param packet Output packet; release with bthome_packet_free()
+ * @return 0 on success, -1 if nothing has been recorded, or a bthome_decode_advertisement() error
+ */
+int bthome_device_cache_last_packet(const bthome_device_cache_t *cache, const bthome_device_entry_t *entry,
+                                    bthome_packet_t *packet);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // BTHOME_DEVICE_CACHE_H
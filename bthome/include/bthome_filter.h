@@ -0,0 +1,102 @@
+#ifndef BTHOME_FILTER_H
+#define BTHOME_FILTER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Maximum number of name prefixes in a filter
+#define BTHOME_FILTER_MAX_NAME_PREFIXES 4
+
+// Maximum length of a name prefix (longest local name that fits a legacy advertisement)
+#define BTHOME_FILTER_MAX_PREFIX_LEN 29
+
+// Event types that can be subscribed to
+#define BTHOME_FILTER_EVENT_BUTTON  (1 << 0)
+#define BTHOME_FILTER_EVENT_DIMMER  (1 << 1)
+
+/**
+ * Declarative subscription filter
+ * An advertisement matches when all of the configured criteria match:
+ * - it contains at least one subscribed object ID or event type (if any are set)
+ * - its local name starts with one of the name prefixes (if any are set); for an
+ *   advertisement without a name, the name the device last advertised is used
+ *   where known (see bthome_matcher_match_named())
+ * - its RSSI is at least min_rssi
+ */
+typedef struct {
+    uint32_t object_ids[8];        // Bitmask of subscribed object IDs (see bthome_filter_add_object())
+    uint8_t event_types;           // BTHOME_FILTER_EVENT_* bits
+    const char *name_prefixes[BTHOME_FILTER_MAX_NAME_PREFIXES]; // NUL-terminated, NULL = unused
+    int8_t min_rssi;               // RSSI floor in dBm
+} bthome_filter_t;
+
+/**
+ * Compiled form of a filter, evaluated directly on raw advertising data
+ * Holds copies of the name prefixes, so the source filter need not outlive it
+ */
+typedef struct {
+    uint32_t wanted_ids[8];        // Object IDs (including events) that make an advertisement relevant
+    bool any_content;              // No object or event criteria
+    int8_t min_rssi;
+    uint8_t prefix_count;
+    uint8_t prefix_lens[BTHOME_FILTER_MAX_NAME_PREFIXES];
+    char prefixes[BTHOME_FILTER_MAX_NAME_PREFIXES][BTHOME_FILTER_MAX_PREFIX_LEN];
+} bthome_matcher_t;
+
+/**
+ * Initialize a filter that matches every BTHome advertisement
+ */
+void bthome_filter_init(bthome_filter_t *filter);
+
+/**
+ * Subscribe to an object ID
+ */
+void bthome_filter_add_object(bthome_filter_t *filter, uint8_t object_id);
+
+/**
+ * Compile a filter into a matcher
+ * @param filter The filter to compile
+ * @param matcher Output matcher
+ * @return 0 on success, negative error code on failure (name prefix too long)
+ */
+int bthome_filter_compile(const bthome_filter_t *filter, bthome_matcher_t *matcher);
+
+/**
+ * Check raw advertising data against a compiled filter
+ * Walks the AD elements and BTHome objects once without decoding or allocating.
+ * Advertisements without (unencrypted) BTHome service data never match.
+ * @param matcher The compiled filter
+ * @param adv_data Advertising data
+ * @param adv_data_len Length of advertising data
+ * @param rssi RSSI of the advertisement
+ * @return true if the advertisement matches
+ */
+bool bthome_matcher_match(const bthome_matcher_t *matcher, const uint8_t *adv_data,
+                          size_t adv_data_len, int rssi);
+
+/**
+ * Check raw advertising data against a compiled filter, with a fallback name
+ * Like bthome_matcher_match(), but if the advertisement has no local name, the name
+ * prefixes are checked against known_name instead, e.g. the device's interned name.
+ * @param matcher The compiled filter
+ * @param adv_data Advertising data
+ * @param adv_data_len Length of advertising data
+ * @param rssi RSSI of the advertisement
+ * @param known_name Name the device is known by (NULL = none)
+ * @param known_name_len Length of known_name
+ * @return true if the advertisement matches
+ */
+bool bthome_matcher_match_named(const bthome_matcher_t *matcher, const uint8_t *adv_data,
+                                size_t adv_data_len, int rssi, const char *known_name,
+                                size_t known_name_len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // BTHOME_FILTER_H
@@ -0,0 +1,57 @@
+#ifndef BTHOME_HISTOGRAM_H
+#define BTHOME_HISTOGRAM_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Number of buckets: bucket 0 holds 0us, bucket i holds [2^(i-1), 2^i) us, and the last
+// bucket everything from 2^(BTHOME_HISTOGRAM_BUCKETS-2) us (about 4 s) up
+#define BTHOME_HISTOGRAM_BUCKETS 24
+
+/**
+ * Log-scale histogram of durations in microseconds
+ * Recording is a handful of instructions and never allocates. Each field is a
+ * naturally aligned 32-bit word updated by a single writer, so readers can copy the
+ * histogram while it is being recorded into; the copy may be one sample out of step
+ * between fields, but never torn within one.
+ */
+typedef struct {
+    uint32_t buckets[BTHOME_HISTOGRAM_BUCKETS];
+    uint32_t count;
+    uint32_t total_us;             // Sum of all samples (wraps after about 71 minutes of samples)
+    uint32_t max_us;
+} bthome_histogram_t;
+
+/**
+ * Clear a histogram
+ */
+void bthome_histogram_reset(bthome_histogram_t *histogram);
+
+/**
+ * Record one duration
+ */
+void bthome_histogram_record(bthome_histogram_t *histogram, uint32_t duration_us);
+
+/**
+ * Lower bound of a bucket in microseconds
+ */
+uint32_t bthome_histogram_bucket_floor(size_t bucket);
+
+/**
+ * Estimate a percentile
+ * @param histogram The histogram
+ * @param percent Percentile, 0-100
+ * @return Upper bound of the bucket holding the percentile (capped at max_us), 0 if empty
+ */
+uint32_t bthome_histogram_percentile(const bthome_histogram_t *histogram, uint8_t percent);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // BTHOME_HISTOGRAM_H
@@ -0,0 +1,129 @@
+#ifndef BTHOME_HISTORY_H
+#define BTHOME_HISTORY_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "bthome.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Size of a history block, including its header
+#define BTHOME_HISTORY_BLOCK_SIZE 256
+
+// Marks the end of a block list
+#define BTHOME_HISTORY_NONE 0xFFFF
+
+/**
+ * A block of compressed samples
+ * The first sample is stored in the header; the rest are bit-packed as delta-of-delta
+ * timestamps and zig-zag value deltas, so every block decodes on its own.
+ */
+typedef struct {
+    int64_t first_value;
+    uint32_t first_timestamp;
+    uint16_t next;                 // Next (newer) block of the series, or BTHOME_HISTORY_NONE
+    uint16_t series;               // Owning series, or BTHOME_HISTORY_NONE if free
+    uint16_t count;                // Number of samples
+    uint16_t bits;                 // Bits used in data
+    uint8_t data[BTHOME_HISTORY_BLOCK_SIZE - 20];
+} bthome_history_block_t;
+
+/**
+ * History of one object of one device
+ */
+typedef struct {
+    uint8_t addr[6];
+    uint8_t object_id;
+    uint8_t instance;              // Which occurrence of object_id in the packet (0 = first)
+    uint16_t head;                 // Oldest block
+    uint16_t tail;                 // Block being appended to
+    uint32_t last_timestamp;       // Encoder state of the tail block
+    int64_t last_value;
+    int64_t last_delta;
+} bthome_history_series_t;
+
+/**
+ * Compressed per-device, per-object time series store
+ * Series and blocks live in a caller-provided memory region, which may be in PSRAM.
+ * When all blocks are in use the oldest block of any series is reused, so the store
+ * always holds the most recent history that fits.
+ */
+typedef struct {
+    bthome_history_series_t *series;
+    size_t max_series;
+    size_t series_count;
+    bthome_history_block_t *blocks;
+    size_t block_count;
+    uint16_t free_block;           // Head of the free block list
+} bthome_history_t;
+
+/**
+ * Iterator over a range of samples
+ * Invalidated by appending to the store.
+ */
+typedef struct {
+    const bthome_history_t *history;
+    uint16_t block;                // Current block, or BTHOME_HISTORY_NONE when done
+    uint16_t index;                // Index of the next sample within the block
+    uint16_t bit;                  // Bit position of the next sample within the block
+    uint32_t timestamp;            // Last decoded sample
+    int64_t value;
+    int64_t delta;
+    uint32_t from;
+    uint32_t to;
+} bthome_history_iter_t;
+
+/**
+ * Initialize a history store over a memory region
+ * @param history The store
+ * @param mem Memory for series and blocks (8-byte aligned), e.g. from
+ *            heap_caps_malloc(size, MALLOC_CAP_SPIRAM)
+ * @param size Size of mem in bytes
+ * @param max_series Maximum number of (device, object) series
+ * @return 0 on success, -1 if the region can't hold the series table and at least one block
+ */
+int bthome_history_init(bthome_history_t *history, void *mem, size_t size, size_t max_series);
+
+/**
+ * Append a sample to a series, creating the series if needed
+ * @param history The store
+ * @param addr The device's 6-byte BLE address
+ * @param object_id The object ID
+ * @param instance Which occurrence of object_id in the packet (0 = first)
+ * @param timestamp Sample time in any unit (e.g. seconds); must not go backwards
+ * @param value Unscaled measurement value
+ * @return 0 on success, -1 if the series table is full, -2 if the timestamp is older than
+ *         the series' last sample
+ */
+int bthome_history_append(bthome_history_t *history, const uint8_t *addr, uint8_t object_id,
+                          uint8_t instance, uint32_t timestamp, int64_t value);
+
+/**
+ * Append every fixed-size measurement of a packet
+ * Text and raw measurements are skipped.
+ * @return Number of samples appended, or the first negative error from bthome_history_append()
+ */
+int bthome_history_append_packet(bthome_history_t *history, const uint8_t *addr,
+                                 const bthome_packet_t *packet, uint32_t timestamp);
+
+/**
+ * Start iterating over a series' samples with from <= timestamp <= to
+ * @return 0 on success, -1 if there is no such series
+ */
+int bthome_history_query(const bthome_history_t *history, const uint8_t *addr, uint8_t object_id,
+                         uint8_t instance, uint32_t from, uint32_t to, bthome_history_iter_t *iter);
+
+/**
+ * Get the next sample in the range
+ * @return true if a sample was returned, false at the end of the range
+ */
+bool bthome_history_next(bthome_history_iter_t *iter, uint32_t *timestamp, int64_t *value);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // BTHOME_HISTORY_H
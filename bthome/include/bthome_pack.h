@@ -0,0 +1,76 @@
+#ifndef BTHOME_PACK_H
+#define BTHOME_PACK_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "bthome.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Schedule entry for a slot in which nothing needs to be sent
+#define BTHOME_PACK_IDLE 0xFF
+
+/**
+ * One advertisement produced by bthome_pack_advertisements()
+ */
+typedef struct {
+    uint8_t data[BTHOME_ADV_MAX_LEN]; // Complete advertising data
+    uint8_t len;                   // Length of data
+    uint32_t interval_ms;          // Longest interval that still meets every contained reading's interval
+    int8_t packet_id_offset;       // Offset of the packet ID value within data, or -1 if none
+} bthome_packed_adv_t;
+
+/**
+ * Split a packet over as few legacy advertisements as possible
+ * Every advertisement repeats the device info, the flags (if requested) and
+ * the packet ID (if set). The device name is included in each advertisement
+ * that has room for it. Events travel in the advertisement with the shortest interval.
+ *
+ * Readings are placed first-fit in order of increasing interval, so readings
+ * needed often share advertisements and slower readings fill the space left over.
+ * With CONFIG_BTHOME_NO_HEAP the working state is on the stack, about 90 bytes per
+ * measurement and event the packet can hold.
+ * @param packet The packet to split
+ * @param intervals_ms Required on-air interval of each measurement (NULL = all equal)
+ * @param include_flags Include the flags AD element in each advertisement
+ * @param out Output advertisements
+ * @param max_out Capacity of out
+ * @return Number of advertisements, or negative error code
+ *         (-1 a single object doesn't fit in an advertisement, -2 out is too small,
+ *         -5 out of memory)
+ */
+int bthome_pack_advertisements(const bthome_packet_t *packet, const uint32_t *intervals_ms,
+                               bool include_flags, bthome_packed_adv_t *out, size_t max_out);
+
+/**
+ * Set the packet ID of a packed advertisement in place
+ */
+void bthome_pack_set_packet_id(bthome_packed_adv_t *adv, uint8_t packet_id);
+
+/**
+ * Build a rotation schedule for packed advertisements
+ * Time is divided into advertising slots of slot_ms, each of which sends at most one
+ * advertisement. Each advertisement is sent at least once per interval_ms. Intervals are
+ * kept exact when possible; otherwise they are shortened to multiples of the shortest
+ * one by powers of two, so no advertisement is sent more than twice as often as needed.
+ * Advertisements without an interval (interval_ms 0, as packed with intervals_ms NULL)
+ * are sent round-robin, once every count slots.
+ * @param advs Packed advertisements
+ * @param count Number of advertisements
+ * @param slot_ms Length of an advertising slot
+ * @param schedule Output: advertisement index for each slot of one cycle, or BTHOME_PACK_IDLE
+ * @param max_slots Capacity of schedule
+ * @return Number of slots in the cycle, or negative error code
+ *         (-1 the advertisements need more than one per slot, -2 schedule is too small)
+ */
+int bthome_pack_schedule(const bthome_packed_adv_t *advs, size_t count, uint32_t slot_ms,
+                         uint8_t *schedule, size_t max_slots);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // BTHOME_PACK_H
@@ -0,0 +1,103 @@
+#ifndef BTHOME_POLICY_H
+#define BTHOME_POLICY_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "bthome.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Number of object IDs that can have their own deadband
+#define BTHOME_POLICY_MAX_RULES 16
+
+// Measurements remembered from the last sent packet (more than a legacy advertisement holds)
+#define BTHOME_POLICY_MAX_VALUES 16
+
+/**
+ * Why a sample has to be sent
+ */
+typedef enum {
+    BTHOME_POLICY_SKIP = 0,        // Nothing worth sending
+    BTHOME_POLICY_FIRST,           // Nothing sent yet
+    BTHOME_POLICY_EVENT,           // The packet carries a button or dimmer event
+    BTHOME_POLICY_BINARY,          // A binary sensor changed state
+    BTHOME_POLICY_CHANGE,          // A measurement left its deadband, or the set of objects changed
+    BTHOME_POLICY_HEARTBEAT,       // Silent for the heartbeat interval
+} bthome_policy_reason_t;
+
+/**
+ * Deadband of one object ID, in scaled units (e.g. °C for temperature)
+ */
+typedef struct {
+    uint8_t object_id;
+    float absolute;                // Changes up to this size are not sent
+    float relative;                // Changes up to this fraction of the last sent value are not sent
+} bthome_policy_rule_t;
+
+/**
+ * A measurement as last sent
+ */
+typedef struct {
+    uint8_t object_id;
+    int64_t raw;                   // Raw integer value; a hash of the bytes for text and raw objects
+} bthome_policy_value_t;
+
+/**
+ * Sensor-side advertising policy
+ * Decides per sample whether a packet has to be advertised: binary sensor changes and
+ * events go out at once, other measurements when they move out of their deadband
+ * around the last value sent, and an unchanged packet once per heartbeat interval.
+ * Driven by the caller's clock, so recorded traces can be replayed through it.
+ */
+typedef struct {
+    uint32_t heartbeat_ms;         // Longest silence (0 = none)
+    bthome_policy_rule_t rules[BTHOME_POLICY_MAX_RULES];
+    size_t rule_count;
+    bool sent;                     // A packet has been sent
+    uint32_t sent_ms;              // When the last packet was sent
+    bthome_policy_value_t values[BTHOME_POLICY_MAX_VALUES];
+    size_t value_count;
+} bthome_policy_t;
+
+/**
+ * Initialize a policy; without deadbands every change is sent
+ * @param policy Policy to initialize
+ * @param heartbeat_ms Send an unchanged packet after this long (0 = never)
+ */
+void bthome_policy_init(bthome_policy_t *policy, uint32_t heartbeat_ms);
+
+/**
+ * Set the deadband of an object ID
+ * A change is sent when it exceeds both the absolute and the relative deadband, so the
+ * absolute one acts as a floor for a relative deadband around values near zero.
+ * Binary sensors, text and raw objects ignore deadbands: any change is sent.
+ * @param policy The policy
+ * @param object_id Object ID the deadband applies to (every instance of it)
+ * @param absolute Absolute deadband in scaled units
+ * @param relative Relative deadband (e.g. 0.05 for 5%)
+ * @return 0 on success, -1 if BTHOME_POLICY_MAX_RULES object IDs already have one
+ */
+int bthome_policy_set_deadband(bthome_policy_t *policy, uint8_t object_id, float absolute,
+                               float relative);
+
+/**
+ * Decide whether a sample has to be advertised, and remember it as sent if so
+ * Measurements are compared with the last sent packet by position, so build every
+ * sample with the same objects in the same order. Packets with more than
+ * BTHOME_POLICY_MAX_VALUES measurements are always sent.
+ * @param policy The policy
+ * @param packet The current sample
+ * @param now_ms Current time in milliseconds
+ * @return BTHOME_POLICY_SKIP, or why the packet has to be sent
+ */
+bthome_policy_reason_t bthome_policy_sample(bthome_policy_t *policy, const bthome_packet_t *packet,
+                                            uint32_t now_ms);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // BTHOME_POLICY_H
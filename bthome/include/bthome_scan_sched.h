@@ -0,0 +1,108 @@
+#ifndef BTHOME_SCAN_SCHED_H
+#define BTHOME_SCAN_SCHED_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Number of devices whose advertising period is tracked (least recently seen devices are forgotten first)
+#define BTHOME_SCAN_SCHED_MAX_DEVICES 32
+
+// Shortest scan interval/window the controller accepts (units of 0.625ms)
+#define BTHOME_SCAN_SCHED_MIN_UNITS 0x0004
+
+// Longest scan interval the controller accepts (units of 0.625ms, 10.24s)
+#define BTHOME_SCAN_SCHED_MAX_UNITS 0x4000
+
+/**
+ * Adaptive scan scheduler configuration
+ */
+typedef struct {
+    uint16_t scan_window;          // Scan window (units of 0.625ms); only the interval is adapted
+    uint16_t max_scan_interval;    // Longest scan interval (units of 0.625ms)
+    uint16_t min_duty_permille;    // Lowest duty cycle, which keeps discovering new devices
+    uint32_t target_latency_ms;    // Hear every periodic device at least once this often (~95% of the time)
+    uint32_t learn_ms;             // Scan continuously this long after init to learn periods
+    uint32_t burst_ms;             // Scan continuously this long after a trigger-based packet
+    uint32_t hold_ms;              // Least time between interval changes (bursts excepted)
+} bthome_scan_sched_config_t;
+
+/**
+ * A device whose advertising period is tracked
+ */
+typedef struct {
+    bool used;
+    uint8_t addr[6];
+    bool trigger_based;            // Advertises irregularly; bursts instead of having a period
+    uint32_t last_seen_ms;
+    uint32_t period_ms;            // Estimated advertising period (0 = not known yet)
+    uint32_t long_gap_ms;          // Shortest of the consecutive gaps well above period_ms
+    uint8_t long_gaps;             // Number of such gaps in a row
+} bthome_scan_sched_device_t;
+
+/**
+ * Scan scheduler that learns each device's advertising period and picks the longest
+ * scan interval that still hears every periodic device within the target latency
+ * Driven entirely by the caller's clock, so it can be run against a simulated one.
+ */
+typedef struct {
+    bthome_scan_sched_config_t config;
+    bthome_scan_sched_device_t devices[BTHOME_SCAN_SCHED_MAX_DEVICES];
+    uint32_t start_ms;             // When the scheduler was initialized
+    bool learning;                 // Still within learn_ms of start_ms
+    uint32_t burst_until_ms;       // End of the current burst
+    bool bursting;
+    uint32_t changed_ms;           // When the interval last changed
+    uint16_t scan_interval;        // Current scan interval (units of 0.625ms)
+    uint16_t scan_window;          // Current scan window (units of 0.625ms)
+} bthome_scan_sched_t;
+
+/**
+ * Get default scheduler configuration
+ * (30ms window, 5 minute target latency, duty cycle between 5% and 100%)
+ */
+void bthome_scan_sched_get_default_config(bthome_scan_sched_config_t *config);
+
+/**
+ * Initialize a scheduler; it starts out scanning continuously while it learns
+ * @param sched Scheduler to initialize
+ * @param config Configuration (copied)
+ * @param now_ms Current time in milliseconds
+ */
+void bthome_scan_sched_init(bthome_scan_sched_t *sched, const bthome_scan_sched_config_t *config,
+                            uint32_t now_ms);
+
+/**
+ * Record a received packet
+ * @param sched The scheduler
+ * @param addr Address of the device
+ * @param trigger_based Whether the packet's device info has the trigger-based flag set
+ * @param now_ms Current time in milliseconds
+ * @return true if scan_interval or scan_window changed
+ */
+bool bthome_scan_sched_observe(bthome_scan_sched_t *sched, const uint8_t addr[6], bool trigger_based,
+                               uint32_t now_ms);
+
+/**
+ * Re-evaluate the scan parameters; call periodically (e.g. every second)
+ * Ends bursts and forgets devices that have gone quiet.
+ * @param sched The scheduler
+ * @param now_ms Current time in milliseconds
+ * @return true if scan_interval or scan_window changed
+ */
+bool bthome_scan_sched_update(bthome_scan_sched_t *sched, uint32_t now_ms);
+
+/**
+ * Get the current duty cycle (scan window / scan interval) in permille
+ */
+uint16_t bthome_scan_sched_duty_permille(const bthome_scan_sched_t *sched);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // BTHOME_SCAN_SCHED_H
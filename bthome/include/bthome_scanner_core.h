@@ -0,0 +1,104 @@
+#ifndef BTHOME_SCANNER_CORE_H
+#define BTHOME_SCANNER_CORE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "bthome.h"
+#include "bthome_filter.h"
+#include "bthome_device_cache.h"
+#include "bthome_scan_sched.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Radio-independent part of the scanner: filtering, decoding, per-device state and
+ * scan scheduling for advertising reports from any source
+ * The ESP-IDF scanner (bthome_ble.h) feeds it from the GAP event handler; host tools
+ * can feed it from a simulated radio. It does no locking of its own.
+ */
+typedef struct {
+    bthome_matcher_t matcher;      // Compiled subscription filter (matches all BTHome adverts by default)
+    bool intern_names;             // Attach each device's interned name to its packets
+    bool adaptive;                 // Run the scan scheduler
+    bthome_device_cache_t device_cache; // Interned names and last advertisements, kept across configure
+    bthome_scan_sched_t sched;     // Scan scheduler, valid if adaptive
+} bthome_scanner_core_t;
+
+/**
+ * Initialize a scanner core that accepts every BTHome advertisement
+ */
+void bthome_scanner_core_init(bthome_scanner_core_t *core);
+
+/**
+ * Set up the core for a scan; the device cache is kept
+ * @param core The scanner core
+ * @param filter Subscription filter to compile (NULL = all BTHome adverts)
+ * @param intern_names Attach each device's interned name to its packets
+ * @param adaptive Scan scheduler configuration (NULL = fixed scan parameters)
+ * @param now_ms Current time in milliseconds
+ * @return 0 on success, -1 if the filter is invalid (the core is left unchanged)
+ */
+int bthome_scanner_core_configure(bthome_scanner_core_t *core, const bthome_filter_t *filter,
+                                  bool intern_names, const bthome_scan_sched_config_t *adaptive,
+                                  uint32_t now_ms);
+
+/**
+ * Filter and decode an advertising report
+ * Only reads the core, so it can run outside the lock guarding bthome_scanner_core_record()
+ * as long as it runs on the same thread. With name prefixes set, an advertisement without
+ * a local name is matched by the name the device last advertised.
+ * @param core The scanner core
+ * @param addr Address of the device
+ * @param adv_data Advertising data (possibly followed by its scan response)
+ * @param adv_data_len Length of advertising data
+ * @param rssi RSSI of the report
+ * @param packet Output packet, to be freed with bthome_packet_free() on success
+ * @return 0 if decoded, 1 if filtered out, negative bthome_decode_advertisement() error otherwise
+ */
+int bthome_scanner_core_decode(const bthome_scanner_core_t *core, const uint8_t addr[6],
+                               const uint8_t *adv_data, size_t adv_data_len, int rssi,
+                               bthome_packet_t *packet);
+
+/**
+ * Record a decoded packet: remember the device's advertisement, attach its interned
+ * name (if enabled, otherwise only remember it when filtering by name prefix) and
+ * update the scan scheduler (if adaptive)
+ * @param core The scanner core
+ * @param addr Address of the device
+ * @param rssi RSSI of the report
+ * @param adv_data Advertising data the packet was decoded from
+ * @param adv_data_len Length of advertising data
+ * @param packet The decoded packet
+ * @param now_ms Current time in milliseconds
+ * @return true if the scheduler changed the scan parameters
+ */
+bool bthome_scanner_core_record(bthome_scanner_core_t *core, const uint8_t addr[6], int rssi,
+                                const uint8_t *adv_data, size_t adv_data_len, bthome_packet_t *packet,
+                                uint32_t now_ms);
+
+/**
+ * Combine a held advertisement with the report of its scan response
+ * Bluedroid reports a scan response with the device's cached advertisement in front
+ * of it (report_adv_len bytes), so only the scan response bytes after that are
+ * appended to the held advertisement.
+ * @param adv The held advertisement
+ * @param adv_len Length of adv
+ * @param report Advertising data of the scan response report
+ * @param report_adv_len Length of the advertisement at the start of report
+ * @param scan_rsp_len Length of the scan response after it
+ * @param out Output buffer (2 * BTHOME_ADV_MAX_LEN is enough for legacy advertising)
+ * @param cap Capacity of out
+ * @return Length of the merged data, or -1 if it doesn't fit
+ */
+int bthome_scanner_core_merge_response(const uint8_t *adv, size_t adv_len, const uint8_t *report,
+                                       size_t report_adv_len, size_t scan_rsp_len, uint8_t *out,
+                                       size_t cap);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // BTHOME_SCANNER_CORE_H
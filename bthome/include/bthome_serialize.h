@@ -0,0 +1,99 @@
+#ifndef BTHOME_SERIALIZE_H
+#define BTHOME_SERIALIZE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "bthome.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Maximum length of precomputed line protocol tags (MAC plus a fully escaped local name)
+#define BTHOME_LP_TAGS_MAX_LEN 96
+
+/**
+ * Precomputed InfluxDB line protocol tags for one device
+ * Build once per device with bthome_lp_tags_init() and reuse for every packet.
+ */
+typedef struct {
+    char text[BTHOME_LP_TAGS_MAX_LEN]; // ",mac=A4:C1:38:0A:1B:2C,name=Kitchen" (escaped, not NUL-terminated)
+    uint8_t len;
+} bthome_lp_tags_t;
+
+/**
+ * Reusable batch of line protocol records in a caller-provided buffer
+ * The buffer holds complete lines only and is always NUL-terminated, so it can be
+ * written as a single request body and then reset.
+ */
+typedef struct {
+    char *buf;
+    size_t cap;
+    size_t len;                    // Bytes used, excluding the NUL
+    size_t lines;                  // Number of records in the batch
+} bthome_lp_batch_t;
+
+/**
+ * Serialize a decoded packet as a JSON object
+ * Writes straight into buf without allocating or using floating point. Scaled values
+ * are written as exact decimals, text as a JSON string and raw data as a hex string:
+ *
+ *   {"mac":"A4:C1:38:00:00:01","rssi":-60,"name":"Kitchen","packet_id":9,
+ *    "measurements":[{"id":2,"name":"temperature","value":25.00,"unit":"°C"}],
+ *    "events":[{"id":58,"name":"button","event":1}]}
+ *
+ * @param packet The packet to serialize
+ * @param mac The sender's 6-byte BLE address, or NULL to leave out "mac" and "rssi"
+ * @param rssi RSSI of the advertisement
+ * @param buf Output buffer; always NUL-terminated if cap > 0
+ * @param cap Size of buf
+ * @return Length of the complete JSON text (excluding the NUL). If this is cap or more the
+ *         output was truncated, and cap must be at least the return value + 1.
+ */
+size_t bthome_packet_to_json(const bthome_packet_t *packet, const uint8_t *mac, int rssi,
+                             char *buf, size_t cap);
+
+/**
+ * Precompute the line protocol tags for a device
+ * @param tags Output tags
+ * @param mac The device's 6-byte BLE address
+ * @param name The device's name (not NUL-terminated), or NULL to leave out the name tag
+ * @param name_len Length of name
+ * @return 0 on success, -1 if the escaped name doesn't fit
+ */
+int bthome_lp_tags_init(bthome_lp_tags_t *tags, const uint8_t *mac, const char *name, size_t name_len);
+
+/**
+ * Initialize an empty batch over a caller-provided buffer
+ */
+void bthome_lp_batch_init(bthome_lp_batch_t *batch, char *buf, size_t cap);
+
+/**
+ * Empty a batch after it has been written, keeping its buffer
+ */
+void bthome_lp_batch_reset(bthome_lp_batch_t *batch);
+
+/**
+ * Append a packet to a batch, one record per measurement and event
+ * Each record is "<object name>,id=<object ID><tags> value=<scaled value> <timestamp>", e.g.
+ * "temperature,id=0x02,mac=A4:C1:38:0A:1B:2C,name=Kitchen value=25.00 1700000000000000000".
+ * The id tag keeps objects that share a name (battery % and battery low) apart.
+ * Events are written with integer "event" (and "steps") fields. When an object
+ * appears more than once in a packet, its later records get an ",index=N" tag
+ * (1 = second occurrence) after the id tag so they stay separate series. Either the whole
+ * packet is appended or, if it doesn't fit, nothing is.
+ * @param batch The batch
+ * @param tags The sending device's tags
+ * @param packet The packet to append
+ * @param timestamp_ns Timestamp in nanoseconds since the epoch (0 = let the server assign it)
+ * @return Number of records appended, or -1 if the batch is too full
+ */
+int bthome_lp_append(bthome_lp_batch_t *batch, const bthome_lp_tags_t *tags,
+                     const bthome_packet_t *packet, uint64_t timestamp_ns);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // BTHOME_SERIALIZE_H
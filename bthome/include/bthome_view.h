@@ -0,0 +1,75 @@
+#ifndef BTHOME_VIEW_H
+#define BTHOME_VIEW_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "bthome.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Maximum number of objects in a view (every object takes at least two bytes of a
+// legacy advertisement, so 31 is more than can ever be broadcast)
+#define BTHOME_VIEW_MAX_OBJECTS 31
+
+/**
+ * Zero-copy indexed view over BTHome service data
+ * Records where each object starts instead of decoding it, so values are read
+ * straight from the original buffer, which must outlive the view.
+ */
+typedef struct {
+    const uint8_t *data;           // Service data (starting with UUID)
+    size_t len;                    // Length of the service data
+    bthome_device_info_t device_info;
+    uint8_t object_count;          // Number of indexed objects (including packet ID and events)
+    uint8_t offsets[BTHOME_VIEW_MAX_OBJECTS]; // Offset of each object ID byte within data
+    uint8_t first[BTHOME_VIEW_MAX_OBJECTS];   // Index of the first object of each distinct ID
+    uint32_t present[8];           // Bitmap of object IDs present
+    bool sorted;                   // Objects appear in ascending object ID order
+} bthome_view_t;
+
+/**
+ * Validate BTHome service data and index its objects
+ * @param view Output view
+ * @param data The service data payload (starting with UUID)
+ * @param len Length of the service data
+ * @return 0 on success, negative error code on failure (same codes as bthome_decode(),
+ *         or -6 if there are more than BTHOME_VIEW_MAX_OBJECTS objects)
+ */
+int bthome_view_init(bthome_view_t *view, const uint8_t *data, size_t len);
+
+/**
+ * Check if the view contains an object ID
+ */
+bool bthome_view_has(const bthome_view_t *view, uint8_t object_id);
+
+/**
+ * Get a measurement by object ID
+ * Text and raw values point into the viewed buffer.
+ * @param view The view
+ * @param object_id The object ID to look up
+ * @param instance Which occurrence of the object ID (0 = first)
+ * @param out Output measurement
+ * @return 0 on success, -1 if not present, -2 if the object is an event
+ */
+int bthome_view_get(const bthome_view_t *view, uint8_t object_id, uint8_t instance,
+                    bthome_measurement_t *out);
+
+/**
+ * Get an event by event type
+ * @param view The view
+ * @param event_type BTHOME_EVENT_BUTTON or BTHOME_EVENT_DIMMER
+ * @param instance Which occurrence of the event (0 = first)
+ * @param out Output event
+ * @return 0 on success, -1 if not present, -2 if the object is not an event
+ */
+int bthome_view_get_event(const bthome_view_t *view, uint8_t event_type, uint8_t instance,
+                          bthome_event_t *out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // BTHOME_VIEW_H
@@ -0,0 +1,53 @@
+#ifndef BTHOME_INTERNAL_H
+#define BTHOME_INTERNAL_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "bthome.h"
+
+// Helpers shared between the component's source files; not part of the public API
+
+/**
+ * Get the number of bytes an object's value occupies in service data
+ * Includes the length byte of variable-length objects and the steps byte of dimmer events
+ * @param object_id The object ID
+ * @param data The bytes following the object ID
+ * @param len Number of bytes available at data
+ * @return Value length, or 0 if the value is truncated
+ */
+size_t bthome_value_len(uint8_t object_id, const uint8_t *data, size_t len);
+
+/**
+ * Read a fixed-size little-endian value (1 to 4 bytes)
+ */
+void bthome_read_value(const uint8_t *data, uint8_t size, bool is_signed, bthome_value_t *value);
+
+/**
+ * Get an object's scaling factor as multiplier / 10^decimals
+ * Objects without scaling have multiplier 1 and decimals 0.
+ */
+void bthome_get_decimal_scale(uint8_t object_id, uint8_t *multiplier, uint8_t *decimals);
+
+/**
+ * Get a fixed-size measurement's unscaled value
+ * Returns 0 for text and raw measurements.
+ */
+int64_t bthome_get_raw_value(const bthome_measurement_t *measurement);
+
+/**
+ * Allocate through the allocator set with bthome_set_allocator()
+ */
+void *bthome_malloc(size_t size);
+
+/**
+ * Reallocate through the current allocator; NULL ptr allocates
+ */
+void *bthome_realloc(void *ptr, size_t size);
+
+/**
+ * Free through the current allocator; NULL is ignored
+ */
+void bthome_free(void *ptr);
+
+#endif // BTHOME_INTERNAL_H
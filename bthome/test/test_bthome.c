@@ -1,7 +1,9 @@
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <math.h>
 #include "unity.h"
+#include "esp_timer.h"
 #include "bthome.h"
 
 void setUp(void) {
@@ -294,6 +296,37 @@ void test_text_sensor(void) {
     bthome_packet_free(&decoded);
 }
 
+// Test that a copy of a decoded text sensor no longer references the source buffer
+void test_packet_copy_decoded_text(void) {
+    bthome_packet_t packet;
+    bthome_packet_init(&packet);
+    bthome_set_device_info(&packet, false, false);
+    
+    const char *text = "Hello World!";
+    bthome_add_sensor_text(&packet, text, strlen(text));
+    
+    uint8_t buffer[64];
+    int encoded_len = bthome_encode(&packet, buffer, sizeof(buffer));
+    TEST_ASSERT_GREATER_THAN(0, encoded_len);
+    
+    bthome_packet_t decoded;
+    int result = bthome_decode(buffer, encoded_len, &decoded);
+    TEST_ASSERT_EQUAL_INT(0, result);
+    
+    bthome_packet_t copy;
+    result = bthome_packet_copy(&copy, &decoded);
+    TEST_ASSERT_EQUAL_INT(0, result);
+    bthome_packet_free(&decoded);
+    memset(buffer, 0, sizeof(buffer));
+    
+    TEST_ASSERT_EQUAL_size_t(1, copy.measurement_count);
+    TEST_ASSERT_EQUAL_size_t(strlen(text), copy.measurements[0].value.bytes_val.len);
+    TEST_ASSERT_EQUAL_MEMORY(text, copy.measurements[0].value.bytes_val.data, strlen(text));
+    
+    bthome_packet_free(&packet);
+    bthome_packet_free(&copy);
+}
+
 // Test raw sensor
 void test_raw_sensor(void) {
     bthome_packet_t packet;
@@ -515,6 +548,247 @@ void test_device_name_too_long(void) {
     bthome_packet_free(&packet);
 }
 
+// Test an advertisement followed by its scan response, as merged by an active scan
+void test_decode_merged_scan_response(void) {
+    uint8_t data[] = {
+        // Advertisement: flags, temperature 25.00
+        0x02, 0x01, 0x06,
+        0x07, 0x16, 0xD2, 0xFC, 0x40, 0x02, 0xC4, 0x09,
+        // Scan response: name, unrelated service data, humidity 50.55
+        0x07, 0x09, 'S', 'e', 'n', 's', 'o', 'r',
+        0x04, 0x16, 0x0F, 0x18, 0x64,
+        0x07, 0x16, 0xD2, 0xFC, 0x40, 0x03, 0xBF, 0x13,
+    };
+    
+    bthome_packet_t packet;
+    int result = bthome_decode_advertisement(data, sizeof(data), &packet);
+    
+    TEST_ASSERT_EQUAL_INT(0, result);
+    TEST_ASSERT_EQUAL_size_t(2, packet.measurement_count);
+    TEST_ASSERT_EQUAL_UINT8(BTHOME_SENSOR_TEMPERATURE, packet.measurements[0].object_id);
+    TEST_ASSERT_EQUAL_INT16(2500, packet.measurements[0].value.sint16_val);
+    TEST_ASSERT_EQUAL_UINT8(BTHOME_SENSOR_HUMIDITY, packet.measurements[1].object_id);
+    TEST_ASSERT_EQUAL_UINT16(5055, packet.measurements[1].value.uint16_val);
+    TEST_ASSERT_NOT_NULL(packet.device_name);
+    TEST_ASSERT_EQUAL_MEMORY("Sensor", packet.device_name, 6);
+    
+    bthome_packet_free(&packet);
+}
+
+// Test exact decimal formatting of scaled values
+void test_format_value(void) {
+    bthome_packet_t packet;
+    bthome_packet_init(&packet);
+    bthome_add_sensor_sint16(&packet, BTHOME_SENSOR_TEMPERATURE, -5);
+    bthome_add_sensor_uint24(&packet, BTHOME_SENSOR_PRESSURE, 16777215);
+    bthome_add_sensor_sint8(&packet, BTHOME_SENSOR_TEMPERATURE_SINT8_035, -128);
+    bthome_add_sensor_uint16(&packet, BTHOME_SENSOR_VOLTAGE, 3001);
+    bthome_add_sensor_uint8(&packet, BTHOME_SENSOR_BATTERY, 100);
+    bthome_add_sensor_sint32(&packet, BTHOME_SENSOR_POWER_SINT32, INT32_MIN);
+    bthome_add_sensor_text(&packet, "on", 2);
+    const uint8_t raw[] = { 0xDE, 0xAD };
+    bthome_add_sensor_raw(&packet, raw, sizeof(raw));
+    
+    const char *expected[] = { "-0.05", "167772.15", "-44.80", "3.001", "100",
+                               "-21474836.48", "on", "DEAD" };
+    char buf[BTHOME_VALUE_STR_LEN];
+    for (size_t i = 0; i < packet.measurement_count; i++) {
+        size_t len = bthome_format_value(&packet.measurements[i], buf, sizeof(buf));
+        TEST_ASSERT_EQUAL_STRING(expected[i], buf);
+        TEST_ASSERT_EQUAL_size_t(strlen(expected[i]), len);
+    }
+    
+    // Truncation reports the full length
+    char small[4];
+    TEST_ASSERT_EQUAL_size_t(9, bthome_format_value(&packet.measurements[1], small, sizeof(small)));
+    TEST_ASSERT_EQUAL_STRING("167", small);
+    TEST_ASSERT_EQUAL_size_t(4, bthome_format_value(&packet.measurements[7], small, sizeof(small)));
+    TEST_ASSERT_EQUAL_STRING("DE", small);
+    
+    bthome_packet_free(&packet);
+}
+
+// Allocator that counts calls and outstanding blocks
+typedef struct {
+    int mallocs;
+    int reallocs;
+    int frees;
+    int live;
+} counting_allocator_t;
+
+static void *counting_malloc(size_t size, void *ctx) {
+    counting_allocator_t *counts = ctx;
+    counts->mallocs++;
+    counts->live++;
+    return malloc(size);
+}
+
+static void *counting_realloc(void *ptr, size_t size, void *ctx) {
+    counting_allocator_t *counts = ctx;
+    counts->reallocs++;
+    return realloc(ptr, size);
+}
+
+static void counting_free(void *ptr, void *ctx) {
+    counting_allocator_t *counts = ctx;
+    counts->frees++;
+    counts->live--;
+    free(ptr);
+}
+
+// Test that packet allocations go through a custom allocator
+void test_custom_allocator(void) {
+    counting_allocator_t counts = {0};
+    bthome_allocator_t allocator = {
+        .malloc_fn = counting_malloc,
+        .realloc_fn = counting_realloc,
+        .free_fn = counting_free,
+        .ctx = &counts,
+    };
+    bthome_set_allocator(&allocator);
+    
+    bthome_packet_t packet;
+    bthome_packet_init(&packet);
+    bthome_add_sensor_sint16(&packet, BTHOME_SENSOR_TEMPERATURE, 2500);
+    bthome_add_sensor_uint16(&packet, BTHOME_SENSOR_HUMIDITY, 5000);
+    bthome_add_button_event(&packet, BTHOME_BUTTON_PRESS);
+    bthome_set_device_name(&packet, "Sensor", 6, true);
+    
+    uint8_t buffer[31];
+    int len = bthome_encode_advertisement(&packet, buffer, sizeof(buffer), true);
+    TEST_ASSERT_GREATER_THAN(0, len);
+    
+    bthome_packet_t decoded;
+    TEST_ASSERT_EQUAL_INT(0, bthome_decode_advertisement(buffer, len, &decoded));
+    bthome_packet_t copy;
+    TEST_ASSERT_EQUAL_INT(0, bthome_packet_copy(&copy, &decoded));
+    TEST_ASSERT_GREATER_THAN(0, counts.mallocs);
+#if !CONFIG_BTHOME_NO_HEAP
+    TEST_ASSERT_GREATER_THAN(0, counts.reallocs);
+#endif
+    TEST_ASSERT_GREATER_THAN(0, counts.live);
+    
+    bthome_packet_free(&copy);
+    bthome_packet_free(&decoded);
+    bthome_packet_free(&packet);
+    TEST_ASSERT_EQUAL_INT(0, counts.live);
+    TEST_ASSERT_EQUAL_INT(counts.mallocs, counts.frees);
+    
+    // Back to the C library
+    bthome_set_allocator(NULL);
+    int mallocs = counts.mallocs;
+    bthome_packet_init(&packet);
+    bthome_add_sensor_uint8(&packet, BTHOME_SENSOR_BATTERY, 90);
+    bthome_packet_free(&packet);
+    TEST_ASSERT_EQUAL_INT(mallocs, counts.mallocs);
+}
+
+// Test that an unchanged packet reuses its encoding and mutations invalidate it
+void test_encode_cache(void) {
+    bthome_packet_t packet;
+    bthome_packet_init(&packet);
+    bthome_set_device_name(&packet, "Cache", 5, true);
+    bthome_set_packet_id(&packet, 1);
+    bthome_add_sensor_sint16(&packet, BTHOME_SENSOR_TEMPERATURE, 2150);
+    
+    uint8_t first[31];
+    int len = bthome_encode_advertisement_cached(&packet, first, sizeof(first), true);
+    TEST_ASSERT_GREATER_THAN(0, len);
+    TEST_ASSERT_EQUAL_INT(len, packet.encoded.len);
+    
+    // Changing the ID patches the cached bytes
+    bthome_set_packet_id(&packet, 2);
+    TEST_ASSERT_EQUAL_INT(len, packet.encoded.len);
+    uint8_t second[31];
+    TEST_ASSERT_EQUAL_INT(len, bthome_encode_advertisement_cached(&packet, second, sizeof(second), true));
+    bthome_packet_t decoded;
+    TEST_ASSERT_EQUAL_INT(0, bthome_decode_advertisement(second, len, &decoded));
+    TEST_ASSERT_EQUAL_UINT8(2, decoded.packet_id);
+    TEST_ASSERT_EQUAL_INT16(2150, decoded.measurements[0].value.sint16_val);
+    bthome_packet_free(&decoded);
+    
+    // A different flags setting or a too small buffer is not served from the cache
+    uint8_t buffer[31];
+    TEST_ASSERT_EQUAL_INT(len - 3, bthome_encode_advertisement_cached(&packet, buffer, sizeof(buffer), false));
+    TEST_ASSERT_EQUAL_INT(-1, bthome_encode_advertisement_cached(&packet, buffer, len - 4, false));
+    
+    // Adding a measurement invalidates the cache
+    bthome_add_sensor_uint8(&packet, BTHOME_SENSOR_BATTERY, 80);
+    TEST_ASSERT_EQUAL_INT(0, packet.encoded.len);
+    int longer = bthome_encode_advertisement_cached(&packet, buffer, sizeof(buffer), true);
+    TEST_ASSERT_EQUAL_INT(len + 2, longer);
+    
+    // Direct changes need an explicit invalidation
+    packet.measurements[0].value.sint16_val = 2200;
+    bthome_packet_invalidate(&packet);
+    TEST_ASSERT_EQUAL_INT(longer, bthome_encode_advertisement_cached(&packet, buffer, sizeof(buffer), true));
+    TEST_ASSERT_EQUAL_INT(0, bthome_decode_advertisement(buffer, longer, &decoded));
+    TEST_ASSERT_EQUAL_INT16(2200, decoded.measurements[0].value.sint16_val);
+    TEST_ASSERT_EQUAL_UINT8(80, decoded.measurements[1].value.uint8_val);
+    bthome_packet_free(&decoded);
+    
+    bthome_packet_free(&packet);
+}
+
+// Test that the plain encoder neither uses nor fills the cache
+void test_encode_uncached(void) {
+    bthome_packet_t packet;
+    bthome_packet_init(&packet);
+    bthome_add_sensor_sint16(&packet, BTHOME_SENSOR_TEMPERATURE, 2150);
+
+    uint8_t buffer[31];
+    int len = bthome_encode_advertisement(&packet, buffer, sizeof(buffer), true);
+    TEST_ASSERT_GREATER_THAN(0, len);
+    TEST_ASSERT_EQUAL_INT(0, packet.encoded.len);
+
+    // A direct write without invalidation is still encoded, even with a stale cache
+    TEST_ASSERT_EQUAL_INT(len, bthome_encode_advertisement_cached(&packet, buffer, sizeof(buffer), true));
+    packet.measurements[0].value.sint16_val = 2200;
+    TEST_ASSERT_EQUAL_INT(len, bthome_encode_advertisement(&packet, buffer, sizeof(buffer), true));
+    bthome_packet_t decoded;
+    TEST_ASSERT_EQUAL_INT(0, bthome_decode_advertisement(buffer, len, &decoded));
+    TEST_ASSERT_EQUAL_INT16(2200, decoded.measurements[0].value.sint16_val);
+    bthome_packet_free(&decoded);
+
+    bthome_packet_free(&packet);
+}
+
+#if CONFIG_BTHOME_NO_HEAP
+// Test that the fixed capacities of a no-heap build are enforced
+void test_no_heap_limits(void) {
+    bthome_packet_t packet;
+    bthome_packet_init(&packet);
+    for (int i = 0; i < CONFIG_BTHOME_MAX_MEASUREMENTS; i++) {
+        TEST_ASSERT_EQUAL_INT(0, bthome_add_sensor_uint8(&packet, BTHOME_SENSOR_BATTERY, i));
+    }
+    TEST_ASSERT_EQUAL_INT(-1, bthome_add_sensor_uint8(&packet, BTHOME_SENSOR_BATTERY, 0));
+    TEST_ASSERT_EQUAL_size_t(CONFIG_BTHOME_MAX_MEASUREMENTS, packet.measurement_count);
+    for (int i = 0; i < CONFIG_BTHOME_MAX_EVENTS; i++) {
+        TEST_ASSERT_EQUAL_INT(0, bthome_add_button_event(&packet, BTHOME_BUTTON_PRESS));
+    }
+    TEST_ASSERT_EQUAL_INT(-1, bthome_add_dimmer_event(&packet, BTHOME_DIMMER_ROTATE_LEFT, 1));
+    TEST_ASSERT_EQUAL_size_t(CONFIG_BTHOME_MAX_EVENTS, packet.event_count);
+    bthome_packet_free(&packet);
+    
+    // Copied text takes a pool block, which is returned when the copy is freed
+    char text[CONFIG_BTHOME_MAX_DATA_LEN + 1];
+    memset(text, 'x', sizeof(text));
+    bthome_packet_init(&packet);
+    bthome_add_sensor_text(&packet, text, CONFIG_BTHOME_MAX_DATA_LEN);
+    bthome_packet_t copy;
+    for (int i = 0; i < 2 * CONFIG_BTHOME_POOL_BLOCKS; i++) {
+        TEST_ASSERT_EQUAL_INT(0, bthome_packet_copy(&copy, &packet));
+        TEST_ASSERT_EQUAL_MEMORY(text, copy.measurements[0].value.bytes_val.data, CONFIG_BTHOME_MAX_DATA_LEN);
+        bthome_packet_free(&copy);
+    }
+    
+    // Longer values don't fit in a block
+    packet.measurements[0].value.bytes_val.len = sizeof(text);
+    TEST_ASSERT_EQUAL_INT(-1, bthome_packet_copy(&copy, &packet));
+    bthome_packet_free(&packet);
+}
+#endif
+
 // Test case group for running all tests together
 TEST_CASE("BTHome: All tests", "[bthome]") {
     printf("=== Running BTHome tests ===\n");
@@ -536,6 +810,8 @@ TEST_CASE("BTHome: All tests", "[bthome]") {
     test_packet_id();
     printf("Test: text sensor\n");
     test_text_sensor();
+    printf("Test: packet copy decoded text\n");
+    test_packet_copy_decoded_text();
     printf("Test: raw sensor\n");
     test_raw_sensor();
     printf("Test: device info flags\n");
@@ -556,6 +832,20 @@ TEST_CASE("BTHome: All tests", "[bthome]") {
     test_no_device_name();
     printf("Test: device name too long\n");
     test_device_name_too_long();
+    printf("Test: decode merged scan response\n");
+    test_decode_merged_scan_response();
+    printf("Test: format value\n");
+    test_format_value();
+    printf("Test: custom allocator\n");
+    test_custom_allocator();
+    printf("Test: encode cache\n");
+    test_encode_cache();
+    printf("Test: encode without cache\n");
+    test_encode_uncached();
+#if CONFIG_BTHOME_NO_HEAP
+    printf("Test: no-heap limits\n");
+    test_no_heap_limits();
+#endif
     printf("=== All BTHome tests completed ===\n");
 }
 
@@ -597,6 +887,10 @@ TEST_CASE("BTHome: text sensor", "[bthome]") {
     test_text_sensor();
 }
 
+TEST_CASE("BTHome: packet copy decoded text", "[bthome]") {
+    test_packet_copy_decoded_text();
+}
+
 TEST_CASE("BTHome: raw sensor", "[bthome]") {
     test_raw_sensor();
 }
@@ -636,3 +930,67 @@ TEST_CASE("BTHome: no device name", "[bthome]") {
 TEST_CASE("BTHome: device name too long", "[bthome]") {
     test_device_name_too_long();
 }
+
+TEST_CASE("BTHome: decode merged scan response", "[bthome]") {
+    test_decode_merged_scan_response();
+}
+
+TEST_CASE("BTHome: format value", "[bthome]") {
+    test_format_value();
+}
+
+TEST_CASE("BTHome: custom allocator", "[bthome]") {
+    test_custom_allocator();
+}
+
+TEST_CASE("BTHome: encode cache", "[bthome]") {
+    test_encode_cache();
+}
+
+TEST_CASE("BTHome: encode without cache", "[bthome]") {
+    test_encode_uncached();
+}
+
+#if CONFIG_BTHOME_NO_HEAP
+TEST_CASE("BTHome: no-heap limits", "[bthome]") {
+    test_no_heap_limits();
+}
+#endif
+
+// Compare bthome_format_value() with printing the float value, and check that both agree
+TEST_CASE("BTHome: format value benchmark", "[bthome][benchmark]") {
+    const int iterations = 20000;
+    bthome_measurement_t m = {
+        .object_id = BTHOME_SENSOR_TEMPERATURE,
+        .is_signed = true,
+        .size = 2,
+    };
+    char fixed[BTHOME_VALUE_STR_LEN];
+    char printed[32];
+    
+    for (int raw = -4000; raw <= 8000; raw++) {
+        m.value.sint16_val = raw;
+        bthome_format_value(&m, fixed, sizeof(fixed));
+        snprintf(printed, sizeof(printed), "%.2f",
+                 bthome_get_scaled_value(&m, bthome_get_scaling_factor(m.object_id)));
+        TEST_ASSERT_EQUAL_STRING(printed, fixed);
+    }
+    
+    int64_t start = esp_timer_get_time();
+    for (int i = 0; i < iterations; i++) {
+        m.value.sint16_val = i - 4000;
+        bthome_format_value(&m, fixed, sizeof(fixed));
+    }
+    int64_t integer_us = esp_timer_get_time() - start;
+    
+    start = esp_timer_get_time();
+    for (int i = 0; i < iterations; i++) {
+        m.value.sint16_val = i - 4000;
+        snprintf(printed, sizeof(printed), "%.2f",
+                 bthome_get_scaled_value(&m, bthome_get_scaling_factor(m.object_id)));
+    }
+    int64_t printf_us = esp_timer_get_time() - start;
+    
+    printf("bthome_format_value: %lld ns/value, snprintf(\"%%.2f\"): %lld ns/value\n",
+           (long long)(integer_us * 1000 / iterations), (long long)(printf_us * 1000 / iterations));
+}
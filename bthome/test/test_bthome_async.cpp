@@ -0,0 +1,137 @@
+#if defined(__cpp_impl_coroutine)
+
+#include <atomic>
+#include <thread>
+#include <vector>
+#include "unity.h"
+#include "bthome.h"
+#include "bthome_async.hpp"
+#include "bthome_scanner_core.h"
+
+static const uint8_t test_addr[6] = { 0xA4, 0xC1, 0x38, 0x00, 0x00, 0x01 };
+
+static void build_packet(bthome_packet_t *packet, uint8_t battery) {
+    bthome_packet_init(packet);
+    bthome_add_sensor_uint8(packet, BTHOME_SENSOR_BATTERY, battery);
+}
+
+// Consume the stream until it ends, recording each battery level
+static bthome::Task consume(bthome::PacketStream<2> &stream, std::vector<int> &received, bool &ended) {
+    while (std::optional<bthome::ScanResult> result = co_await stream.next()) {
+        received.push_back(static_cast<int>(result->packet.measurements()[0].value.uint8_val));
+    }
+    ended = true;
+}
+
+// Test buffering, drops and draining on close
+static void test_async_buffer_and_close(void) {
+    bthome::PacketStream<2> stream;
+    bthome_packet_t packet;
+    for (uint8_t battery = 1; battery <= 3; battery++) {
+        build_packet(&packet, battery);
+        TEST_ASSERT_EQUAL(battery <= 2, stream.push(test_addr, -60, packet));
+        bthome_packet_free(&packet);
+    }
+    TEST_ASSERT_EQUAL_size_t(1, stream.dropped());
+
+    // The consumer takes the buffered packets without suspending, then waits
+    std::vector<int> received;
+    bool ended = false;
+    bthome::Task task = consume(stream, received, ended);
+    TEST_ASSERT_EQUAL_size_t(2, received.size());
+    TEST_ASSERT_EQUAL_INT(1, received[0]);
+    TEST_ASSERT_EQUAL_INT(2, received[1]);
+    TEST_ASSERT_FALSE(task.done());
+
+    // A push resumes the waiting consumer before returning
+    build_packet(&packet, 4);
+    TEST_ASSERT_TRUE(stream.push(test_addr, -60, packet));
+    TEST_ASSERT_EQUAL_size_t(3, received.size());
+
+    // Closing ends the stream; later pushes are refused
+    stream.close();
+    TEST_ASSERT_TRUE(ended);
+    TEST_ASSERT_TRUE(task.done());
+    TEST_ASSERT_FALSE(stream.push(test_addr, -60, packet));
+    bthome_packet_free(&packet);
+}
+
+// Test that cancelling discards buffered packets, while closing delivers them
+static void test_async_cancel(void) {
+    bthome_packet_t packet;
+    build_packet(&packet, 50);
+
+    bthome::PacketStream<2> closed;
+    closed.push(test_addr, -60, packet);
+    closed.close();
+    std::vector<int> received;
+    bool ended = false;
+    bthome::Task task = consume(closed, received, ended);
+    TEST_ASSERT_EQUAL_size_t(1, received.size());
+    TEST_ASSERT_TRUE(ended);
+
+    bthome::PacketStream<2> cancelled;
+    cancelled.push(test_addr, -60, packet);
+    cancelled.cancel();
+    received.clear();
+    ended = false;
+    task = consume(cancelled, received, ended);
+    TEST_ASSERT_EQUAL_size_t(0, received.size());
+    TEST_ASSERT_TRUE(ended);
+    bthome_packet_free(&packet);
+}
+
+static bthome::Task count_batteries(bthome::PacketStream<2> &stream, std::atomic<int> &count, int &last) {
+    while (std::optional<bthome::ScanResult> result = co_await stream.next()) {
+        last = result->packet.measurements()[0].value.uint8_val;
+        count++;
+    }
+}
+
+// Test a mock radio on another thread feeding reports through the scanner core
+static void test_async_mock_radio(void) {
+    bthome_scanner_core_t core;
+    bthome_scanner_core_init(&core);
+    bthome::PacketStream<2> stream;
+    std::atomic<int> count(0);
+    int last = 0;
+    bthome::Task task = count_batteries(stream, count, last);
+
+    int pushed = 0;
+    std::thread radio([&] {
+        for (int i = 1; i <= 100; i++) {
+            bthome_packet_t packet;
+            build_packet(&packet, static_cast<uint8_t>(i));
+            uint8_t adv[BTHOME_ADV_MAX_LEN];
+            int len = bthome_encode_advertisement(&packet, adv, sizeof(adv), true);
+            bthome_packet_free(&packet);
+            if (i % 10 == 0) {
+                adv[7] |= BTHOME_DEVICE_INFO_ENCRYPTED;  // Not decoded, so never pushed
+            }
+            pushed += stream.push_report(core, test_addr, -70, adv, len, static_cast<uint32_t>(i));
+        }
+    });
+    radio.join();
+
+    // The consumer kept up, as each push ran it to its next wait
+    TEST_ASSERT_EQUAL_INT(90, pushed);
+    TEST_ASSERT_EQUAL_INT(90, count.load());
+    TEST_ASSERT_EQUAL_INT(99, last);
+    TEST_ASSERT_EQUAL_size_t(0, stream.dropped());
+    stream.cancel();
+    TEST_ASSERT_TRUE(task.done());
+}
+
+TEST_CASE("BTHome async: buffering and close", "[bthome][async]") {
+    test_async_buffer_and_close();
+}
+
+TEST_CASE("BTHome async: cancel", "[bthome][async]") {
+    test_async_cancel();
+}
+
+TEST_CASE("BTHome async: mock radio", "[bthome][async]") {
+    test_async_mock_radio();
+}
+
+#endif // __cpp_impl_coroutine
@@ -0,0 +1,324 @@
+#include <cmath>
+#include <cstring>
+#include <utility>
+#include <vector>
+#include "unity.h"
+#include "bthome.h"
+#include "bthome.hpp"
+
+using SensorPacket = bthome::Packet<bthome::PacketId, bthome::Battery, bthome::Temperature,
+                                    bthome::Humidity, bthome::binary::Door>;
+
+// Flags (3) + service data header (2) + UUID and device info (3) + objects (2 + 2 + 3 + 3 + 2)
+static_assert(SensorPacket::size == 20, "Packet size is computed at compile time");
+static_assert(bthome::Pressure::width == 3 && !bthome::Pressure::is_signed, "Objects carry their width");
+static_assert(bthome::Temperature::from_scaled(-21.37).value == -2137, "Scaled values round to steps");
+
+// Encoding works in constant expressions
+constexpr SensorPacket::buffer_type constant_adv() {
+    SensorPacket packet(bthome::PacketId(7), bthome::Battery(90), bthome::Temperature(2150),
+                        bthome::Humidity(4500), bthome::binary::Door(true));
+    SensorPacket::buffer_type adv{};
+    packet.encode(adv);
+    return adv;
+}
+static_assert(constant_adv()[10] == BTHOME_SENSOR_BATTERY && constant_adv()[11] == 90,
+              "Encoded at compile time");
+
+// Test that the typed packet encodes exactly like the C API
+static void test_cpp_packet_matches_c(void) {
+    SensorPacket packet;
+    packet.set(bthome::PacketId(7));
+    packet.set(bthome::Battery(90));
+    packet.get<bthome::Temperature>() = bthome::Temperature::from_scaled(-5.25);
+    packet.get<bthome::Humidity>() = bthome::Humidity::from_scaled(45.5);
+    packet.get<4>().value = true;
+
+    SensorPacket::buffer_type adv;
+    size_t len = packet.encode(adv);
+    TEST_ASSERT_EQUAL_size_t(SensorPacket::size, len);
+
+    bthome_packet_t c_packet;
+    bthome_packet_init(&c_packet);
+    bthome_set_packet_id(&c_packet, 7);
+    bthome_add_sensor_uint8(&c_packet, BTHOME_SENSOR_BATTERY, 90);
+    bthome_add_sensor_sint16(&c_packet, BTHOME_SENSOR_TEMPERATURE, -525);
+    bthome_add_sensor_uint16(&c_packet, BTHOME_SENSOR_HUMIDITY, 4550);
+    bthome_add_binary_sensor(&c_packet, BTHOME_BINARY_DOOR, true);
+    uint8_t expected[BTHOME_ADV_MAX_LEN];
+    int expected_len = bthome_encode_advertisement(&c_packet, expected, sizeof(expected), true);
+    bthome_packet_free(&c_packet);
+
+    TEST_ASSERT_EQUAL_INT(expected_len, (int)len);
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(expected, adv.data(), len);
+
+    // Service data alone decodes with the C decoder
+    SensorPacket::service_data_type service_data;
+    len = packet.encode_service_data(service_data);
+    bthome_packet_t decoded;
+    TEST_ASSERT_EQUAL_INT(0, bthome_decode(service_data.data(), len, &decoded));
+    TEST_ASSERT_EQUAL_size_t(4, decoded.measurement_count);
+    TEST_ASSERT_EQUAL_INT16(-525, decoded.measurements[1].value.sint16_val);
+    bthome_packet_free(&decoded);
+}
+
+// Test 24-bit values, events and the trigger-based flag
+static void test_cpp_packet_events(void) {
+    bthome::Packet<bthome::Pressure, bthome::ButtonEvent, bthome::DimmerEvent> packet(
+        bthome::Pressure::from_scaled(1013.25), bthome::ButtonEvent{BTHOME_BUTTON_LONG_PRESS},
+        bthome::DimmerEvent{BTHOME_DIMMER_ROTATE_LEFT, 3});
+    packet.set_trigger_based(true);
+
+    decltype(packet)::buffer_type adv;
+    size_t len = packet.encode(adv);
+    TEST_ASSERT_EQUAL_size_t(decltype(packet)::size, len);
+
+    bthome_packet_t decoded;
+    TEST_ASSERT_EQUAL_INT(0, bthome_decode_advertisement(adv.data(), len, &decoded));
+    TEST_ASSERT_TRUE(decoded.device_info.trigger_based);
+    TEST_ASSERT_EQUAL_UINT32(101325, decoded.measurements[0].value.uint32_val);
+    TEST_ASSERT_EQUAL_size_t(2, decoded.event_count);
+    TEST_ASSERT_EQUAL_UINT8(BTHOME_BUTTON_LONG_PRESS, decoded.events[0].event_value);
+    TEST_ASSERT_EQUAL_UINT8(3, decoded.events[1].steps);
+    bthome_packet_free(&decoded);
+
+    // A dimmer event without rotation has no step count
+    packet.get<bthome::DimmerEvent>() = bthome::DimmerEvent{};
+    TEST_ASSERT_EQUAL_size_t(decltype(packet)::size - 1, packet.encode(adv));
+}
+
+// Test that the C++ object table agrees with the C one
+static void test_cpp_object_table(void) {
+#define CHECK_SENSOR(name, object_id, raw, width, multiplier, decimals) \
+    TEST_ASSERT_EQUAL_UINT8(width, bthome_get_object_size(bthome::name::id)); \
+    TEST_ASSERT_EQUAL(bthome_is_signed(object_id), bthome::name::is_signed); \
+    TEST_ASSERT_FLOAT_WITHIN(1e-6, bthome_get_scaling_factor(object_id), bthome::name::scale);
+    BTHOME_CPP_SENSORS(CHECK_SENSOR)
+#undef CHECK_SENSOR
+#define CHECK_BINARY_SENSOR(name, object_id) \
+    TEST_ASSERT_TRUE(bthome_is_binary_sensor(bthome::binary::name::id)); \
+    TEST_ASSERT_EQUAL_UINT8(1, bthome_get_object_size(object_id));
+    BTHOME_CPP_BINARY_SENSORS(CHECK_BINARY_SENSOR)
+#undef CHECK_BINARY_SENSOR
+}
+
+// Decoding works in constant expressions too
+constexpr int constant_battery() {
+    auto adv = constant_adv();
+    int battery = -1;
+    bthome::decode_advertisement(adv, [&](bthome::Battery b) { battery = b.value; });
+    return battery;
+}
+static_assert(constant_battery() == 90, "Decoded at compile time");
+
+// Test that the visitor sees each object as its own type, with the values the C decoder reads
+static void test_cpp_decode_visitor(void) {
+    bthome_packet_t packet;
+    bthome_packet_init(&packet);
+    bthome_set_device_name(&packet, "N1", 2, false);
+    bthome_set_packet_id(&packet, 42);
+    bthome_add_sensor_sint16(&packet, BTHOME_SENSOR_TEMPERATURE, -1234);
+    bthome_add_sensor_uint24(&packet, BTHOME_SENSOR_ILLUMINANCE, 0xABCDEF);
+    bthome_add_binary_sensor(&packet, BTHOME_BINARY_MOTION, true);
+    bthome_add_sensor_text(&packet, "hi", 2);
+    bthome_add_dimmer_event(&packet, BTHOME_DIMMER_ROTATE_RIGHT, 5);
+    uint8_t adv[BTHOME_ADV_MAX_LEN];
+    int len = bthome_encode_advertisement(&packet, adv, sizeof(adv), true);
+    bthome_packet_free(&packet);
+    TEST_ASSERT_GREATER_THAN(0, len);
+
+    int16_t temperature = 0;
+    uint32_t illuminance = 0;
+    bool motion = false;
+    std::string_view text;
+    std::string_view name;
+    uint8_t packet_id = 0;
+    uint8_t steps = 0;
+    int others = 0;
+    int result = bthome::decode_advertisement(adv, len, bthome::overloaded{
+        [&](bthome::Temperature t) { temperature = t.value; },
+        [&](bthome::Illuminance i) { illuminance = i.value; },
+        [&](bthome::binary::Motion m) { motion = m.value; },
+        [&](bthome::Text t) { text = t.value; },
+        [&](bthome::DeviceName n) { name = n.name; },
+        [&](bthome::PacketId p) { packet_id = p.value; },
+        [&](bthome::DimmerEvent e) { steps = e.steps; },
+        [&](const bthome_device_info_t &) { others++; },
+    });
+    TEST_ASSERT_EQUAL_INT(0, result);
+    TEST_ASSERT_EQUAL_INT16(-1234, temperature);
+    TEST_ASSERT_EQUAL_UINT32(0xABCDEF, illuminance);
+    TEST_ASSERT_TRUE(motion);
+    TEST_ASSERT_TRUE(text == "hi");
+    TEST_ASSERT_TRUE(name == "N1");
+    TEST_ASSERT_EQUAL_UINT8(42, packet_id);
+    TEST_ASSERT_EQUAL_UINT8(5, steps);
+    TEST_ASSERT_EQUAL_INT(1, others);
+
+    // A generic handler sees every object; unhandled ones are skipped
+    int objects = 0;
+    bthome::decode_advertisement(adv, len, [&](const auto &) { objects++; });
+    TEST_ASSERT_EQUAL_INT(8, objects);  // Name, device info, packet ID, 4 objects, event
+    objects = 0;
+    bthome::decode_advertisement(adv, len, [&](bthome::Humidity) { objects++; });
+    TEST_ASSERT_EQUAL_INT(0, objects);
+}
+
+// Test that every truncation fails with the same error code as the C decoder
+static void test_cpp_decode_errors(void) {
+    const uint8_t adv[] = {
+        0x02, 0x01, 0x06,
+        0x11, 0x16, 0xD2, 0xFC, 0x40,
+        0x00, 0x01,                    // Packet ID
+        0x02, 0x2E, 0x09,              // Temperature
+        0x53, 0x03, 'a', 'b', 'c',     // Text
+        0x3C, 0x01, 0x02,              // Dimmer
+    };
+    for (size_t len = 0; len <= sizeof(adv); len++) {
+        uint8_t copy[sizeof(adv)];
+        memcpy(copy, adv, sizeof(adv));
+        copy[3] = (uint8_t)(len > 4 ? len - 4 : 0x11);  // Let the service data end where the buffer does
+
+        bthome_packet_t packet;
+        int expected = bthome_decode_advertisement(copy, len, &packet);
+        if (expected == 0) {
+            bthome_packet_free(&packet);
+        }
+        TEST_ASSERT_EQUAL_INT(expected, bthome::decode_advertisement(copy, len, [](const auto &) {}));
+
+        if (len >= 5) {
+            expected = bthome_decode(copy + 5, len - 5, &packet);
+            if (expected == 0) {
+                bthome_packet_free(&packet);
+            }
+            TEST_ASSERT_EQUAL_INT(expected, bthome::decode(copy + 5, len - 5, [](const auto &) {}));
+        }
+    }
+
+    // Encrypted and foreign service data
+    const uint8_t encrypted[] = { 0xD2, 0xFC, 0x41, 0x01, 0x64 };
+    TEST_ASSERT_EQUAL_INT(-3, bthome::decode(encrypted, [](const auto &) {}));
+    const uint8_t foreign[] = { 0x1A, 0x18, 0x40, 0x01, 0x64 };
+    TEST_ASSERT_EQUAL_INT(-2, bthome::decode(foreign, [](const auto &) {}));
+}
+
+static_assert(!std::is_copy_constructible<bthome::OwnedPacket>::value, "Copies are explicit");
+static_assert(std::is_nothrow_move_constructible<bthome::OwnedPacket>::value &&
+              std::is_nothrow_move_assignable<bthome::OwnedPacket>::value, "Moves can't fail");
+
+struct AllocationCounts {
+    int allocations;
+    int reallocations;
+    int frees;
+};
+
+static void *counting_malloc(size_t size, void *ctx) {
+    static_cast<AllocationCounts *>(ctx)->allocations++;
+    return malloc(size);
+}
+
+static void *counting_realloc(void *ptr, size_t size, void *ctx) {
+    static_cast<AllocationCounts *>(ctx)->reallocations++;
+    return realloc(ptr, size);
+}
+
+static void counting_free(void *ptr, void *ctx) {
+    static_cast<AllocationCounts *>(ctx)->frees++;
+    free(ptr);
+}
+
+// Test that an owned packet outlives its source, and that moving it never allocates
+static void test_cpp_owned_packet(void) {
+    uint8_t adv[BTHOME_ADV_MAX_LEN];
+    bthome_packet_t source;
+    bthome_packet_init(&source);
+    bthome_set_device_name(&source, "Kitchen", 7, true);
+    bthome_add_sensor_sint16(&source, BTHOME_SENSOR_TEMPERATURE, 2150);
+    bthome_add_sensor_text(&source, "ok", 2);
+    bthome_add_button_event(&source, BTHOME_BUTTON_PRESS);
+    int len = bthome_encode_advertisement(&source, adv, sizeof(adv), true);
+    bthome_packet_free(&source);
+    TEST_ASSERT_GREATER_THAN(0, len);
+
+    AllocationCounts counts = {0, 0, 0};
+    bthome_allocator_t allocator = {counting_malloc, counting_realloc, counting_free, &counts};
+    bthome_set_allocator(&allocator);
+
+    int copy_result;
+    int copy_allocations;
+    int move_allocations;
+    size_t moved_count;
+    std::string_view moved_name;
+    std::string_view moved_text;
+    {
+        // The decoded packet points into adv; the owned copy doesn't
+        bthome_packet_t decoded;
+        copy_result = bthome_decode_advertisement(adv, len, &decoded);
+        bthome::OwnedPacket owned;
+        if (copy_result == 0) {
+            copy_result = owned.copy_from(decoded);
+            bthome_packet_free(&decoded);
+        }
+        memset(adv, 0, sizeof(adv));
+        copy_allocations = counts.allocations;
+
+        // Moves, including a vector growing, only move the structure
+        std::vector<bthome::OwnedPacket> queue;
+        queue.reserve(1);
+        queue.push_back(std::move(owned));
+        int before = counts.allocations + counts.reallocations;
+        queue.emplace_back();
+        bthome::OwnedPacket taken = std::move(queue.front());
+        bthome::OwnedPacket adopted = bthome::OwnedPacket::adopt(*taken.get());
+        taken = std::move(adopted);
+        move_allocations = counts.allocations + counts.reallocations - before;
+
+        moved_count = taken.measurements().size() + taken.events().size();
+        moved_name = taken.name();
+        moved_text = std::string_view(reinterpret_cast<const char *>(taken.measurements()[1].value.bytes_val.data),
+                                      taken.measurements()[1].value.bytes_val.len);
+        TEST_ASSERT_TRUE(queue.front().name().empty());
+        TEST_ASSERT_TRUE(queue.front().measurements().empty());
+        TEST_ASSERT_TRUE(moved_name == "Kitchen");
+        TEST_ASSERT_TRUE(moved_text == "ok");
+    }
+    bthome_set_allocator(NULL);
+
+    TEST_ASSERT_EQUAL_INT(0, copy_result);
+    TEST_ASSERT_GREATER_THAN(0, copy_allocations);
+    TEST_ASSERT_EQUAL_INT(0, move_allocations);
+    TEST_ASSERT_EQUAL_size_t(3, moved_count);
+    TEST_ASSERT_EQUAL_INT(counts.allocations, counts.frees);
+
+    // Ownership can go back to the C API
+    bthome::OwnedPacket owned;
+    bthome_add_sensor_uint8(owned.get(), BTHOME_SENSOR_BATTERY, 90);
+    bthome_packet_t released = owned.release();
+    TEST_ASSERT_TRUE(owned.measurements().empty());
+    TEST_ASSERT_EQUAL_size_t(1, released.measurement_count);
+    bthome_packet_free(&released);
+}
+
+TEST_CASE("BTHome C++: packet matches C encoder", "[bthome][cpp]") {
+    test_cpp_packet_matches_c();
+}
+
+TEST_CASE("BTHome C++: 24-bit values and events", "[bthome][cpp]") {
+    test_cpp_packet_events();
+}
+
+TEST_CASE("BTHome C++: object table", "[bthome][cpp]") {
+    test_cpp_object_table();
+}
+
+TEST_CASE("BTHome C++: decode visitor", "[bthome][cpp]") {
+    test_cpp_decode_visitor();
+}
+
+TEST_CASE("BTHome C++: decode errors match C", "[bthome][cpp]") {
+    test_cpp_decode_errors();
+}
+
+TEST_CASE("BTHome C++: owned packet", "[bthome][cpp]") {
+    test_cpp_owned_packet();
+}
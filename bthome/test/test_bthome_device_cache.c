@@ -0,0 +1,225 @@
+#include <stdio.h>
+#include <string.h>
+#include "unity.h"
+#include "bthome.h"
+#include "bthome_device_cache.h"
+
+static const uint8_t addr_a[6] = { 0xA4, 0xC1, 0x38, 0x00, 0x00, 0x01 };
+static const uint8_t addr_b[6] = { 0xA4, 0xC1, 0x38, 0x00, 0x00, 0x02 };
+
+// Test that names are interned once and attached to adverts without a name
+void test_device_cache_names(void) {
+    static bthome_device_cache_t cache;
+    bthome_device_cache_init(&cache);
+    
+    char scan_buffer[16] = "Kitchen";
+    bthome_packet_t packet;
+    bthome_packet_init(&packet);
+    bthome_set_device_name(&packet, scan_buffer, 7, true);
+    
+    TEST_ASSERT_EQUAL_INT(0, bthome_device_cache_attach_name(&cache, addr_a, &packet));
+    TEST_ASSERT_TRUE(packet.name_shared);
+    TEST_ASSERT_TRUE(packet.device_name != scan_buffer);
+    TEST_ASSERT_EQUAL_STRING("Kitchen", packet.device_name);
+    const char *interned = packet.device_name;
+    
+    // The scan buffer is reused for the next advertisement
+    memset(scan_buffer, 0, sizeof(scan_buffer));
+    TEST_ASSERT_EQUAL_STRING("Kitchen", interned);
+    
+    // A later advert without a name gets the same pointer
+    bthome_packet_t nameless;
+    bthome_packet_init(&nameless);
+    TEST_ASSERT_EQUAL_INT(0, bthome_device_cache_attach_name(&cache, addr_a, &nameless));
+    TEST_ASSERT_EQUAL_PTR(interned, nameless.device_name);
+    TEST_ASSERT_EQUAL_size_t(7, nameless.device_name_len);
+    TEST_ASSERT_TRUE(nameless.use_complete_name);
+    
+    // Unknown devices stay nameless
+    bthome_packet_init(&nameless);
+    TEST_ASSERT_EQUAL_INT(0, bthome_device_cache_attach_name(&cache, addr_b, &nameless));
+    TEST_ASSERT_NULL(nameless.device_name);
+    
+    // Devices with the same name share it
+    bthome_packet_init(&packet);
+    bthome_set_device_name(&packet, "Kitchen", 7, true);
+    TEST_ASSERT_EQUAL_INT(0, bthome_device_cache_attach_name(&cache, addr_b, &packet));
+    TEST_ASSERT_EQUAL_PTR(interned, packet.device_name);
+    TEST_ASSERT_EQUAL_size_t(1, cache.name_count);
+}
+
+// Test that copies share the interned name instead of copying it
+void test_device_cache_copy(void) {
+    static bthome_device_cache_t cache;
+    bthome_device_cache_init(&cache);
+    
+    bthome_packet_t packet;
+    bthome_packet_init(&packet);
+    bthome_set_device_name(&packet, "Porch", 5, false);
+    bthome_add_sensor_uint8(&packet, BTHOME_SENSOR_BATTERY, 80);
+    TEST_ASSERT_EQUAL_INT(0, bthome_device_cache_attach_name(&cache, addr_a, &packet));
+    
+    bthome_packet_t copy;
+    TEST_ASSERT_EQUAL_INT(0, bthome_packet_copy(&copy, &packet));
+    TEST_ASSERT_EQUAL_PTR(packet.device_name, copy.device_name);
+    TEST_ASSERT_TRUE(copy.name_shared);
+    TEST_ASSERT_FALSE(copy.use_complete_name);
+    
+    // Freeing the copy must not free the interned name
+    bthome_packet_free(&copy);
+    TEST_ASSERT_EQUAL_STRING("Porch", cache.names[0].name);
+    
+    // A copied name is replaced by the interned one
+    bthome_packet_t owned;
+    bthome_packet_free(&packet);
+    bthome_packet_init(&packet);
+    bthome_set_device_name(&packet, "Porch", 5, false);
+    TEST_ASSERT_EQUAL_INT(0, bthome_packet_copy(&owned, &packet));
+    TEST_ASSERT_EQUAL_INT(0, bthome_device_cache_attach_name(&cache, addr_b, &owned));
+    TEST_ASSERT_EQUAL_PTR(cache.names[0].name, owned.device_name);
+    bthome_packet_free(&owned);
+    bthome_packet_free(&packet);
+}
+
+// Test eviction of the least recently seen device
+void test_device_cache_eviction(void) {
+    static bthome_device_cache_t cache;
+    bthome_device_cache_init(&cache);
+    
+    uint8_t addr[6] = { 0 };
+    bthome_device_entry_t *first = bthome_device_cache_lookup(&cache, addr);
+    for (int i = 1; i < BTHOME_DEVICE_CACHE_SIZE; i++) {
+        addr[5] = i;
+        bthome_device_cache_lookup(&cache, addr);
+    }
+    
+    // Seeing the first device again keeps it; the second one is evicted instead
+    addr[5] = 0;
+    TEST_ASSERT_EQUAL_PTR(first, bthome_device_cache_lookup(&cache, addr));
+    addr[5] = 0xFF;
+    bthome_device_entry_t *added = bthome_device_cache_lookup(&cache, addr);
+    TEST_ASSERT_EQUAL_PTR(&cache.devices[1], added);
+    TEST_ASSERT_EQUAL_INT16(-1, added->name);
+}
+
+// Remember a name for a device, as the scanner core does
+static int remember(bthome_device_cache_t *cache, const uint8_t *addr, const char *name) {
+    bthome_packet_t packet;
+    bthome_packet_init(&packet);
+    bthome_set_device_name(&packet, name, strlen(name), true);
+    int result = bthome_device_cache_remember_name(cache, addr, &packet);
+    bthome_packet_free(&packet);
+    return result;
+}
+
+// Test that a full name pool reuses names no remembered device uses any more
+void test_device_cache_name_reclaim(void) {
+    static bthome_device_cache_t cache;
+    bthome_device_cache_init(&cache);
+    
+    // A device per name fills the pool
+    uint8_t addr[6] = { 0 };
+    char name[16];
+    for (int i = 0; i < BTHOME_NAME_POOL_SIZE; i++) {
+        addr[4] = i >> 8;
+        addr[5] = i;
+        snprintf(name, sizeof(name), "dev%d", i);
+        TEST_ASSERT_EQUAL_INT(0, remember(&cache, addr, name));
+    }
+    TEST_ASSERT_EQUAL_size_t(BTHOME_NAME_POOL_SIZE, cache.name_count);
+    
+    // A new device forgets the oldest one, whose name is overwritten in place
+    const char *oldest = cache.names[0].name;
+    uint8_t newcomer[6] = { 0xA4, 0xC1, 0x38, 0xFF, 0xFF, 0xFF };
+    TEST_ASSERT_EQUAL_INT(0, remember(&cache, newcomer, "newcomer"));
+    const bthome_interned_name_t *interned = bthome_device_cache_find_name(&cache, newcomer);
+    TEST_ASSERT_NOT_NULL(interned);
+    TEST_ASSERT_EQUAL_PTR(oldest, interned->name);
+    TEST_ASSERT_EQUAL_STRING("newcomer", interned->name);
+    TEST_ASSERT_EQUAL_UINT32(0, cache.intern_failures);
+    
+    // Names of remembered devices are kept
+    addr[4] = (BTHOME_NAME_POOL_SIZE - 1) >> 8;
+    addr[5] = BTHOME_NAME_POOL_SIZE - 1;
+    snprintf(name, sizeof(name), "dev%d", BTHOME_NAME_POOL_SIZE - 1);
+    interned = bthome_device_cache_find_name(&cache, addr);
+    TEST_ASSERT_NOT_NULL(interned);
+    TEST_ASSERT_EQUAL_STRING(name, interned->name);
+    
+    // A device that keeps renaming itself reuses its own previous name
+    for (int i = 0; i < 2 * BTHOME_NAME_POOL_SIZE; i++) {
+        snprintf(name, sizeof(name), "renamed%d", i);
+        TEST_ASSERT_EQUAL_INT(0, remember(&cache, newcomer, name));
+    }
+    TEST_ASSERT_EQUAL_STRING(name, bthome_device_cache_find_name(&cache, newcomer)->name);
+    TEST_ASSERT_EQUAL_UINT32(0, cache.intern_failures);
+    
+    // Failures are counted
+    TEST_ASSERT_EQUAL_INT(-1, remember(&cache, newcomer, "This name is longer than any local name"));
+    TEST_ASSERT_EQUAL_UINT32(1, cache.intern_failures);
+    TEST_ASSERT_EQUAL_STRING(name, bthome_device_cache_find_name(&cache, newcomer)->name);
+}
+
+// Test re-decoding a device's last advertisement from a saved copy of the cache
+void test_device_cache_last_packet(void) {
+    static bthome_device_cache_t cache;
+    static bthome_device_cache_t restored;
+    bthome_device_cache_init(&cache);
+    
+    bthome_packet_t packet;
+    bthome_packet_init(&packet);
+    bthome_set_device_info(&packet, false, false);
+    bthome_set_device_name(&packet, "Garage", 6, true);
+    bthome_set_packet_id(&packet, 42);
+    bthome_add_sensor_sint16(&packet, BTHOME_SENSOR_TEMPERATURE, 1875);
+    uint8_t adv[BTHOME_ADV_MAX_LEN];
+    int len = bthome_encode_advertisement(&packet, adv, sizeof(adv), true);
+    TEST_ASSERT_GREATER_THAN(0, len);
+    bthome_packet_free(&packet);
+    
+    bthome_packet_t decoded;
+    TEST_ASSERT_EQUAL_INT(0, bthome_decode_advertisement(adv, len, &decoded));
+    TEST_ASSERT_EQUAL_INT(0, bthome_device_cache_attach_name(&cache, addr_a, &decoded));
+    bthome_device_entry_t *entry = bthome_device_cache_record(&cache, addr_a, -70, adv, len, &decoded);
+    bthome_packet_free(&decoded);
+    TEST_ASSERT_TRUE(entry->has_packet_id);
+    TEST_ASSERT_EQUAL_UINT8(42, entry->packet_id);
+    TEST_ASSERT_EQUAL_INT8(-70, entry->rssi);
+    
+    // Saved and restored as a blob, e.g. through NVS
+    memcpy(&restored, &cache, sizeof(restored));
+    memset(adv, 0, sizeof(adv));
+    memset(&cache, 0, sizeof(cache));
+    
+    entry = bthome_device_cache_lookup(&restored, addr_a);
+    TEST_ASSERT_EQUAL_INT(0, bthome_device_cache_last_packet(&restored, entry, &decoded));
+    TEST_ASSERT_EQUAL_size_t(1, decoded.measurement_count);
+    TEST_ASSERT_EQUAL_INT16(1875, decoded.measurements[0].value.sint16_val);
+    TEST_ASSERT_EQUAL_UINT8(42, decoded.packet_id);
+    TEST_ASSERT_EQUAL_PTR(restored.names[0].name, decoded.device_name);
+    bthome_packet_free(&decoded);
+    
+    // Devices without a recorded advertisement
+    entry = bthome_device_cache_lookup(&restored, addr_b);
+    TEST_ASSERT_EQUAL_INT(-1, bthome_device_cache_last_packet(&restored, entry, &decoded));
+}
+
+TEST_CASE("BTHome device cache: interned names", "[bthome][device_cache]") {
+    test_device_cache_names();
+}
+
+TEST_CASE("BTHome device cache: shared names in copies", "[bthome][device_cache]") {
+    test_device_cache_copy();
+}
+
+TEST_CASE("BTHome device cache: eviction", "[bthome][device_cache]") {
+    test_device_cache_eviction();
+}
+
+TEST_CASE("BTHome device cache: name reclaim", "[bthome][device_cache]") {
+    test_device_cache_name_reclaim();
+}
+
+TEST_CASE("BTHome device cache: last packet", "[bthome][device_cache]") {
+    test_device_cache_last_packet();
+}
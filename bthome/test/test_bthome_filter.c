@@ -0,0 +1,147 @@
+#include <stdio.h>
+#include <string.h>
+#include "unity.h"
+#include "bthome.h"
+#include "bthome_filter.h"
+
+// Example payload from the BTHome documentation: "DIY-sensor", temperature and humidity
+static const uint8_t example_adv[] = {
+    0x02, 0x01, 0x06,
+    0x0B, 0x09, 0x44, 0x49, 0x59, 0x2D, 0x73, 0x65, 0x6E, 0x73, 0x6F, 0x72,
+    0x0A, 0x16, 0xD2, 0xFC, 0x40, 0x02, 0xC4, 0x09, 0x03, 0xBF, 0x13
+};
+
+// Button press with packet ID, no name
+static const uint8_t button_adv[] = {
+    0x02, 0x01, 0x06,
+    0x08, 0x16, 0xD2, 0xFC, 0x44, 0x00, 0x21, 0x3A, 0x01
+};
+
+// Test that an empty filter matches any BTHome advertisement
+void test_filter_match_all(void) {
+    bthome_filter_t filter;
+    bthome_filter_init(&filter);
+    
+    bthome_matcher_t matcher;
+    TEST_ASSERT_EQUAL_INT(0, bthome_filter_compile(&filter, &matcher));
+    
+    TEST_ASSERT_TRUE(bthome_matcher_match(&matcher, example_adv, sizeof(example_adv), -90));
+    TEST_ASSERT_TRUE(bthome_matcher_match(&matcher, button_adv, sizeof(button_adv), -90));
+    
+    // Flags only, no BTHome service data
+    TEST_ASSERT_FALSE(bthome_matcher_match(&matcher, example_adv, 3, -90));
+}
+
+// Test object ID and event type subscriptions
+void test_filter_objects_and_events(void) {
+    bthome_filter_t filter;
+    bthome_filter_init(&filter);
+    bthome_filter_add_object(&filter, BTHOME_SENSOR_HUMIDITY);
+    
+    bthome_matcher_t matcher;
+    TEST_ASSERT_EQUAL_INT(0, bthome_filter_compile(&filter, &matcher));
+    TEST_ASSERT_TRUE(bthome_matcher_match(&matcher, example_adv, sizeof(example_adv), -50));
+    TEST_ASSERT_FALSE(bthome_matcher_match(&matcher, button_adv, sizeof(button_adv), -50));
+    
+    bthome_filter_init(&filter);
+    bthome_filter_add_object(&filter, BTHOME_SENSOR_PRESSURE);
+    filter.event_types = BTHOME_FILTER_EVENT_BUTTON;
+    TEST_ASSERT_EQUAL_INT(0, bthome_filter_compile(&filter, &matcher));
+    TEST_ASSERT_FALSE(bthome_matcher_match(&matcher, example_adv, sizeof(example_adv), -50));
+    TEST_ASSERT_TRUE(bthome_matcher_match(&matcher, button_adv, sizeof(button_adv), -50));
+}
+
+// Test that a wanted object in any service data element of a merged advert matches
+void test_filter_merged_elements(void) {
+    // Advert with a temperature, then a scan response with a battery level
+    static const uint8_t merged_adv[] = {
+        0x02, 0x01, 0x06,
+        0x07, 0x16, 0xD2, 0xFC, 0x40, 0x02, 0xC4, 0x09,
+        0x06, 0x16, 0xD2, 0xFC, 0x40, 0x01, 0x64,
+    };
+    bthome_filter_t filter;
+    bthome_filter_init(&filter);
+    bthome_filter_add_object(&filter, BTHOME_SENSOR_TEMPERATURE);
+
+    bthome_matcher_t matcher;
+    TEST_ASSERT_EQUAL_INT(0, bthome_filter_compile(&filter, &matcher));
+    TEST_ASSERT_TRUE(bthome_matcher_match(&matcher, merged_adv, sizeof(merged_adv), -50));
+
+    bthome_filter_init(&filter);
+    bthome_filter_add_object(&filter, BTHOME_SENSOR_BATTERY);
+    TEST_ASSERT_EQUAL_INT(0, bthome_filter_compile(&filter, &matcher));
+    TEST_ASSERT_TRUE(bthome_matcher_match(&matcher, merged_adv, sizeof(merged_adv), -50));
+
+    bthome_filter_init(&filter);
+    bthome_filter_add_object(&filter, BTHOME_SENSOR_HUMIDITY);
+    TEST_ASSERT_EQUAL_INT(0, bthome_filter_compile(&filter, &matcher));
+    TEST_ASSERT_FALSE(bthome_matcher_match(&matcher, merged_adv, sizeof(merged_adv), -50));
+}
+
+// Test name prefixes and RSSI floor
+void test_filter_name_and_rssi(void) {
+    bthome_filter_t filter;
+    bthome_filter_init(&filter);
+    filter.name_prefixes[0] = "ATC_";
+    filter.name_prefixes[1] = "DIY-";
+    filter.min_rssi = -80;
+    
+    bthome_matcher_t matcher;
+    TEST_ASSERT_EQUAL_INT(0, bthome_filter_compile(&filter, &matcher));
+    TEST_ASSERT_TRUE(bthome_matcher_match(&matcher, example_adv, sizeof(example_adv), -80));
+    TEST_ASSERT_FALSE(bthome_matcher_match(&matcher, example_adv, sizeof(example_adv), -81));
+    
+    // No name at all
+    TEST_ASSERT_FALSE(bthome_matcher_match(&matcher, button_adv, sizeof(button_adv), -40));
+    
+    // No name in the advertisement, but the device's name is known
+    TEST_ASSERT_TRUE(bthome_matcher_match_named(&matcher, button_adv, sizeof(button_adv), -40, "ATC_1A2B", 8));
+    TEST_ASSERT_FALSE(bthome_matcher_match_named(&matcher, button_adv, sizeof(button_adv), -40, "LYWSD03", 7));
+    
+    filter.name_prefixes[1] = "DIY-sensor-2";
+    TEST_ASSERT_EQUAL_INT(0, bthome_filter_compile(&filter, &matcher));
+    TEST_ASSERT_FALSE(bthome_matcher_match(&matcher, example_adv, sizeof(example_adv), -40));
+    
+    // The advertised name wins over the known one
+    TEST_ASSERT_FALSE(bthome_matcher_match_named(&matcher, example_adv, sizeof(example_adv), -40, "ATC_1A2B", 8));
+    
+    filter.name_prefixes[1] = "This prefix is far too long to be a name";
+    TEST_ASSERT_LESS_THAN(0, bthome_filter_compile(&filter, &matcher));
+}
+
+// Test that truncated or encrypted service data never matches
+void test_filter_invalid_data(void) {
+    bthome_filter_t filter;
+    bthome_filter_init(&filter);
+    bthome_filter_add_object(&filter, BTHOME_SENSOR_HUMIDITY);
+    
+    bthome_matcher_t matcher;
+    TEST_ASSERT_EQUAL_INT(0, bthome_filter_compile(&filter, &matcher));
+    
+    // Temperature value cut short before the humidity object
+    const uint8_t truncated[] = { 0x06, 0x16, 0xD2, 0xFC, 0x40, 0x02, 0xC4 };
+    TEST_ASSERT_FALSE(bthome_matcher_match(&matcher, truncated, sizeof(truncated), -50));
+    
+    const uint8_t encrypted[] = { 0x07, 0x16, 0xD2, 0xFC, 0x41, 0x03, 0xBF, 0x13 };
+    TEST_ASSERT_FALSE(bthome_matcher_match(&matcher, encrypted, sizeof(encrypted), -50));
+}
+
+TEST_CASE("BTHome filter: match all", "[bthome][filter]") {
+    test_filter_match_all();
+}
+
+TEST_CASE("BTHome filter: objects and events", "[bthome][filter]") {
+    test_filter_objects_and_events();
+}
+
+TEST_CASE("BTHome filter: merged service data elements", "[bthome][filter]") {
+    test_filter_merged_elements();
+}
+
+TEST_CASE("BTHome filter: name prefixes and rssi", "[bthome][filter]") {
+    test_filter_name_and_rssi();
+}
+
+TEST_CASE("BTHome filter: invalid data", "[bthome][filter]") {
+    test_filter_invalid_data();
+}
@@ -0,0 +1,45 @@
+#include <string.h>
+#include "unity.h"
+#include "bthome_histogram.h"
+
+// Test bucket placement and percentiles
+void test_histogram_buckets(void) {
+    bthome_histogram_t histogram;
+    bthome_histogram_reset(&histogram);
+    TEST_ASSERT_EQUAL_UINT32(0, bthome_histogram_percentile(&histogram, 50));
+
+    bthome_histogram_record(&histogram, 0);
+    bthome_histogram_record(&histogram, 1);
+    bthome_histogram_record(&histogram, 3);
+    bthome_histogram_record(&histogram, 4);
+    TEST_ASSERT_EQUAL_UINT32(1, histogram.buckets[0]);
+    TEST_ASSERT_EQUAL_UINT32(1, histogram.buckets[1]);
+    TEST_ASSERT_EQUAL_UINT32(1, histogram.buckets[2]);
+    TEST_ASSERT_EQUAL_UINT32(1, histogram.buckets[3]);
+    TEST_ASSERT_EQUAL_UINT32(4, histogram.count);
+    TEST_ASSERT_EQUAL_UINT32(8, histogram.total_us);
+    TEST_ASSERT_EQUAL_UINT32(4, histogram.max_us);
+    TEST_ASSERT_EQUAL_UINT32(4, bthome_histogram_bucket_floor(3));
+
+    // 96 fast samples and 4 slow ones
+    bthome_histogram_reset(&histogram);
+    for (int i = 0; i < 96; i++) {
+        bthome_histogram_record(&histogram, 100);
+    }
+    for (int i = 0; i < 4; i++) {
+        bthome_histogram_record(&histogram, 20000);
+    }
+    TEST_ASSERT_EQUAL_UINT32(127, bthome_histogram_percentile(&histogram, 50));
+    TEST_ASSERT_EQUAL_UINT32(127, bthome_histogram_percentile(&histogram, 96));
+    TEST_ASSERT_EQUAL_UINT32(20000, bthome_histogram_percentile(&histogram, 99));
+    TEST_ASSERT_EQUAL_UINT32(20000, bthome_histogram_percentile(&histogram, 100));
+
+    // Very long stalls land in the last bucket
+    bthome_histogram_record(&histogram, UINT32_MAX);
+    TEST_ASSERT_EQUAL_UINT32(1, histogram.buckets[BTHOME_HISTOGRAM_BUCKETS - 1]);
+    TEST_ASSERT_EQUAL_UINT32(UINT32_MAX, bthome_histogram_percentile(&histogram, 100));
+}
+
+TEST_CASE("BTHome histogram: buckets and percentiles", "[bthome][histogram]") {
+    test_histogram_buckets();
+}
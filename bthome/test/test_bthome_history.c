@@ -0,0 +1,108 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "unity.h"
+#include "bthome.h"
+#include "bthome_history.h"
+
+static const uint8_t addr_a[6] = { 0xA4, 0xC1, 0x38, 0x00, 0x00, 0x01 };
+static const uint8_t addr_b[6] = { 0xA4, 0xC1, 0x38, 0x00, 0x00, 0x02 };
+
+// Test that samples come back exactly, including large jumps in time and value
+void test_history_round_trip(void) {
+    static uint64_t mem[8 * 1024 / sizeof(uint64_t)];
+    bthome_history_t history;
+    TEST_ASSERT_EQUAL_INT(0, bthome_history_init(&history, mem, sizeof(mem), 4));
+    
+    static const struct { uint32_t timestamp; int64_t value; } samples[] = {
+        { 1000, 2150 }, { 1030, 2150 }, { 1060, 2151 }, { 1089, 2149 }, { 1120, -400 },
+        { 5000, 2147483647 }, { 5000, -2147483648LL }, { 4000000000u, 4294967295LL }, { 4000000030u, 0 },
+    };
+    size_t count = sizeof(samples) / sizeof(samples[0]);
+    for (size_t i = 0; i < count; i++) {
+        TEST_ASSERT_EQUAL_INT(0, bthome_history_append(&history, addr_a, BTHOME_SENSOR_TEMPERATURE, 0,
+                                                       samples[i].timestamp, samples[i].value));
+    }
+    TEST_ASSERT_EQUAL_INT(-2, bthome_history_append(&history, addr_a, BTHOME_SENSOR_TEMPERATURE, 0, 10, 0));
+    
+    bthome_history_iter_t iter;
+    uint32_t timestamp;
+    int64_t value;
+    TEST_ASSERT_EQUAL_INT(0, bthome_history_query(&history, addr_a, BTHOME_SENSOR_TEMPERATURE, 0,
+                                                  0, UINT32_MAX, &iter));
+    for (size_t i = 0; i < count; i++) {
+        TEST_ASSERT_TRUE(bthome_history_next(&iter, &timestamp, &value));
+        TEST_ASSERT_EQUAL_UINT32(samples[i].timestamp, timestamp);
+        TEST_ASSERT_TRUE(samples[i].value == value);
+    }
+    TEST_ASSERT_FALSE(bthome_history_next(&iter, &timestamp, &value));
+    
+    // Range query
+    TEST_ASSERT_EQUAL_INT(0, bthome_history_query(&history, addr_a, BTHOME_SENSOR_TEMPERATURE, 0,
+                                                  1060, 5000, &iter));
+    size_t in_range = 0;
+    while (bthome_history_next(&iter, &timestamp, &value)) {
+        TEST_ASSERT_TRUE(timestamp >= 1060 && timestamp <= 5000);
+        in_range++;
+    }
+    TEST_ASSERT_EQUAL_size_t(5, in_range);
+    
+    TEST_ASSERT_EQUAL_INT(-1, bthome_history_query(&history, addr_b, BTHOME_SENSOR_TEMPERATURE, 0,
+                                                   0, UINT32_MAX, &iter));
+}
+
+// Test that a realistic sensor keeps over 10x the samples of storing raw measurements
+void test_history_compression(void) {
+    static uint64_t mem[16 * 1024 / sizeof(uint64_t)];
+    bthome_history_t history;
+    TEST_ASSERT_EQUAL_INT(0, bthome_history_init(&history, mem, sizeof(mem), 4));
+    
+    // Temperature and humidity every 30s with a second of jitter, drifting slowly
+    srand(1);
+    uint32_t timestamp = 1700000000;
+    int16_t temperature = 2150;
+    uint16_t humidity = 4500;
+    const int total = 40000;
+    for (int i = 0; i < total; i++) {
+        timestamp += 29 + rand() % 3;
+        temperature += rand() % 5 - 2;
+        humidity += rand() % 3 - 1;
+        
+        bthome_packet_t packet;
+        bthome_packet_init(&packet);
+        bthome_add_sensor_sint16(&packet, BTHOME_SENSOR_TEMPERATURE, temperature);
+        bthome_add_sensor_uint16(&packet, BTHOME_SENSOR_HUMIDITY, humidity);
+        TEST_ASSERT_EQUAL_INT(2, bthome_history_append_packet(&history, addr_a, &packet, timestamp));
+        bthome_packet_free(&packet);
+    }
+    
+    // The newest samples are kept, ending with the last one appended
+    size_t kept = 0;
+    uint32_t sample_timestamp = 0;
+    int64_t value = 0;
+    bthome_history_iter_t iter;
+    TEST_ASSERT_EQUAL_INT(0, bthome_history_query(&history, addr_a, BTHOME_SENSOR_TEMPERATURE, 0,
+                                                  0, UINT32_MAX, &iter));
+    while (bthome_history_next(&iter, &sample_timestamp, &value)) {
+        kept++;
+    }
+    TEST_ASSERT_EQUAL_UINT32(timestamp, sample_timestamp);
+    TEST_ASSERT_TRUE(value == temperature);
+    TEST_ASSERT_EQUAL_INT(0, bthome_history_query(&history, addr_a, BTHOME_SENSOR_HUMIDITY, 0,
+                                                  0, UINT32_MAX, &iter));
+    while (bthome_history_next(&iter, &sample_timestamp, &value)) {
+        kept++;
+    }
+    
+    size_t uncompressed = sizeof(mem) / (sizeof(bthome_measurement_t) + sizeof(uint32_t));
+    printf("History: %zu samples in %zu bytes (%zu uncompressed)\n", kept, sizeof(mem), uncompressed);
+    TEST_ASSERT_GREATER_THAN(10 * uncompressed, kept);
+}
+
+TEST_CASE("BTHome history: round trip and range query", "[bthome][history]") {
+    test_history_round_trip();
+}
+
+TEST_CASE("BTHome history: compression", "[bthome][history]") {
+    test_history_compression();
+}
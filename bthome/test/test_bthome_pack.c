@@ -0,0 +1,173 @@
+#include <stdio.h>
+#include <string.h>
+#include "unity.h"
+#include "bthome.h"
+#include "bthome_pack.h"
+
+// Test that measurements too large for one advertisement are split without losing any
+void test_pack_split(void) {
+    bthome_packet_t packet;
+    bthome_packet_init(&packet);
+    bthome_set_device_info(&packet, false, false);
+    bthome_set_device_name(&packet, "DIY-sensor", 10, true);
+    bthome_set_packet_id(&packet, 1);
+    for (int i = 0; i < 8; i++) {
+        bthome_add_sensor_sint16(&packet, BTHOME_SENSOR_TEMPERATURE, 2000 + i);
+    }
+    bthome_add_sensor_uint8(&packet, BTHOME_SENSOR_BATTERY, 90);
+    bthome_add_button_event(&packet, BTHOME_BUTTON_PRESS);
+    
+    // 8 * 3 + 2 + 2 object bytes don't fit in one advertisement
+    uint8_t buffer[BTHOME_ADV_MAX_LEN];
+    TEST_ASSERT_LESS_THAN(0, bthome_encode_advertisement(&packet, buffer, sizeof(buffer), true));
+    
+    bthome_packed_adv_t advs[4];
+    int count = bthome_pack_advertisements(&packet, NULL, true, advs, 4);
+    TEST_ASSERT_EQUAL_INT(2, count);
+    
+    size_t temperatures = 0, batteries = 0, events = 0, names = 0;
+    for (int i = 0; i < count; i++) {
+        TEST_ASSERT_LESS_OR_EQUAL(BTHOME_ADV_MAX_LEN, advs[i].len);
+        
+        bthome_packet_t decoded;
+        TEST_ASSERT_EQUAL_INT(0, bthome_decode_advertisement(advs[i].data, advs[i].len, &decoded));
+        TEST_ASSERT_TRUE(decoded.has_packet_id);
+        TEST_ASSERT_EQUAL_UINT8(1, decoded.packet_id);
+        for (size_t j = 0; j < decoded.measurement_count; j++) {
+            if (decoded.measurements[j].object_id == BTHOME_SENSOR_TEMPERATURE) {
+                TEST_ASSERT_EQUAL_INT16(2000 + temperatures, decoded.measurements[j].value.sint16_val);
+                temperatures++;
+            } else if (decoded.measurements[j].object_id == BTHOME_SENSOR_BATTERY) {
+                batteries++;
+            }
+        }
+        events += decoded.event_count;
+        for (size_t j = 0; j + 1 < advs[i].len; j += 1 + advs[i].data[j]) {
+            names += advs[i].data[j + 1] == 0x09;  // Complete local name
+        }
+        bthome_packet_free(&decoded);
+        
+        // The packet ID can be changed in place
+        bthome_pack_set_packet_id(&advs[i], 2);
+        TEST_ASSERT_EQUAL_INT(0, bthome_decode_advertisement(advs[i].data, advs[i].len, &decoded));
+        TEST_ASSERT_EQUAL_UINT8(2, decoded.packet_id);
+        bthome_packet_free(&decoded);
+    }
+    
+    TEST_ASSERT_EQUAL_size_t(8, temperatures);
+    TEST_ASSERT_EQUAL_size_t(1, batteries);
+    TEST_ASSERT_EQUAL_size_t(1, events);
+    TEST_ASSERT_GREATER_OR_EQUAL(1, names);
+    
+    TEST_ASSERT_EQUAL_INT(-2, bthome_pack_advertisements(&packet, NULL, true, advs, 1));
+    
+    bthome_packet_free(&packet);
+}
+
+// Test that readings are grouped by interval and the schedule meets every interval
+void test_pack_schedule(void) {
+    bthome_packet_t packet;
+    bthome_packet_init(&packet);
+    bthome_set_device_info(&packet, false, false);
+    
+    // Fast readings fill one advertisement, slow readings another
+    uint32_t intervals[12];
+    for (int i = 0; i < 6; i++) {
+        bthome_add_sensor_uint32(&packet, BTHOME_SENSOR_COUNT_UINT32, i);
+        intervals[i] = i % 2 ? 1000 : 60000;
+    }
+    for (int i = 6; i < 12; i++) {
+        bthome_add_sensor_uint16(&packet, BTHOME_SENSOR_CO2, 400 + i);
+        intervals[i] = 10000;
+    }
+    
+    bthome_packed_adv_t advs[8];
+    int count = bthome_pack_advertisements(&packet, intervals, true, advs, 8);
+    TEST_ASSERT_GREATER_THAN(0, count);
+    TEST_ASSERT_EQUAL_UINT32(1000, advs[0].interval_ms);
+    
+    uint8_t schedule[256];
+    int slots = bthome_pack_schedule(advs, count, 500, schedule, sizeof(schedule));
+    TEST_ASSERT_GREATER_THAN(0, slots);
+    
+    // Every advertisement must come around within its interval, wrapping around the cycle
+    for (int i = 0; i < count; i++) {
+        uint32_t period = advs[i].interval_ms / 500;
+        for (int start = 0; start < slots; start++) {
+            bool seen = false;
+            for (uint32_t k = 0; k < period && !seen; k++) {
+                seen = schedule[(start + k) % slots] == i;
+            }
+            TEST_ASSERT_TRUE(seen);
+        }
+    }
+    
+    // Too many advertisements for the slots available
+    for (int i = 0; i < count; i++) {
+        advs[i].interval_ms = 1000;
+    }
+    TEST_ASSERT_EQUAL_INT(-1, bthome_pack_schedule(advs, count, 1000, schedule, sizeof(schedule)));
+    
+    bthome_packet_free(&packet);
+}
+
+// Test that advertisements packed without intervals rotate round-robin
+void test_pack_schedule_unspecified(void) {
+    bthome_packet_t packet;
+    bthome_packet_init(&packet);
+    bthome_set_device_info(&packet, false, false);
+    for (int i = 0; i < 12; i++) {
+        bthome_add_sensor_uint32(&packet, BTHOME_SENSOR_COUNT_UINT32, i);
+    }
+    
+    bthome_packed_adv_t advs[8];
+    int count = bthome_pack_advertisements(&packet, NULL, true, advs, 8);
+    TEST_ASSERT_GREATER_THAN(1, count);
+    
+    uint8_t schedule[256];
+    int slots = bthome_pack_schedule(advs, count, 500, schedule, sizeof(schedule));
+    TEST_ASSERT_EQUAL_INT(count, slots);
+    
+    // Each advertisement exactly once per cycle
+    for (int i = 0; i < count; i++) {
+        int seen = 0;
+        for (int slot = 0; slot < slots; slot++) {
+            seen += schedule[slot] == i;
+        }
+        TEST_ASSERT_EQUAL_INT(1, seen);
+    }
+    
+    bthome_packet_free(&packet);
+}
+
+// Test an object that can never fit
+void test_pack_oversized(void) {
+    bthome_packet_t packet;
+    bthome_packet_init(&packet);
+    bthome_set_device_info(&packet, false, false);
+    
+    char text[40];
+    memset(text, 'x', sizeof(text));
+    bthome_add_sensor_text(&packet, text, sizeof(text));
+    
+    bthome_packed_adv_t advs[4];
+    TEST_ASSERT_EQUAL_INT(-1, bthome_pack_advertisements(&packet, NULL, true, advs, 4));
+    
+    bthome_packet_free(&packet);
+}
+
+TEST_CASE("BTHome pack: split oversized packet", "[bthome][pack]") {
+    test_pack_split();
+}
+
+TEST_CASE("BTHome pack: rotation schedule", "[bthome][pack]") {
+    test_pack_schedule();
+}
+
+TEST_CASE("BTHome pack: round-robin without intervals", "[bthome][pack]") {
+    test_pack_schedule_unspecified();
+}
+
+TEST_CASE("BTHome pack: oversized object", "[bthome][pack]") {
+    test_pack_oversized();
+}
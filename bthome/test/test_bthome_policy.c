@@ -0,0 +1,113 @@
+#include <string.h>
+#include "unity.h"
+#include "bthome.h"
+#include "bthome_policy.h"
+
+// Build a sample with a temperature (0.01 °C), humidity (0.01 %) and a door sensor
+static void build_sample(bthome_packet_t *packet, int16_t temperature, uint16_t humidity, bool open) {
+    bthome_packet_init(packet);
+    bthome_add_sensor_sint16(packet, BTHOME_SENSOR_TEMPERATURE, temperature);
+    bthome_add_sensor_uint16(packet, BTHOME_SENSOR_HUMIDITY, humidity);
+    bthome_add_binary_sensor(packet, BTHOME_BINARY_DOOR, open);
+}
+
+static bthome_policy_reason_t sample(bthome_policy_t *policy, int16_t temperature, uint16_t humidity,
+                                     bool open, uint32_t now_ms) {
+    bthome_packet_t packet;
+    build_sample(&packet, temperature, humidity, open);
+    bthome_policy_reason_t reason = bthome_policy_sample(policy, &packet, now_ms);
+    bthome_packet_free(&packet);
+    return reason;
+}
+
+// Test deadbands, binary changes and the heartbeat
+void test_policy_deadbands(void) {
+    bthome_policy_t policy;
+    bthome_policy_init(&policy, 60000);
+    TEST_ASSERT_EQUAL_INT(0, bthome_policy_set_deadband(&policy, BTHOME_SENSOR_TEMPERATURE, 0.2f, 0));
+    TEST_ASSERT_EQUAL_INT(0, bthome_policy_set_deadband(&policy, BTHOME_SENSOR_HUMIDITY, 0.5f, 0.05f));
+
+    TEST_ASSERT_EQUAL_INT(BTHOME_POLICY_FIRST, sample(&policy, 2100, 4000, false, 0));
+
+    // Within the deadbands around the last sent values, even as changes accumulate
+    TEST_ASSERT_EQUAL_INT(BTHOME_POLICY_SKIP, sample(&policy, 2110, 4000, false, 1000));
+    TEST_ASSERT_EQUAL_INT(BTHOME_POLICY_SKIP, sample(&policy, 2120, 4150, false, 2000));
+    TEST_ASSERT_EQUAL_INT(BTHOME_POLICY_CHANGE, sample(&policy, 2121, 4150, false, 3000));
+    TEST_ASSERT_EQUAL_INT(BTHOME_POLICY_SKIP, sample(&policy, 2121, 4150, false, 4000));
+
+    // Humidity must move more than 5% of 41.5 %, not just the 0.5 % floor
+    TEST_ASSERT_EQUAL_INT(BTHOME_POLICY_SKIP, sample(&policy, 2121, 4350, false, 5000));
+    TEST_ASSERT_EQUAL_INT(BTHOME_POLICY_CHANGE, sample(&policy, 2121, 4360, false, 6000));
+
+    // Binary changes go out at once
+    TEST_ASSERT_EQUAL_INT(BTHOME_POLICY_BINARY, sample(&policy, 2121, 4360, true, 7000));
+    TEST_ASSERT_EQUAL_INT(BTHOME_POLICY_SKIP, sample(&policy, 2121, 4360, true, 8000));
+
+    // Heartbeat after a minute of silence
+    TEST_ASSERT_EQUAL_INT(BTHOME_POLICY_SKIP, sample(&policy, 2121, 4360, true, 66999));
+    TEST_ASSERT_EQUAL_INT(BTHOME_POLICY_HEARTBEAT, sample(&policy, 2121, 4360, true, 67000));
+    TEST_ASSERT_EQUAL_INT(BTHOME_POLICY_SKIP, sample(&policy, 2121, 4360, true, 68000));
+}
+
+// Test events, objects without a deadband and changes to the packet layout
+void test_policy_events_and_layout(void) {
+    bthome_policy_t policy;
+    bthome_policy_init(&policy, 0);
+
+    bthome_packet_t packet;
+    build_sample(&packet, 2000, 5000, false);
+    TEST_ASSERT_EQUAL_INT(BTHOME_POLICY_FIRST, bthome_policy_sample(&policy, &packet, 0));
+    TEST_ASSERT_EQUAL_INT(BTHOME_POLICY_SKIP, bthome_policy_sample(&policy, &packet, 1000));
+
+    // No heartbeat
+    TEST_ASSERT_EQUAL_INT(BTHOME_POLICY_SKIP, bthome_policy_sample(&policy, &packet, UINT32_MAX));
+
+    bthome_add_button_event(&packet, BTHOME_BUTTON_PRESS);
+    TEST_ASSERT_EQUAL_INT(BTHOME_POLICY_EVENT, bthome_policy_sample(&policy, &packet, 2000));
+    bthome_packet_free(&packet);
+
+    // Without a deadband any change is sent
+    TEST_ASSERT_EQUAL_INT(BTHOME_POLICY_CHANGE, sample(&policy, 2001, 5000, false, 3000));
+
+    // A new object changes the layout
+    build_sample(&packet, 2001, 5000, false);
+    bthome_add_sensor_uint8(&packet, BTHOME_SENSOR_BATTERY, 90);
+    TEST_ASSERT_EQUAL_INT(BTHOME_POLICY_CHANGE, bthome_policy_sample(&policy, &packet, 4000));
+    TEST_ASSERT_EQUAL_INT(BTHOME_POLICY_SKIP, bthome_policy_sample(&policy, &packet, 5000));
+    bthome_packet_free(&packet);
+
+    // Text is compared by content
+    bthome_packet_init(&packet);
+    char text[] = "idle";
+    bthome_add_sensor_text(&packet, text, 4);
+    TEST_ASSERT_EQUAL_INT(BTHOME_POLICY_CHANGE, bthome_policy_sample(&policy, &packet, 6000));
+    TEST_ASSERT_EQUAL_INT(BTHOME_POLICY_SKIP, bthome_policy_sample(&policy, &packet, 7000));
+    memcpy(text, "busy", 4);
+    TEST_ASSERT_EQUAL_INT(BTHOME_POLICY_CHANGE, bthome_policy_sample(&policy, &packet, 8000));
+    bthome_packet_free(&packet);
+}
+
+// Test that the rule table is bounded and rules can be replaced
+void test_policy_rules(void) {
+    bthome_policy_t policy;
+    bthome_policy_init(&policy, 0);
+    for (int i = 0; i < BTHOME_POLICY_MAX_RULES; i++) {
+        TEST_ASSERT_EQUAL_INT(0, bthome_policy_set_deadband(&policy, i, 1, 0));
+    }
+    TEST_ASSERT_EQUAL_INT(-1, bthome_policy_set_deadband(&policy, BTHOME_POLICY_MAX_RULES, 1, 0));
+    TEST_ASSERT_EQUAL_INT(0, bthome_policy_set_deadband(&policy, 0, 2, 0));
+    TEST_ASSERT_EQUAL_size_t(BTHOME_POLICY_MAX_RULES, policy.rule_count);
+    TEST_ASSERT_EQUAL_FLOAT(2, policy.rules[0].absolute);
+}
+
+TEST_CASE("BTHome policy: deadbands and heartbeat", "[bthome][policy]") {
+    test_policy_deadbands();
+}
+
+TEST_CASE("BTHome policy: events and packet layout", "[bthome][policy]") {
+    test_policy_events_and_layout();
+}
+
+TEST_CASE("BTHome policy: rule table", "[bthome][policy]") {
+    test_policy_rules();
+}
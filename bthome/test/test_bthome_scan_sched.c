@@ -0,0 +1,167 @@
+#include <string.h>
+#include "unity.h"
+#include "bthome_scan_sched.h"
+
+static void make_addr(uint8_t addr[6], uint8_t n) {
+    const uint8_t base[6] = { 0xA4, 0xC1, 0x38, 0x00, 0x00, 0x00 };
+    memcpy(addr, base, 6);
+    addr[5] = n;
+}
+
+// Deterministic jitter, standing in for the random advDelay added to every advertising event
+static uint32_t next_random(uint32_t *state) {
+    *state = *state * 1103515245 + 12345;
+    return (*state >> 16) & 0x7FFF;
+}
+
+// Whether an advertisement sent at t_ms falls inside a scan window
+static bool captured(const bthome_scan_sched_t *sched, uint32_t window_start_ms, uint32_t t_ms) {
+    uint32_t interval_us = sched->scan_interval * 625;
+    uint32_t window_us = sched->scan_window * 625;
+    return (uint64_t)(t_ms - window_start_ms) * 1000 % interval_us < window_us;
+}
+
+// Test that periods are learned and the interval is stretched to the target latency
+void test_scan_sched_learns_periods(void) {
+    bthome_scan_sched_config_t config;
+    bthome_scan_sched_get_default_config(&config);
+    bthome_scan_sched_t sched;
+    bthome_scan_sched_init(&sched, &config, 1000);
+
+    TEST_ASSERT_EQUAL_UINT16(config.scan_window, sched.scan_interval);
+    TEST_ASSERT_EQUAL_UINT16(1000, bthome_scan_sched_duty_permille(&sched));
+
+    // Five devices every 10s, heard perfectly while learning
+    uint8_t addr[6];
+    for (uint32_t t = 1000; t <= 51000; t += 10000) {
+        for (uint8_t d = 0; d < 5; d++) {
+            make_addr(addr, d);
+            TEST_ASSERT_FALSE(bthome_scan_sched_observe(&sched, addr, false, t + d));
+        }
+    }
+    TEST_ASSERT_EQUAL_UINT32(10000, sched.devices[0].period_ms);
+
+    // 3 captures per 300s at 10s each needs 10%, give or take avoiding resonance
+    TEST_ASSERT_TRUE(bthome_scan_sched_update(&sched, 61005));
+    TEST_ASSERT_TRUE(sched.scan_interval <= config.scan_window * 10);
+    TEST_ASSERT_TRUE(sched.scan_interval >= config.scan_window * 10 * 7 / 8);
+    TEST_ASSERT_FALSE(bthome_scan_sched_update(&sched, 62000));
+
+    // Missed advertisements don't change the period
+    make_addr(addr, 0);
+    bthome_scan_sched_observe(&sched, addr, false, 91000);
+    TEST_ASSERT_EQUAL_UINT32(10000, sched.devices[0].period_ms);
+
+    // A slower device raises the duty cycle
+    make_addr(addr, 9);
+    bthome_scan_sched_observe(&sched, addr, false, 92000);
+    TEST_ASSERT_TRUE(bthome_scan_sched_observe(&sched, addr, false, 122000));
+    TEST_ASSERT_EQUAL_UINT32(30000, sched.devices[5].period_ms);
+    TEST_ASSERT_TRUE(bthome_scan_sched_duty_permille(&sched) >= 300);
+
+    // Quiet devices are forgotten, and the interval stretches back to the floor
+    TEST_ASSERT_TRUE(bthome_scan_sched_update(&sched, 122000 + config.target_latency_ms + 1));
+    for (size_t i = 0; i < BTHOME_SCAN_SCHED_MAX_DEVICES; i++) {
+        TEST_ASSERT_FALSE(sched.devices[i].used);
+    }
+    TEST_ASSERT_EQUAL_UINT16(50, bthome_scan_sched_duty_permille(&sched));
+}
+
+// Test that trigger-based packets open a full window
+void test_scan_sched_burst(void) {
+    bthome_scan_sched_config_t config;
+    bthome_scan_sched_get_default_config(&config);
+    config.learn_ms = 0;
+    bthome_scan_sched_t sched;
+    bthome_scan_sched_init(&sched, &config, 0);
+    TEST_ASSERT_TRUE(bthome_scan_sched_update(&sched, 0));
+    uint16_t idle_interval = sched.scan_interval;
+    TEST_ASSERT_EQUAL_UINT16(50, bthome_scan_sched_duty_permille(&sched));
+
+    uint8_t button[6];
+    make_addr(button, 1);
+    TEST_ASSERT_TRUE(bthome_scan_sched_observe(&sched, button, true, 5000));
+    TEST_ASSERT_EQUAL_UINT16(config.scan_window, sched.scan_interval);
+
+    // Further presses extend the burst without restarting the scan
+    TEST_ASSERT_FALSE(bthome_scan_sched_observe(&sched, button, true, 6500));
+    TEST_ASSERT_FALSE(bthome_scan_sched_update(&sched, 7000));
+    TEST_ASSERT_TRUE(bthome_scan_sched_update(&sched, 6500 + config.burst_ms));
+    TEST_ASSERT_EQUAL_UINT16(idle_interval, sched.scan_interval);
+
+    // Trigger-based devices don't hold the duty cycle up
+    TEST_ASSERT_EQUAL_UINT32(0, sched.devices[0].period_ms);
+}
+
+// Simulate an hour of periodic devices against the scheduler's windows
+void test_scan_sched_simulated_capture(void) {
+    bthome_scan_sched_config_t config;
+    bthome_scan_sched_get_default_config(&config);
+    bthome_scan_sched_t sched;
+    bthome_scan_sched_init(&sched, &config, 0);
+
+    static const uint32_t periods_ms[] = { 10000, 10000, 15000, 20000, 30000 };
+    const size_t device_count = sizeof(periods_ms) / sizeof(periods_ms[0]);
+    uint32_t next_adv_ms[5];
+    uint32_t last_heard_ms[5];
+    uint32_t longest_silence_ms[5] = { 0 };
+    uint32_t random = 1;
+    for (size_t d = 0; d < device_count; d++) {
+        next_adv_ms[d] = next_random(&random) % periods_ms[d];
+        last_heard_ms[d] = 0;
+    }
+
+    uint32_t window_start_ms = 0;
+    uint64_t radio_on_ms = 0;
+    uint32_t captures = 0;
+    for (uint32_t now = 0; now < 60 * 60 * 1000; now++) {
+        if (captured(&sched, window_start_ms, now)) {
+            radio_on_ms++;
+        }
+        for (size_t d = 0; d < device_count; d++) {
+            if (now != next_adv_ms[d]) {
+                continue;
+            }
+            next_adv_ms[d] += periods_ms[d] + next_random(&random) % 10;
+            if (!captured(&sched, window_start_ms, now)) {
+                continue;
+            }
+            captures++;
+            if (now >= config.learn_ms && now - last_heard_ms[d] > longest_silence_ms[d]) {
+                longest_silence_ms[d] = now - last_heard_ms[d];
+            }
+            last_heard_ms[d] = now;
+            uint8_t addr[6];
+            make_addr(addr, d);
+            if (bthome_scan_sched_observe(&sched, addr, false, now)) {
+                window_start_ms = now;
+            }
+        }
+        if (now % 1000 == 0 && bthome_scan_sched_update(&sched, now)) {
+            window_start_ms = now;
+        }
+    }
+
+    // The 30s device needs 30%, the others less
+    uint16_t duty = bthome_scan_sched_duty_permille(&sched);
+    TEST_ASSERT_TRUE(duty >= 300 && duty <= 350);
+    for (size_t d = 0; d < device_count; d++) {
+        TEST_ASSERT_TRUE(longest_silence_ms[d] <= config.target_latency_ms);
+    }
+    // Every device was heard within the target latency, with the radio on well under the
+    // 60% of the default fixed 30ms/50ms parameters
+    TEST_ASSERT_TRUE(captures > 0);
+    TEST_ASSERT_TRUE(radio_on_ms < 60 * 60 * 1000 * 45 / 100);
+}
+
+TEST_CASE("BTHome scan scheduler: period learning", "[bthome][scan_sched]") {
+    test_scan_sched_learns_periods();
+}
+
+TEST_CASE("BTHome scan scheduler: trigger bursts", "[bthome][scan_sched]") {
+    test_scan_sched_burst();
+}
+
+TEST_CASE("BTHome scan scheduler: simulated capture", "[bthome][scan_sched]") {
+    test_scan_sched_simulated_capture();
+}
@@ -0,0 +1,158 @@
+#include <stdio.h>
+#include <string.h>
+#include "unity.h"
+#include "bthome.h"
+#include "bthome_scanner_core.h"
+
+// Example payload from the BTHome documentation: "DIY-sensor", temperature and humidity
+static const uint8_t example_adv[] = {
+    0x02, 0x01, 0x06,
+    0x0B, 0x09, 0x44, 0x49, 0x59, 0x2D, 0x73, 0x65, 0x6E, 0x73, 0x6F, 0x72,
+    0x0A, 0x16, 0xD2, 0xFC, 0x40, 0x02, 0xC4, 0x09, 0x03, 0xBF, 0x13
+};
+
+// Trigger-based button press with packet ID, no name
+static const uint8_t button_adv[] = {
+    0x02, 0x01, 0x06,
+    0x08, 0x16, 0xD2, 0xFC, 0x44, 0x00, 0x21, 0x3A, 0x01
+};
+
+static const uint8_t addr_a[6] = { 0xA4, 0xC1, 0x38, 0x00, 0x00, 0x01 };
+static const uint8_t addr_b[6] = { 0xA4, 0xC1, 0x38, 0x00, 0x00, 0x02 };
+
+// Test that the core decodes and records reports, and interns names
+void test_scanner_core_decode_record(void) {
+    static bthome_scanner_core_t core;
+    bthome_scanner_core_init(&core);
+
+    bthome_packet_t packet;
+    TEST_ASSERT_EQUAL_INT(1, bthome_scanner_core_decode(&core, addr_a, example_adv, 3, -60, &packet));
+    TEST_ASSERT_EQUAL_INT(0, bthome_scanner_core_decode(&core, addr_a, example_adv, sizeof(example_adv), -60, &packet));
+    TEST_ASSERT_FALSE(bthome_scanner_core_record(&core, addr_a, -60, example_adv, sizeof(example_adv),
+                                                 &packet, 0));
+    TEST_ASSERT_TRUE(packet.name_shared);
+    TEST_ASSERT_EQUAL_STRING("DIY-sensor", packet.device_name);
+    bthome_packet_free(&packet);
+
+    const bthome_device_entry_t *entry = bthome_device_cache_lookup(&core.device_cache, addr_a);
+    TEST_ASSERT_EQUAL_INT8(-60, entry->rssi);
+    TEST_ASSERT_EQUAL_UINT8(sizeof(example_adv), entry->adv_len);
+}
+
+// Test that configuring filters and the scheduler keeps the device cache
+void test_scanner_core_configure(void) {
+    static bthome_scanner_core_t core;
+    bthome_scanner_core_init(&core);
+
+    bthome_packet_t packet;
+    TEST_ASSERT_EQUAL_INT(0, bthome_scanner_core_decode(&core, addr_a, example_adv, sizeof(example_adv), -60, &packet));
+    bthome_scanner_core_record(&core, addr_a, -60, example_adv, sizeof(example_adv), &packet, 0);
+    bthome_packet_free(&packet);
+
+    bthome_filter_t filter;
+    bthome_filter_init(&filter);
+    filter.event_types = BTHOME_FILTER_EVENT_BUTTON;
+    bthome_scan_sched_config_t sched_config;
+    bthome_scan_sched_get_default_config(&sched_config);
+    sched_config.learn_ms = 0;
+    TEST_ASSERT_EQUAL_INT(0, bthome_scanner_core_configure(&core, &filter, false, &sched_config, 1000));
+    TEST_ASSERT_EQUAL_UINT8(1, core.device_cache.name_count);
+
+    TEST_ASSERT_EQUAL_INT(1, bthome_scanner_core_decode(&core, addr_a, example_adv, sizeof(example_adv), -60, &packet));
+    TEST_ASSERT_EQUAL_INT(0, bthome_scanner_core_decode(&core, addr_a, button_adv, sizeof(button_adv), -60, &packet));
+
+    // Trigger-based packets open a burst
+    TEST_ASSERT_TRUE(bthome_scan_sched_update(&core.sched, 1000));
+    TEST_ASSERT_TRUE(bthome_scanner_core_record(&core, addr_b, -60, button_adv, sizeof(button_adv),
+                                                &packet, 2000));
+    TEST_ASSERT_TRUE(core.sched.bursting);
+    TEST_ASSERT_NULL(packet.device_name);
+    bthome_packet_free(&packet);
+
+    // An invalid filter leaves the core unchanged
+    filter.name_prefixes[0] = "This prefix is longer than any local name";
+    TEST_ASSERT_EQUAL_INT(-1, bthome_scanner_core_configure(&core, &filter, true, NULL, 3000));
+    TEST_ASSERT_TRUE(core.adaptive);
+    TEST_ASSERT_FALSE(core.intern_names);
+}
+
+// Test that name prefixes match a device's advertisements without a name by its known name
+void test_scanner_core_name_prefix(void) {
+    static bthome_scanner_core_t core;
+    bthome_scanner_core_init(&core);
+
+    bthome_filter_t filter;
+    bthome_filter_init(&filter);
+    filter.name_prefixes[0] = "DIY-";
+    TEST_ASSERT_EQUAL_INT(0, bthome_scanner_core_configure(&core, &filter, false, NULL, 0));
+
+    // Nothing is known about the device before it has sent its name
+    bthome_packet_t packet;
+    TEST_ASSERT_EQUAL_INT(1, bthome_scanner_core_decode(&core, addr_a, button_adv, sizeof(button_adv), -60, &packet));
+
+    TEST_ASSERT_EQUAL_INT(0, bthome_scanner_core_decode(&core, addr_a, example_adv, sizeof(example_adv), -60, &packet));
+    bthome_scanner_core_record(&core, addr_a, -60, example_adv, sizeof(example_adv), &packet, 0);
+    TEST_ASSERT_FALSE(packet.name_shared);  // Remembered, but not attached
+    bthome_packet_free(&packet);
+
+    // Later advertisements without a name match by the remembered one, for that device only
+    TEST_ASSERT_EQUAL_INT(0, bthome_scanner_core_decode(&core, addr_a, button_adv, sizeof(button_adv), -60, &packet));
+    bthome_packet_free(&packet);
+    TEST_ASSERT_EQUAL_INT(1, bthome_scanner_core_decode(&core, addr_b, button_adv, sizeof(button_adv), -60, &packet));
+
+    // A name in the advertisement itself still takes precedence
+    filter.name_prefixes[0] = "ATC_";
+    TEST_ASSERT_EQUAL_INT(0, bthome_scanner_core_configure(&core, &filter, false, NULL, 0));
+    TEST_ASSERT_EQUAL_INT(1, bthome_scanner_core_decode(&core, addr_a, example_adv, sizeof(example_adv), -60, &packet));
+    TEST_ASSERT_EQUAL_INT(1, bthome_scanner_core_decode(&core, addr_a, button_adv, sizeof(button_adv), -60, &packet));
+}
+
+// Test that a scan response report, which repeats the advertisement, is merged once
+void test_scanner_core_merge_response(void) {
+    static bthome_scanner_core_t core;
+    bthome_scanner_core_init(&core);
+
+    // What Bluedroid reports for the scan response: the cached advertisement, then the response
+    static const uint8_t scan_rsp[] = { 0x0B, 0x09, 0x44, 0x49, 0x59, 0x2D, 0x73, 0x65, 0x6E, 0x73, 0x6F, 0x72 };
+    uint8_t report[sizeof(button_adv) + sizeof(scan_rsp)];
+    memcpy(report, button_adv, sizeof(button_adv));
+    memcpy(report + sizeof(button_adv), scan_rsp, sizeof(scan_rsp));
+
+    uint8_t merged[BTHOME_DEVICE_CACHE_ADV_LEN];
+    int len = bthome_scanner_core_merge_response(button_adv, sizeof(button_adv), report, sizeof(button_adv),
+                                                 sizeof(scan_rsp), merged, sizeof(merged));
+    TEST_ASSERT_EQUAL_INT(sizeof(report), len);
+    TEST_ASSERT_EQUAL_MEMORY(report, merged, sizeof(report));
+
+    // One button event and the name, not the advertisement's objects twice
+    bthome_packet_t packet;
+    TEST_ASSERT_EQUAL_INT(0, bthome_scanner_core_decode(&core, addr_a, merged, len, -60, &packet));
+    TEST_ASSERT_EQUAL_size_t(1, packet.event_count);
+    TEST_ASSERT_EQUAL_size_t(10, packet.device_name_len);
+    bthome_scanner_core_record(&core, addr_a, -60, merged, len, &packet, 0);
+    bthome_packet_free(&packet);
+
+    // The merged advertisement fits the device cache
+    const bthome_device_entry_t *entry = bthome_device_cache_lookup(&core.device_cache, addr_a);
+    TEST_ASSERT_EQUAL_UINT8(len, entry->adv_len);
+
+    TEST_ASSERT_EQUAL_INT(-1, bthome_scanner_core_merge_response(button_adv, sizeof(button_adv), report,
+                                                                 sizeof(button_adv), sizeof(scan_rsp),
+                                                                 merged, sizeof(button_adv)));
+}
+
+TEST_CASE("BTHome scanner core: decode and record", "[bthome][scanner_core]") {
+    test_scanner_core_decode_record();
+}
+
+TEST_CASE("BTHome scanner core: configure", "[bthome][scanner_core]") {
+    test_scanner_core_configure();
+}
+
+TEST_CASE("BTHome scanner core: name prefix without a name", "[bthome][scanner_core]") {
+    test_scanner_core_name_prefix();
+}
+
+TEST_CASE("BTHome scanner core: merge scan response", "[bthome][scanner_core]") {
+    test_scanner_core_merge_response();
+}
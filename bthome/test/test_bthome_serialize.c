@@ -0,0 +1,200 @@
+#include <stdio.h>
+#include <string.h>
+#include "unity.h"
+#include "bthome.h"
+#include "bthome_serialize.h"
+
+static const uint8_t mac[6] = { 0xA4, 0xC1, 0x38, 0x0A, 0x1B, 0x2C };
+
+// Test JSON output for measurements, events and device fields
+void test_json_packet(void) {
+    bthome_packet_t packet;
+    bthome_packet_init(&packet);
+    bthome_set_device_name(&packet, "Kitchen \"1\"", 11, true);
+    bthome_set_packet_id(&packet, 9);
+    bthome_add_sensor_sint16(&packet, BTHOME_SENSOR_TEMPERATURE, -505);
+    bthome_add_sensor_uint8(&packet, BTHOME_SENSOR_BATTERY, 97);
+    bthome_add_sensor_sint8(&packet, BTHOME_SENSOR_TEMPERATURE_SINT8_035, 10);
+    bthome_add_sensor_text(&packet, "hi", 2);
+    bthome_add_button_event(&packet, BTHOME_BUTTON_PRESS);
+    bthome_add_dimmer_event(&packet, BTHOME_DIMMER_ROTATE_LEFT, 3);
+    
+    char buf[512];
+    size_t len = bthome_packet_to_json(&packet, mac, -61, buf, sizeof(buf));
+    
+    const char *expected =
+        "{\"mac\":\"A4:C1:38:0A:1B:2C\",\"rssi\":-61,\"name\":\"Kitchen \\\"1\\\"\",\"packet_id\":9,"
+        "\"measurements\":["
+        "{\"id\":2,\"name\":\"temperature\",\"value\":-5.05,\"unit\":\"°C\"},"
+        "{\"id\":1,\"name\":\"battery\",\"value\":97,\"unit\":\"%\"},"
+        "{\"id\":88,\"name\":\"temperature\",\"value\":3.50,\"unit\":\"°C\"},"
+        "{\"id\":83,\"name\":\"text\",\"value\":\"hi\"}],"
+        "\"events\":["
+        "{\"id\":58,\"name\":\"button\",\"event\":1},"
+        "{\"id\":60,\"name\":\"dimmer\",\"event\":1,\"steps\":3}]}";
+    TEST_ASSERT_EQUAL_STRING(expected, buf);
+    TEST_ASSERT_EQUAL_size_t(strlen(expected), len);
+    
+    bthome_packet_free(&packet);
+}
+
+// Test that a small buffer is truncated safely and the needed size is reported
+void test_json_truncated(void) {
+    bthome_packet_t packet;
+    bthome_packet_init(&packet);
+    bthome_add_sensor_uint16(&packet, BTHOME_SENSOR_HUMIDITY, 5055);
+    
+    char full[128];
+    size_t needed = bthome_packet_to_json(&packet, NULL, 0, full, sizeof(full));
+    TEST_ASSERT_EQUAL_STRING("{\"measurements\":[{\"id\":3,\"name\":\"humidity\",\"value\":50.55,"
+                             "\"unit\":\"%\"}],\"events\":[]}", full);
+    
+    char small[16];
+    memset(small, 'x', sizeof(small));
+    TEST_ASSERT_EQUAL_size_t(needed, bthome_packet_to_json(&packet, NULL, 0, small, sizeof(small)));
+    TEST_ASSERT_EQUAL_size_t(sizeof(small) - 1, strlen(small));
+    TEST_ASSERT_EQUAL_MEMORY(full, small, sizeof(small) - 1);
+    
+    // Sizing call without a buffer
+    TEST_ASSERT_EQUAL_size_t(needed, bthome_packet_to_json(&packet, NULL, 0, NULL, 0));
+    
+    bthome_packet_free(&packet);
+}
+
+// Test line protocol records for a device with precomputed tags
+void test_line_protocol(void) {
+    bthome_lp_tags_t tags;
+    TEST_ASSERT_EQUAL_INT(0, bthome_lp_tags_init(&tags, mac, "Living room", 11));
+    
+    bthome_packet_t packet;
+    bthome_packet_init(&packet);
+    bthome_add_sensor_sint16(&packet, BTHOME_SENSOR_TEMPERATURE, 2150);
+    bthome_add_sensor_uint8(&packet, BTHOME_SENSOR_BATTERY, 97);
+    bthome_add_dimmer_event(&packet, BTHOME_DIMMER_ROTATE_RIGHT, 2);
+    
+    char buf[512];
+    bthome_lp_batch_t batch;
+    bthome_lp_batch_init(&batch, buf, sizeof(buf));
+    TEST_ASSERT_EQUAL_INT(3, bthome_lp_append(&batch, &tags, &packet, 1700000000000000000ULL));
+    TEST_ASSERT_EQUAL_INT(3, bthome_lp_append(&batch, &tags, &packet, 0));
+    TEST_ASSERT_EQUAL_size_t(6, batch.lines);
+    
+    const char *expected =
+        "temperature,id=0x02,mac=A4:C1:38:0A:1B:2C,name=Living\\ room value=21.50 1700000000000000000\n"
+        "battery,id=0x01,mac=A4:C1:38:0A:1B:2C,name=Living\\ room value=97 1700000000000000000\n"
+        "dimmer,id=0x3C,mac=A4:C1:38:0A:1B:2C,name=Living\\ room event=2i,steps=2i 1700000000000000000\n"
+        "temperature,id=0x02,mac=A4:C1:38:0A:1B:2C,name=Living\\ room value=21.50\n"
+        "battery,id=0x01,mac=A4:C1:38:0A:1B:2C,name=Living\\ room value=97\n"
+        "dimmer,id=0x3C,mac=A4:C1:38:0A:1B:2C,name=Living\\ room event=2i,steps=2i\n";
+    TEST_ASSERT_EQUAL_STRING(expected, buf);
+    TEST_ASSERT_EQUAL_size_t(strlen(expected), batch.len);
+    
+    bthome_lp_batch_reset(&batch);
+    TEST_ASSERT_EQUAL_size_t(0, batch.len);
+    TEST_ASSERT_EQUAL_STRING("", buf);
+    
+    bthome_packet_free(&packet);
+}
+
+// Test that repeated objects, and objects sharing a name, get separate series
+void test_line_protocol_instances(void) {
+    bthome_lp_tags_t tags;
+    TEST_ASSERT_EQUAL_INT(0, bthome_lp_tags_init(&tags, mac, NULL, 0));
+    
+    bthome_packet_t packet;
+    bthome_packet_init(&packet);
+    bthome_add_sensor_sint16(&packet, BTHOME_SENSOR_TEMPERATURE, 2150);
+    bthome_add_sensor_uint8(&packet, BTHOME_SENSOR_BATTERY, 97);
+    bthome_add_sensor_sint16(&packet, BTHOME_SENSOR_TEMPERATURE, -320);
+    bthome_add_binary_sensor(&packet, BTHOME_BINARY_BATTERY, true);
+    bthome_add_button_event(&packet, BTHOME_BUTTON_PRESS);
+    bthome_add_button_event(&packet, BTHOME_BUTTON_NONE);
+    
+    char buf[512];
+    bthome_lp_batch_t batch;
+    bthome_lp_batch_init(&batch, buf, sizeof(buf));
+    TEST_ASSERT_EQUAL_INT(6, bthome_lp_append(&batch, &tags, &packet, 1700000000000000000ULL));
+    
+    const char *expected =
+        "temperature,id=0x02,mac=A4:C1:38:0A:1B:2C value=21.50 1700000000000000000\n"
+        "battery,id=0x01,mac=A4:C1:38:0A:1B:2C value=97 1700000000000000000\n"
+        "temperature,id=0x02,index=1,mac=A4:C1:38:0A:1B:2C value=-3.20 1700000000000000000\n"
+        "battery,id=0x15,mac=A4:C1:38:0A:1B:2C value=1 1700000000000000000\n"
+        "button,id=0x3A,mac=A4:C1:38:0A:1B:2C event=1i 1700000000000000000\n"
+        "button,id=0x3A,index=1,mac=A4:C1:38:0A:1B:2C event=0i 1700000000000000000\n";
+    TEST_ASSERT_EQUAL_STRING(expected, buf);
+    
+    bthome_packet_free(&packet);
+}
+
+// Test that control characters in names and text from the air can't start a new line
+void test_line_protocol_control_chars(void) {
+    static const char evil[] = "x\nevil,mac=00 value=1 1\n";
+    bthome_lp_tags_t tags;
+    TEST_ASSERT_EQUAL_INT(0, bthome_lp_tags_init(&tags, mac, evil, sizeof(evil) - 1));
+    
+    bthome_packet_t packet;
+    bthome_packet_init(&packet);
+    bthome_add_sensor_uint8(&packet, BTHOME_SENSOR_BATTERY, 97);
+    bthome_add_sensor_text(&packet, "a\r\nb", 4);
+    
+    char buf[256];
+    bthome_lp_batch_t batch;
+    bthome_lp_batch_init(&batch, buf, sizeof(buf));
+    TEST_ASSERT_EQUAL_INT(2, bthome_lp_append(&batch, &tags, &packet, 0));
+    
+    const char *expected =
+        "battery,id=0x01,mac=A4:C1:38:0A:1B:2C,name=x\\ evil\\,mac\\=00\\ value\\=1\\ 1\\  value=97\n"
+        "text,id=0x53,mac=A4:C1:38:0A:1B:2C,name=x\\ evil\\,mac\\=00\\ value\\=1\\ 1\\  value=\"a  b\"\n";
+    TEST_ASSERT_EQUAL_STRING(expected, buf);
+    
+    bthome_packet_free(&packet);
+}
+
+// Test that a packet that doesn't fit leaves the batch unchanged
+void test_line_protocol_full(void) {
+    bthome_lp_tags_t tags;
+    TEST_ASSERT_EQUAL_INT(0, bthome_lp_tags_init(&tags, mac, NULL, 0));
+    
+    bthome_packet_t packet;
+    bthome_packet_init(&packet);
+    bthome_add_sensor_uint16(&packet, BTHOME_SENSOR_CO2, 412);
+    
+    char buf[64];
+    bthome_lp_batch_t batch;
+    bthome_lp_batch_init(&batch, buf, sizeof(buf));
+    TEST_ASSERT_EQUAL_INT(1, bthome_lp_append(&batch, &tags, &packet, 0));
+    TEST_ASSERT_EQUAL_STRING("co2,id=0x12,mac=A4:C1:38:0A:1B:2C value=412\n", buf);
+    size_t len = batch.len;
+    
+    TEST_ASSERT_EQUAL_INT(-1, bthome_lp_append(&batch, &tags, &packet, 0));
+    TEST_ASSERT_EQUAL_size_t(len, batch.len);
+    TEST_ASSERT_EQUAL_size_t(1, batch.lines);
+    TEST_ASSERT_EQUAL_size_t(len, strlen(buf));
+    
+    bthome_packet_free(&packet);
+}
+
+TEST_CASE("BTHome serialize: JSON packet", "[bthome][serialize]") {
+    test_json_packet();
+}
+
+TEST_CASE("BTHome serialize: JSON truncation", "[bthome][serialize]") {
+    test_json_truncated();
+}
+
+TEST_CASE("BTHome serialize: line protocol", "[bthome][serialize]") {
+    test_line_protocol();
+}
+
+TEST_CASE("BTHome serialize: line protocol repeated objects", "[bthome][serialize]") {
+    test_line_protocol_instances();
+}
+
+TEST_CASE("BTHome serialize: line protocol control characters", "[bthome][serialize]") {
+    test_line_protocol_control_chars();
+}
+
+TEST_CASE("BTHome serialize: line protocol batch full", "[bthome][serialize]") {
+    test_line_protocol_full();
+}
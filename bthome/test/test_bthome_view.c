@@ -0,0 +1,141 @@
+#include <stdio.h>
+#include <string.h>
+#include "unity.h"
+#include "bthome.h"
+#include "bthome_view.h"
+
+// Test looking up values in the example payload from the BTHome documentation
+void test_view_example_payload(void) {
+    const uint8_t service_data[] = {
+        0xD2, 0xFC,        // UUID
+        0x40,              // Device info
+        0x02, 0xC4, 0x09,  // Temperature: 2500 = 25.00°C
+        0x03, 0xBF, 0x13   // Humidity: 5055 = 50.55%
+    };
+    
+    bthome_view_t view;
+    TEST_ASSERT_EQUAL_INT(0, bthome_view_init(&view, service_data, sizeof(service_data)));
+    TEST_ASSERT_EQUAL_UINT8(2, view.device_info.version);
+    TEST_ASSERT_EQUAL_UINT8(2, view.object_count);
+    TEST_ASSERT_TRUE(view.sorted);
+    
+    TEST_ASSERT_TRUE(bthome_view_has(&view, BTHOME_SENSOR_TEMPERATURE));
+    TEST_ASSERT_FALSE(bthome_view_has(&view, BTHOME_SENSOR_PRESSURE));
+    
+    bthome_measurement_t m;
+    TEST_ASSERT_EQUAL_INT(0, bthome_view_get(&view, BTHOME_SENSOR_HUMIDITY, 0, &m));
+    TEST_ASSERT_EQUAL_UINT8(BTHOME_SENSOR_HUMIDITY, m.object_id);
+    TEST_ASSERT_FALSE(m.is_signed);
+    TEST_ASSERT_EQUAL_UINT8(2, m.size);
+    TEST_ASSERT_EQUAL_UINT16(5055, m.value.uint16_val);
+    
+    TEST_ASSERT_EQUAL_INT(0, bthome_view_get(&view, BTHOME_SENSOR_TEMPERATURE, 0, &m));
+    TEST_ASSERT_TRUE(m.is_signed);
+    TEST_ASSERT_EQUAL_INT16(2500, m.value.sint16_val);
+    
+    TEST_ASSERT_EQUAL_INT(-1, bthome_view_get(&view, BTHOME_SENSOR_TEMPERATURE, 1, &m));
+    TEST_ASSERT_EQUAL_INT(-1, bthome_view_get(&view, BTHOME_SENSOR_PRESSURE, 0, &m));
+}
+
+// Test repeated objects, events and text against the full decoder
+void test_view_matches_decoder(void) {
+    bthome_packet_t packet;
+    bthome_packet_init(&packet);
+    bthome_set_device_info(&packet, false, false);
+    bthome_set_packet_id(&packet, 7);
+    bthome_add_sensor_sint16(&packet, BTHOME_SENSOR_TEMPERATURE, -1234);
+    bthome_add_sensor_sint16(&packet, BTHOME_SENSOR_TEMPERATURE, 2100);
+    bthome_add_sensor_uint24(&packet, BTHOME_SENSOR_ILLUMINANCE, 1346067);
+    bthome_add_sensor_text(&packet, "hi", 2);
+    bthome_add_button_event(&packet, BTHOME_BUTTON_LONG_PRESS);
+    bthome_add_dimmer_event(&packet, BTHOME_DIMMER_ROTATE_RIGHT, 4);
+    
+    uint8_t buffer[64];
+    int encoded_len = bthome_encode(&packet, buffer, sizeof(buffer));
+    TEST_ASSERT_GREATER_THAN(0, encoded_len);
+    
+    bthome_view_t view;
+    TEST_ASSERT_EQUAL_INT(0, bthome_view_init(&view, buffer, encoded_len));
+    TEST_ASSERT_EQUAL_UINT8(7, view.object_count);
+    
+    bthome_measurement_t m;
+    TEST_ASSERT_EQUAL_INT(0, bthome_view_get(&view, BTHOME_SENSOR_PACKET_ID, 0, &m));
+    TEST_ASSERT_EQUAL_UINT8(7, m.value.uint8_val);
+    TEST_ASSERT_EQUAL_INT(0, bthome_view_get(&view, BTHOME_SENSOR_TEMPERATURE, 0, &m));
+    TEST_ASSERT_EQUAL_INT16(-1234, m.value.sint16_val);
+    TEST_ASSERT_EQUAL_INT(0, bthome_view_get(&view, BTHOME_SENSOR_TEMPERATURE, 1, &m));
+    TEST_ASSERT_EQUAL_INT16(2100, m.value.sint16_val);
+    TEST_ASSERT_EQUAL_INT(0, bthome_view_get(&view, BTHOME_SENSOR_ILLUMINANCE, 0, &m));
+    TEST_ASSERT_EQUAL_UINT32(1346067, m.value.uint32_val);
+    TEST_ASSERT_EQUAL_INT(0, bthome_view_get(&view, BTHOME_SENSOR_TEXT, 0, &m));
+    TEST_ASSERT_EQUAL_size_t(2, m.value.bytes_val.len);
+    TEST_ASSERT_EQUAL_MEMORY("hi", m.value.bytes_val.data, 2);
+    TEST_ASSERT_TRUE(m.value.bytes_val.data >= buffer && m.value.bytes_val.data < buffer + encoded_len);
+    
+    bthome_event_t e;
+    TEST_ASSERT_EQUAL_INT(-2, bthome_view_get(&view, BTHOME_EVENT_BUTTON, 0, &m));
+    TEST_ASSERT_EQUAL_INT(0, bthome_view_get_event(&view, BTHOME_EVENT_BUTTON, 0, &e));
+    TEST_ASSERT_EQUAL_UINT8(BTHOME_BUTTON_LONG_PRESS, e.event_value);
+    TEST_ASSERT_EQUAL_INT(0, bthome_view_get_event(&view, BTHOME_EVENT_DIMMER, 0, &e));
+    TEST_ASSERT_EQUAL_UINT8(BTHOME_DIMMER_ROTATE_RIGHT, e.event_value);
+    TEST_ASSERT_EQUAL_UINT8(4, e.steps);
+    
+    bthome_packet_free(&packet);
+}
+
+// Test objects that are not in ascending order
+void test_view_unsorted(void) {
+    const uint8_t service_data[] = {
+        0xD2, 0xFC, 0x40,
+        0x03, 0xBF, 0x13,  // Humidity
+        0x02, 0xC4, 0x09,  // Temperature
+        0x03, 0x10, 0x27   // Humidity again: 10000
+    };
+    
+    bthome_view_t view;
+    TEST_ASSERT_EQUAL_INT(0, bthome_view_init(&view, service_data, sizeof(service_data)));
+    TEST_ASSERT_FALSE(view.sorted);
+    
+    bthome_measurement_t m;
+    TEST_ASSERT_EQUAL_INT(0, bthome_view_get(&view, BTHOME_SENSOR_TEMPERATURE, 0, &m));
+    TEST_ASSERT_EQUAL_INT16(2500, m.value.sint16_val);
+    TEST_ASSERT_EQUAL_INT(0, bthome_view_get(&view, BTHOME_SENSOR_HUMIDITY, 1, &m));
+    TEST_ASSERT_EQUAL_UINT16(10000, m.value.uint16_val);
+}
+
+// Test validation errors
+void test_view_invalid(void) {
+    bthome_view_t view;
+    
+    const uint8_t bad_uuid[] = { 0xFF, 0xFF, 0x40, 0x02, 0xC4, 0x09 };
+    TEST_ASSERT_EQUAL_INT(-2, bthome_view_init(&view, bad_uuid, sizeof(bad_uuid)));
+    
+    const uint8_t encrypted[] = { 0xD2, 0xFC, 0x41, 0x02, 0xC4, 0x09 };
+    TEST_ASSERT_EQUAL_INT(-3, bthome_view_init(&view, encrypted, sizeof(encrypted)));
+    
+    const uint8_t truncated[] = { 0xD2, 0xFC, 0x40, 0x02, 0xC4 };
+    TEST_ASSERT_EQUAL_INT(-4, bthome_view_init(&view, truncated, sizeof(truncated)));
+    
+    uint8_t too_many[3 + 2 * (BTHOME_VIEW_MAX_OBJECTS + 1)] = { 0xD2, 0xFC, 0x40 };
+    for (size_t i = 3; i < sizeof(too_many); i += 2) {
+        too_many[i] = BTHOME_SENSOR_BATTERY;
+        too_many[i + 1] = 50;
+    }
+    TEST_ASSERT_EQUAL_INT(-6, bthome_view_init(&view, too_many, sizeof(too_many)));
+}
+
+TEST_CASE("BTHome view: example payload", "[bthome][view]") {
+    test_view_example_payload();
+}
+
+TEST_CASE("BTHome view: matches decoder", "[bthome][view]") {
+    test_view_matches_decoder();
+}
+
+TEST_CASE("BTHome view: unsorted objects", "[bthome][view]") {
+    test_view_unsorted();
+}
+
+TEST_CASE("BTHome view: invalid data", "[bthome][view]") {
+    test_view_invalid();
+}
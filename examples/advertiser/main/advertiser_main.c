@@ -0,0 +1,101 @@
+#include <stdio.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_random.h"
+#include "nvs_flash.h"
+#include "bthome.h"
+#include "bthome_ble.h"
+
+static const char *TAG = "bthome_advertiser";
+
+// Stand-in for a real sensor driver: wanders around 21°C / 45%
+static void read_sensor(int16_t *temperature, uint16_t *humidity) {
+    static int16_t t = 2100;
+    static uint16_t h = 4500;
+    t += (int16_t)(esp_random() % 21) - 10;
+    h += (int16_t)(esp_random() % 21) - 10;
+    *temperature = t;
+    *humidity = h;
+}
+
+// Build the packet to broadcast from the latest readings
+static void build_packet(bthome_packet_t *packet, int16_t temperature, uint16_t humidity) {
+    bthome_packet_init(packet);
+    bthome_set_device_info(packet, false, false);
+    bthome_set_device_name(packet, "DIY-sensor", 10, true);
+    bthome_add_sensor_uint8(packet, BTHOME_SENSOR_BATTERY, 100);
+    bthome_add_sensor_sint16(packet, BTHOME_SENSOR_TEMPERATURE, temperature);
+    bthome_add_sensor_uint16(packet, BTHOME_SENSOR_HUMIDITY, humidity);
+}
+
+// Format a reading from the packet as it is broadcast, e.g. "21.50"
+static void format_reading(const bthome_packet_t *packet, uint8_t object_id, char *buf, size_t cap) {
+    snprintf(buf, cap, "?");
+    for (size_t i = 0; i < packet->measurement_count; i++) {
+        if (packet->measurements[i].object_id == object_id) {
+            bthome_format_value(&packet->measurements[i], buf, cap);
+            break;
+        }
+    }
+}
+
+void app_main(void) {
+    // Initialize NVS (required for BLE)
+    esp_err_t ret = nvs_flash_init();
+    if (ret == ESP_ERR_NVS_NO_FREE_PAGES || ret == ESP_ERR_NVS_NEW_VERSION_FOUND) {
+        ESP_ERROR_CHECK(nvs_flash_erase());
+        ret = nvs_flash_init();
+    }
+    ESP_ERROR_CHECK(ret);
+    
+    ESP_LOGI(TAG, "Starting BTHome BLE Advertiser");
+    
+    // Initialize the BLE advertiser
+    ret = bthome_ble_advertiser_init();
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to initialize BLE advertiser: %s", esp_err_to_name(ret));
+        return;
+    }
+    
+    // Configure advertiser: broadcast every ~1s, new packet ID on every update
+    bthome_ble_advertiser_config_t config;
+    bthome_ble_advertiser_get_default_config(&config);
+    config.adv_interval_min = 0x640;  // 1s
+    config.adv_interval_max = 0x680;  // 1.04s
+    
+    int16_t temperature;
+    uint16_t humidity;
+    bthome_packet_t packet;
+    
+    read_sensor(&temperature, &humidity);
+    build_packet(&packet, temperature, humidity);
+    ret = bthome_ble_advertiser_start(&config, &packet);
+    bthome_packet_free(&packet);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to start BLE advertiser: %s", esp_err_to_name(ret));
+        bthome_ble_advertiser_deinit();
+        return;
+    }
+    
+    // Refresh the readings every 10 seconds; advertising keeps running in between
+    while (1) {
+        vTaskDelay(pdMS_TO_TICKS(10000));
+        
+        read_sensor(&temperature, &humidity);
+        build_packet(&packet, temperature, humidity);
+        ret = bthome_ble_advertiser_update(&packet);
+        if (ret != ESP_OK) {
+            ESP_LOGW(TAG, "Failed to update advertisement: %s", esp_err_to_name(ret));
+            bthome_packet_free(&packet);
+            continue;
+        }
+        
+        char temperature_str[BTHOME_VALUE_STR_LEN];
+        char humidity_str[BTHOME_VALUE_STR_LEN];
+        format_reading(&packet, BTHOME_SENSOR_TEMPERATURE, temperature_str, sizeof(temperature_str));
+        format_reading(&packet, BTHOME_SENSOR_HUMIDITY, humidity_str, sizeof(humidity_str));
+        bthome_packet_free(&packet);
+        ESP_LOGI(TAG, "Broadcasting temperature %s °C, humidity %s %%", temperature_str, humidity_str);
+    }
+}
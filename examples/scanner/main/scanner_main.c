@@ -21,14 +21,7 @@ static void bthome_packet_callback(esp_bd_addr_t addr, int rssi,
     
     // Print device name if present
     if (packet->device_name != NULL && packet->device_name_len > 0) {
-        // Create a temporary buffer to null-terminate the name for printing
-        char name_buffer[256];
-        size_t copy_len = packet->device_name_len < sizeof(name_buffer) - 1 ? 
-                         packet->device_name_len : sizeof(name_buffer) - 1;
-        memcpy(name_buffer, packet->device_name, copy_len);
-        name_buffer[copy_len] = '\0';
-        
-        ESP_LOGI(TAG, "  Device Name: \"%s\" (%s)", name_buffer, 
+        ESP_LOGI(TAG, "  Device Name: \"%.*s\" (%s)", (int)packet->device_name_len, packet->device_name,
                  packet->use_complete_name ? "Complete" : "Shortened");
     }
     
@@ -44,33 +37,33 @@ static void bthome_packet_callback(esp_bd_addr_t addr, int rssi,
     // Print all measurements
     for (size_t i = 0; i < packet->measurement_count; i++) {
         const bthome_measurement_t *m = &packet->measurements[i];
-        float factor = bthome_get_scaling_factor(m->object_id);
-        float value = bthome_get_scaled_value(m, factor);
+        char value[BTHOME_VALUE_STR_LEN];
+        bthome_format_value(m, value, sizeof(value));
         
-        ESP_LOGI(TAG, "  Measurement 0x%02X: %.2f", m->object_id, value);
+        ESP_LOGI(TAG, "  Measurement 0x%02X: %s", m->object_id, value);
         
         // Specific sensor type examples
         switch (m->object_id) {
             case BTHOME_SENSOR_TEMPERATURE:
-                ESP_LOGI(TAG, "    Temperature: %.2f °C", value);
+                ESP_LOGI(TAG, "    Temperature: %s °C", value);
                 break;
             case BTHOME_SENSOR_HUMIDITY:
-                ESP_LOGI(TAG, "    Humidity: %.2f %%", value);
+                ESP_LOGI(TAG, "    Humidity: %s %%", value);
                 break;
             case BTHOME_SENSOR_BATTERY:
-                ESP_LOGI(TAG, "    Battery: %d %%", (int)value);
+                ESP_LOGI(TAG, "    Battery: %s %%", value);
                 break;
             case BTHOME_SENSOR_PRESSURE:
-                ESP_LOGI(TAG, "    Pressure: %.2f hPa", value);
+                ESP_LOGI(TAG, "    Pressure: %s hPa", value);
                 break;
             case BTHOME_SENSOR_ILLUMINANCE:
-                ESP_LOGI(TAG, "    Illuminance: %.2f lux", value);
+                ESP_LOGI(TAG, "    Illuminance: %s lux", value);
                 break;
             case BTHOME_SENSOR_DISTANCE_MM:
-                ESP_LOGI(TAG, "    Distance: %.2f mm", value);
+                ESP_LOGI(TAG, "    Distance: %s mm", value);
                 break;
             case BTHOME_BINARY_VIBRATION:
-                ESP_LOGI(TAG, "    Vibration: %s", value ? "Detected" : "Not Detected");
+                ESP_LOGI(TAG, "    Vibration: %s", m->value.uint8_val ? "Detected" : "Not Detected");
                 break;
             default:
                 break;
@@ -0,0 +1,177 @@
+/*
+ * Coroutine consumer of a mock radio, for trying bthome_async.hpp on the host
+ *
+ * Each radio thread plays a share of the virtual devices, each advertising on its
+ * own interval in real time, and feeds every report through its own scanner core
+ * into one bthome::PacketStream. A single coroutine consumes the stream. Each report
+ * carries the time it was sent (as a count object), so the consumer can measure
+ * how long packets take to reach it. With several radios, packets from one radio
+ * are buffered while the consumer runs on another, and dropped when the stream is full.
+ */
+#include <getopt.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+#include "bthome.h"
+#include "bthome.hpp"
+#include "bthome_async.hpp"
+#include "bthome_histogram.h"
+#include "bthome_scanner_core.h"
+
+// Packets the stream buffers while the consumer is busy
+#define STREAM_CAPACITY 16
+
+using Stream = bthome::PacketStream<STREAM_CAPACITY>;
+using Advert = bthome::Packet<bthome::PacketId, bthome::Temperature, bthome::CountUint32>;
+
+struct Config {
+    unsigned devices = 50;
+    unsigned radios = 1;
+    unsigned duration_s = 5;
+    unsigned interval_ms = 100;    // Each device's advertising interval
+    unsigned app_us = 0;           // Consumer time per packet
+    double encrypted_fraction = 0.1;
+};
+
+struct Stats {
+    uint64_t delivered = 0;
+    bthome_histogram_t latency_us; // Report sent to consumer
+};
+
+static uint32_t now_us() {
+    using namespace std::chrono;
+    return static_cast<uint32_t>(duration_cast<microseconds>(steady_clock::now().time_since_epoch()).count());
+}
+
+// Radio thread: devices first, first + radios, ... advertising until stopped
+static void run_radio(const Config &config, unsigned first, Stream &stream, const std::atomic<bool> &stop,
+                      std::atomic<uint64_t> &rejected) {
+    bthome_scanner_core_t core;
+    bthome_scanner_core_init(&core);
+    // Spread the devices' first adverts over one interval
+    std::vector<uint32_t> next_us;
+    uint32_t start = now_us();
+    for (unsigned d = first; d < config.devices; d += config.radios) {
+        next_us.push_back(start + d * config.interval_ms * 1000 / config.devices);
+    }
+
+    uint8_t packet_id = 0;
+    while (!stop) {
+        uint32_t now = now_us();
+        for (size_t i = 0; i < next_us.size(); i++) {
+            if (static_cast<int32_t>(now - next_us[i]) < 0) {
+                continue;
+            }
+            next_us[i] += config.interval_ms * 1000;
+
+            unsigned device = first + static_cast<unsigned>(i) * config.radios;
+            uint8_t addr[6] = { 0xA4, 0xC1, 0x38, 0x00, static_cast<uint8_t>(device >> 8),
+                                static_cast<uint8_t>(device) };
+            Advert advert(bthome::PacketId(packet_id++), bthome::Temperature(static_cast<int16_t>(2000 + device)),
+                          bthome::CountUint32(now_us()));
+            Advert::buffer_type adv;
+            size_t len = advert.encode(adv);
+            if (device < config.devices * config.encrypted_fraction) {
+                adv[7] |= BTHOME_DEVICE_INFO_ENCRYPTED;  // Filtered out by the scanner core
+            }
+            if (!stream.push_report(core, addr, -60, adv.data(), len, now / 1000)) {
+                rejected++;
+            }
+        }
+        std::this_thread::sleep_for(std::chrono::microseconds(200));
+    }
+}
+
+static bthome::Task consume(Stream &stream, const Config &config, Stats &stats) {
+    while (std::optional<bthome::ScanResult> result = co_await stream.next()) {
+        for (const bthome_measurement_t &m : result->packet.measurements()) {
+            if (m.object_id == BTHOME_SENSOR_COUNT_UINT32) {
+                bthome_histogram_record(&stats.latency_us, now_us() - m.value.uint32_val);
+            }
+        }
+        stats.delivered++;
+        if (config.app_us > 0) {
+            std::this_thread::sleep_for(std::chrono::microseconds(config.app_us));
+        }
+    }
+}
+
+static void usage(const char *argv0) {
+    fprintf(stderr,
+            "Usage: %s [options]\n"
+            "  --devices N              Virtual devices (default 50)\n"
+            "  --radios N               Radio threads sharing the devices (default 1)\n"
+            "  --duration S             Seconds to run (default 5)\n"
+            "  --interval MS            Advertising interval of each device (default 100)\n"
+            "  --app-us US              Consumer time per packet (default 0)\n"
+            "  --encrypted F            Fraction of encrypted devices (default 0.1)\n",
+            argv0);
+}
+
+int main(int argc, char **argv) {
+    Config config;
+    static const struct option options[] = {
+        { "devices", required_argument, NULL, 'd' },
+        { "radios", required_argument, NULL, 'r' },
+        { "duration", required_argument, NULL, 't' },
+        { "interval", required_argument, NULL, 'i' },
+        { "app-us", required_argument, NULL, 'a' },
+        { "encrypted", required_argument, NULL, 'e' },
+        { "help", no_argument, NULL, 'h' },
+        { NULL, 0, NULL, 0 },
+    };
+
+    int opt;
+    bool ok = true;
+    while (ok && (opt = getopt_long(argc, argv, "h", options, NULL)) != -1) {
+        switch (opt) {
+            case 'd': config.devices = strtoul(optarg, NULL, 10); break;
+            case 'r': config.radios = std::max(1UL, strtoul(optarg, NULL, 10)); break;
+            case 't': config.duration_s = strtoul(optarg, NULL, 10); break;
+            case 'i': config.interval_ms = std::max(1UL, strtoul(optarg, NULL, 10)); break;
+            case 'a': config.app_us = strtoul(optarg, NULL, 10); break;
+            case 'e': config.encrypted_fraction = strtod(optarg, NULL); break;
+            default: ok = false; break;
+        }
+    }
+    if (!ok || optind != argc) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    Stream stream;
+    Stats stats;
+    bthome_histogram_reset(&stats.latency_us);
+    bthome::Task task = consume(stream, config, stats);
+
+    std::atomic<bool> stop(false);
+    std::atomic<uint64_t> rejected(0);
+    std::vector<std::thread> radios;
+    for (unsigned r = 0; r < config.radios; r++) {
+        radios.emplace_back(run_radio, std::cref(config), r, std::ref(stream), std::cref(stop), std::ref(rejected));
+    }
+    std::this_thread::sleep_for(std::chrono::seconds(config.duration_s));
+    stop = true;
+    for (std::thread &radio : radios) {
+        radio.join();
+    }
+
+    // Packets still buffered are delivered before the consumer sees the end
+    stream.close();
+    if (!task.done()) {
+        fprintf(stderr, "consumer didn't finish\n");
+        return 1;
+    }
+
+    printf("delivered %llu (%.0f/s), dropped %zu, filtered or undecodable %llu\n",
+           static_cast<unsigned long long>(stats.delivered),
+           static_cast<double>(stats.delivered) / std::max(1U, config.duration_s), stream.dropped(),
+           static_cast<unsigned long long>(rejected.load() - stream.dropped()));
+    printf("latency p50 %u us, p99 %u us\n", static_cast<unsigned>(bthome_histogram_percentile(&stats.latency_us, 50)),
+           static_cast<unsigned>(bthome_histogram_percentile(&stats.latency_us, 99)));
+    return 0;
+}
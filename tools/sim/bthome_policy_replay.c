@@ -0,0 +1,291 @@
+/*
+ * Replays recorded sensor traces through the advertising policy
+ *
+ * Each trace line is "time_ms object value": the object is an object ID (decimal or
+ * 0x hex) or its name from bthome_get_object_name(), and the value is in scaled units
+ * (e.g. 21.37 for temperature). Lines with the same time form one sample, and every
+ * sample carries the last value of each object seen so far, as a sensor's packet
+ * would. Reports how many samples the policy advertises compared with sending every
+ * sample, and how far the last advertised values drift from the trace meanwhile.
+ */
+#include <getopt.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bthome.h"
+#include "bthome_policy.h"
+
+// Objects tracked per trace, in order of first appearance
+#define MAX_OBJECTS BTHOME_POLICY_MAX_VALUES
+
+typedef struct {
+    uint8_t object_id;
+    double value;                  // Current value in the trace
+    double sent;                   // Value last advertised
+    double max_error;              // Largest |value - sent| over all samples
+} trace_object_t;
+
+typedef struct {
+    trace_object_t objects[MAX_OBJECTS];
+    size_t object_count;
+    uint8_t events[MAX_OBJECTS];   // Events in the current sample (object ID, value)
+    uint8_t event_values[MAX_OBJECTS];
+    size_t event_count;
+    uint32_t samples;
+    uint32_t sent;
+    uint32_t reasons[BTHOME_POLICY_HEARTBEAT + 1];
+    uint32_t first_ms;
+    uint32_t last_ms;
+    uint32_t last_sent_ms;
+    uint32_t max_silence_ms;
+} replay_t;
+
+static const char *reason_names[] = {
+    [BTHOME_POLICY_SKIP] = "skip",
+    [BTHOME_POLICY_FIRST] = "first",
+    [BTHOME_POLICY_EVENT] = "event",
+    [BTHOME_POLICY_BINARY] = "binary",
+    [BTHOME_POLICY_CHANGE] = "change",
+    [BTHOME_POLICY_HEARTBEAT] = "heartbeat",
+};
+
+static bool parse_object(const char *arg, uint8_t *object_id) {
+    char *end;
+    unsigned long id = strtoul(arg, &end, 0);
+    if (end != arg && *end == '\0' && id <= UINT8_MAX) {
+        *object_id = id;
+        return true;
+    }
+    for (unsigned i = 0; i <= UINT8_MAX; i++) {
+        const char *name = bthome_get_object_name(i);
+        if (name != NULL && strcmp(name, arg) == 0) {
+            *object_id = i;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Add a measurement in scaled units with the object's size and signedness
+static int add_scaled(bthome_packet_t *packet, uint8_t object_id, double value) {
+    double raw = round(value / bthome_get_scaling_factor(object_id));
+    if (bthome_is_signed(object_id)) {
+        switch (bthome_get_object_size(object_id)) {
+            case 1: return bthome_add_sensor_sint8(packet, object_id, (int8_t)raw);
+            case 2: return bthome_add_sensor_sint16(packet, object_id, (int16_t)raw);
+            case 4: return bthome_add_sensor_sint32(packet, object_id, (int32_t)raw);
+        }
+    } else {
+        switch (bthome_get_object_size(object_id)) {
+            case 1: return bthome_add_sensor_uint8(packet, object_id, (uint8_t)raw);
+            case 2: return bthome_add_sensor_uint16(packet, object_id, (uint16_t)raw);
+            case 3: return bthome_add_sensor_uint24(packet, object_id, (uint32_t)raw);
+            case 4: return bthome_add_sensor_uint32(packet, object_id, (uint32_t)raw);
+        }
+    }
+    return -1;  // Variable-length objects can't be replayed
+}
+
+// Run the current sample through the policy
+static bool flush_sample(replay_t *replay, bthome_policy_t *policy, uint32_t now_ms) {
+    bthome_packet_t packet;
+    bthome_packet_init(&packet);
+    bool ok = true;
+    for (size_t i = 0; i < replay->object_count && ok; i++) {
+        ok = add_scaled(&packet, replay->objects[i].object_id, replay->objects[i].value) == 0;
+    }
+    for (size_t i = 0; i < replay->event_count && ok; i++) {
+        if (replay->events[i] == BTHOME_EVENT_BUTTON) {
+            ok = bthome_add_button_event(&packet, replay->event_values[i]) == 0;
+        } else {
+            ok = bthome_add_dimmer_event(&packet, replay->event_values[i], 1) == 0;
+        }
+    }
+    if (!ok) {
+        bthome_packet_free(&packet);
+        return false;
+    }
+
+    bthome_policy_reason_t reason = bthome_policy_sample(policy, &packet, now_ms);
+    bthome_packet_free(&packet);
+
+    if (replay->samples == 0) {
+        replay->first_ms = now_ms;
+    }
+    replay->samples++;
+    replay->reasons[reason]++;
+    if (reason != BTHOME_POLICY_SKIP) {
+        if (replay->sent > 0 && now_ms - replay->last_sent_ms > replay->max_silence_ms) {
+            replay->max_silence_ms = now_ms - replay->last_sent_ms;
+        }
+        replay->sent++;
+        replay->last_sent_ms = now_ms;
+    }
+    for (size_t i = 0; i < replay->object_count; i++) {
+        trace_object_t *object = &replay->objects[i];
+        if (reason != BTHOME_POLICY_SKIP) {
+            object->sent = object->value;
+        }
+        double error = fabs(object->value - object->sent);
+        if (error > object->max_error) {
+            object->max_error = error;
+        }
+    }
+    replay->event_count = 0;
+    replay->last_ms = now_ms;
+    return true;
+}
+
+static bool replay_trace(FILE *in, replay_t *replay, bthome_policy_t *policy) {
+    char line[256];
+    unsigned line_number = 0;
+    bool pending = false;
+    uint32_t sample_ms = 0;
+
+    while (fgets(line, sizeof(line), in) != NULL) {
+        line_number++;
+        char object_arg[64];
+        unsigned long time_ms;
+        double value;
+        uint8_t object_id;
+        if (line[0] == '#' || strspn(line, " \t\r\n") == strlen(line)) {
+            continue;
+        }
+        if (sscanf(line, "%lu %63s %lf", &time_ms, object_arg, &value) != 3 ||
+            !parse_object(object_arg, &object_id)) {
+            fprintf(stderr, "line %u: expected \"time_ms object value\"\n", line_number);
+            return false;
+        }
+        if (pending && time_ms < sample_ms) {
+            fprintf(stderr, "line %u: time goes backwards\n", line_number);
+            return false;
+        }
+
+        if (pending && time_ms != sample_ms) {
+            if (!flush_sample(replay, policy, sample_ms)) {
+                fprintf(stderr, "line %u: sample can't be encoded\n", line_number);
+                return false;
+            }
+        }
+        pending = true;
+        sample_ms = time_ms;
+
+        if (bthome_is_event(object_id)) {
+            if (replay->event_count < MAX_OBJECTS) {
+                replay->events[replay->event_count] = object_id;
+                replay->event_values[replay->event_count++] = (uint8_t)value;
+            }
+            continue;
+        }
+
+        size_t i = 0;
+        while (i < replay->object_count && replay->objects[i].object_id != object_id) {
+            i++;
+        }
+        if (i == replay->object_count) {
+            if (i == MAX_OBJECTS) {
+                fprintf(stderr, "line %u: more than %d objects\n", line_number, MAX_OBJECTS);
+                return false;
+            }
+            replay->objects[i].object_id = object_id;
+            replay->objects[i].sent = value;
+            replay->object_count++;
+        }
+        replay->objects[i].value = value;
+    }
+
+    if (pending && !flush_sample(replay, policy, sample_ms)) {
+        fprintf(stderr, "last sample can't be encoded\n");
+        return false;
+    }
+    return true;
+}
+
+static void report(const char *name, const replay_t *replay) {
+    double hours = (replay->last_ms - replay->first_ms) / 3600000.0;
+    double reduction = replay->samples > 0 ? 100.0 * (1.0 - (double)replay->sent / replay->samples) : 0;
+    printf("%s: %.1f h, %u samples, %u adverts (%.1f%% fewer), longest silence %.0f s\n",
+           name, hours, replay->samples, replay->sent, reduction, replay->max_silence_ms / 1000.0);
+    printf("  sent for:");
+    for (int r = BTHOME_POLICY_FIRST; r <= BTHOME_POLICY_HEARTBEAT; r++) {
+        printf(" %s %u", reason_names[r], replay->reasons[r]);
+    }
+    printf("\n");
+    for (size_t i = 0; i < replay->object_count; i++) {
+        const trace_object_t *object = &replay->objects[i];
+        const char *object_name = bthome_get_object_name(object->object_id);
+        const char *unit = bthome_get_object_unit(object->object_id);
+        printf("  %-16s max error %g%s%s\n", object_name ? object_name : "?", object->max_error,
+               unit && *unit ? " " : "", unit ? unit : "");
+    }
+}
+
+static void usage(const char *argv0) {
+    fprintf(stderr,
+            "Usage: %s [options] TRACE...\n"
+            "  --heartbeat S            Longest silence in seconds, 0 for none (default 600)\n"
+            "  --deadband OBJ=ABS[,REL] Deadband of an object ID or name, e.g. temperature=0.2\n"
+            "                           or humidity=0.5,0.05 (default: send every change)\n"
+            "TRACE is a file of \"time_ms object value\" lines, or - for stdin.\n",
+            argv0);
+}
+
+int main(int argc, char **argv) {
+    bthome_policy_t policy;
+    bthome_policy_init(&policy, 600000);
+
+    static const struct option options[] = {
+        { "heartbeat", required_argument, NULL, 'H' },
+        { "deadband", required_argument, NULL, 'd' },
+        { "help", no_argument, NULL, 'h' },
+        { NULL, 0, NULL, 0 },
+    };
+
+    int opt;
+    bool ok = true;
+    while (ok && (opt = getopt_long(argc, argv, "h", options, NULL)) != -1) {
+        switch (opt) {
+            case 'H': policy.heartbeat_ms = strtoul(optarg, NULL, 10) * 1000; break;
+            case 'd': {
+                char object_arg[64];
+                float absolute, relative = 0;
+                uint8_t object_id;
+                int fields = sscanf(optarg, "%63[^=]=%f,%f", object_arg, &absolute, &relative);
+                ok = fields >= 2 && parse_object(object_arg, &object_id) &&
+                     bthome_policy_set_deadband(&policy, object_id, absolute, relative) == 0;
+                break;
+            }
+            default: ok = false; break;
+        }
+    }
+    if (!ok || optind == argc) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    // Each trace is a separate sensor with the same policy
+    bthome_policy_t configured = policy;
+    for (int i = optind; i < argc; i++) {
+        FILE *in = strcmp(argv[i], "-") == 0 ? stdin : fopen(argv[i], "r");
+        if (in == NULL) {
+            perror(argv[i]);
+            return 1;
+        }
+        replay_t replay;
+        memset(&replay, 0, sizeof(replay));
+        policy = configured;
+        ok = replay_trace(in, &replay, &policy);
+        if (in != stdin) {
+            fclose(in);
+        }
+        if (!ok) {
+            fprintf(stderr, "%s: replay failed\n", argv[i]);
+            return 1;
+        }
+        report(argv[i], &replay);
+    }
+    return 0;
+}
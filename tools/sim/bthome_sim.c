@@ -0,0 +1,657 @@
+/*
+ * Discrete-event simulator of a crowded BTHome deployment
+ *
+ * Models N virtual devices advertising on the three primary channels, the collisions
+ * between them and the scan windows of a single scanner, then feeds every report the
+ * scanner would hear through the scanner core (filter, decode, device cache) and a
+ * model of the scanner's delivery queue. Reports sustained adverts/s, drop rates and
+ * latency percentiles for each device count.
+ */
+#include <getopt.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "bthome.h"
+#include "bthome_scanner_core.h"
+#include "bthome_histogram.h"
+
+// Gap between the transmissions on consecutive channels of one advertising event
+#define CHANNEL_HOP_US 150
+
+// Bytes on air besides the advertising data: preamble, access address, header, AdvA, CRC
+#define AIR_OVERHEAD_BYTES (1 + 4 + 2 + 6 + 3)
+
+// Time to send one byte on the 1M PHY
+#define US_PER_BYTE 8
+
+#define MAX_DEVICE_COUNTS 16
+
+typedef struct {
+    uint32_t device_counts[MAX_DEVICE_COUNTS];
+    size_t device_count_len;
+    uint32_t duration_s;
+    uint32_t interval_min_ms;      // Advertising intervals are spread uniformly over this range
+    uint32_t interval_max_ms;
+    uint32_t jitter_ms;            // advDelay: random delay added to every advertising event
+    uint32_t max_objects;          // Each device sends 1..max_objects measurements
+    double encrypted_fraction;
+    double trigger_fraction;       // Devices that also send button bursts
+    uint32_t burst_every_s;        // Mean time between a trigger device's bursts
+    uint32_t burst_count;          // Advertisements per burst
+    uint32_t burst_interval_ms;
+    uint32_t scan_interval_ms;
+    uint32_t scan_window_ms;
+    uint32_t controller_reports;   // Reports the controller buffers ahead of the GAP handler
+    uint32_t gap_us;               // GAP handler time per report (filter, decode, record)
+    uint32_t queue_length;         // Scanner delivery queue
+    uint32_t app_us;               // Application time per delivered packet
+    uint32_t seed;
+} sim_config_t;
+
+typedef struct {
+    uint8_t addr[6];
+    uint32_t interval_us;
+    bool encrypted;
+    bool trigger_based;
+    uint8_t objects;
+    uint8_t object_ids[4];
+    char name[16];
+    uint8_t packet_id;
+    uint64_t next_event_us;        // Next advertising event
+    uint64_t next_burst_us;        // Next burst start (trigger devices)
+    uint32_t burst_left;           // Burst advertisements still to send
+    uint32_t burst;                // Bursts started so far
+    uint64_t burst_start_us;
+    uint32_t heard_burst;          // Last burst delivered to the application
+} sim_device_t;
+
+// A transmission on one channel
+typedef struct {
+    uint64_t start_us;
+    uint64_t end_us;
+    uint32_t device;
+    uint64_t event_us;             // Start of its advertising event
+    uint8_t packet_id;
+    bool is_burst;
+    uint32_t burst;
+    bool collided;
+} sim_tx_t;
+
+// A report the controller hands to the host
+typedef struct {
+    uint64_t time_us;
+    uint32_t device;
+    uint64_t event_us;
+    uint8_t packet_id;
+    bool is_burst;
+    uint32_t burst;
+} sim_report_t;
+
+typedef struct {
+    uint64_t events;               // Advertising events sent
+    uint64_t transmissions;        // Per-channel transmissions
+    uint64_t collided;             // Transmissions lost to overlap
+    uint64_t outside_window;       // Transmissions the scanner wasn't listening for
+    uint64_t heard;                // Reports handed to the host
+    uint64_t controller_dropped;   // Reports dropped because the GAP handler fell behind
+    uint64_t rejected;             // Filtered out or failed to decode (e.g. encrypted)
+    uint64_t queue_dropped;        // Packets dropped because the delivery queue was full
+    uint64_t delivered;
+    uint64_t bursts;
+    uint64_t bursts_heard;
+    double core_seconds;           // Host CPU time spent in the scanner core
+    bthome_histogram_t core_us;    // Host time per report in the scanner core
+} sim_stats_t;
+
+static uint32_t rng_state;
+
+static uint32_t rng_next(void) {
+    // xorshift32
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 17;
+    rng_state ^= rng_state << 5;
+    return rng_state;
+}
+
+static uint32_t rng_range(uint32_t lo, uint32_t hi) {
+    return hi <= lo ? lo : lo + rng_next() % (hi - lo + 1);
+}
+
+static double rng_unit(void) {
+    return (rng_next() >> 8) / (double)(1 << 24);
+}
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static const uint8_t object_menu[] = {
+    BTHOME_SENSOR_TEMPERATURE, BTHOME_SENSOR_HUMIDITY, BTHOME_SENSOR_BATTERY,
+    BTHOME_SENSOR_PRESSURE, BTHOME_SENSOR_ILLUMINANCE, BTHOME_SENSOR_VOLTAGE,
+};
+
+static void init_device(sim_device_t *device, uint32_t index, const sim_config_t *config) {
+    memset(device, 0, sizeof(sim_device_t));
+    device->addr[0] = 0xA4;
+    device->addr[1] = 0xC1;
+    device->addr[2] = 0x38;
+    device->addr[3] = index >> 16;
+    device->addr[4] = index >> 8;
+    device->addr[5] = index;
+    device->interval_us = rng_range(config->interval_min_ms, config->interval_max_ms) * 1000;
+    device->encrypted = rng_unit() < config->encrypted_fraction;
+    device->trigger_based = rng_unit() < config->trigger_fraction;
+    device->objects = rng_range(1, config->max_objects);
+    for (size_t i = 0; i < device->objects; i++) {
+        device->object_ids[i] = object_menu[(index + i) % sizeof(object_menu)];
+    }
+    snprintf(device->name, sizeof(device->name), "sim%05u", (unsigned)index);
+    device->packet_id = rng_next();
+    device->next_event_us = rng_range(0, device->interval_us);
+    if (device->trigger_based) {
+        device->next_burst_us = rng_range(0, config->burst_every_s * 2) * 1000000ULL;
+    }
+}
+
+// Encode what a device sends for a given packet ID
+static int encode_device(const sim_device_t *device, uint8_t packet_id, bool is_burst,
+                         uint8_t *out, size_t max) {
+    bthome_packet_t packet;
+    bthome_packet_init(&packet);
+    bthome_set_device_info(&packet, device->encrypted, device->trigger_based);
+    bthome_set_packet_id(&packet, packet_id);
+    for (size_t i = 0; i < device->objects; i++) {
+        switch (device->object_ids[i]) {
+            case BTHOME_SENSOR_TEMPERATURE:
+                bthome_add_sensor_sint16(&packet, BTHOME_SENSOR_TEMPERATURE, 2000 + packet_id);
+                break;
+            case BTHOME_SENSOR_HUMIDITY:
+                bthome_add_sensor_uint16(&packet, BTHOME_SENSOR_HUMIDITY, 5000 + packet_id);
+                break;
+            case BTHOME_SENSOR_BATTERY:
+                bthome_add_sensor_uint8(&packet, BTHOME_SENSOR_BATTERY, 90);
+                break;
+            case BTHOME_SENSOR_PRESSURE:
+                bthome_add_sensor_uint24(&packet, BTHOME_SENSOR_PRESSURE, 101325);
+                break;
+            case BTHOME_SENSOR_ILLUMINANCE:
+                bthome_add_sensor_uint24(&packet, BTHOME_SENSOR_ILLUMINANCE, 12345 + packet_id);
+                break;
+            default:
+                bthome_add_sensor_uint16(&packet, device->object_ids[i], 3000);
+                break;
+        }
+    }
+    if (is_burst) {
+        bthome_add_button_event(&packet, BTHOME_BUTTON_PRESS);
+    }
+    bthome_set_device_name(&packet, device->name, strlen(device->name), true);
+
+    int len = bthome_encode_advertisement(&packet, out, max, true);
+    if (len < 0) {
+        // Leave the name to the scan response, as real devices with many objects do
+        bthome_set_device_name(&packet, NULL, 0, true);
+        len = bthome_encode_advertisement(&packet, out, max, true);
+    }
+    bthome_packet_free(&packet);
+    return len;
+}
+
+// Min-heap of device indexes ordered by their next advertising event
+typedef struct {
+    uint32_t *items;
+    size_t len;
+    const sim_device_t *devices;
+} device_heap_t;
+
+static uint64_t heap_key(const device_heap_t *heap, size_t i) {
+    return heap->devices[heap->items[i]].next_event_us;
+}
+
+static void heap_sift_down(device_heap_t *heap, size_t i) {
+    for (;;) {
+        size_t smallest = i;
+        size_t left = 2 * i + 1;
+        size_t right = left + 1;
+        if (left < heap->len && heap_key(heap, left) < heap_key(heap, smallest)) {
+            smallest = left;
+        }
+        if (right < heap->len && heap_key(heap, right) < heap_key(heap, smallest)) {
+            smallest = right;
+        }
+        if (smallest == i) {
+            return;
+        }
+        uint32_t tmp = heap->items[i];
+        heap->items[i] = heap->items[smallest];
+        heap->items[smallest] = tmp;
+        i = smallest;
+    }
+}
+
+// Per-channel collision tracking; a transmission is decided once the next one starts
+typedef struct {
+    bool has_pending;
+    sim_tx_t pending;
+    uint64_t busy_until_us;
+} channel_state_t;
+
+typedef struct {
+    sim_report_t *items;
+    size_t len;
+    size_t cap;
+} report_list_t;
+
+static void report_push(report_list_t *list, const sim_tx_t *tx) {
+    if (list->len == list->cap) {
+        list->cap = list->cap ? list->cap * 2 : 4096;
+        list->items = realloc(list->items, list->cap * sizeof(sim_report_t));
+        if (!list->items) {
+            fprintf(stderr, "Out of memory\n");
+            exit(1);
+        }
+    }
+    sim_report_t *report = &list->items[list->len++];
+    report->time_us = tx->end_us;
+    report->device = tx->device;
+    report->event_us = tx->event_us;
+    report->packet_id = tx->packet_id;
+    report->is_burst = tx->is_burst;
+    report->burst = tx->burst;
+}
+
+// Whether the scanner is listening on the transmission's channel for all of it
+static bool in_scan_window(const sim_config_t *config, const sim_tx_t *tx, uint8_t channel) {
+    uint64_t interval_us = (uint64_t)config->scan_interval_ms * 1000;
+    uint64_t window_us = (uint64_t)config->scan_window_ms * 1000;
+    uint64_t k = tx->start_us / interval_us;
+    uint64_t window_start = k * interval_us;
+    return k % 3 == channel && tx->end_us <= window_start + window_us;
+}
+
+static void decide_tx(const sim_config_t *config, const sim_tx_t *tx, uint8_t channel,
+                      report_list_t *reports, sim_stats_t *stats) {
+    if (tx->collided) {
+        stats->collided++;
+    } else if (!in_scan_window(config, tx, channel)) {
+        stats->outside_window++;
+    } else {
+        report_push(reports, tx);
+    }
+}
+
+static void add_tx(const sim_config_t *config, channel_state_t *channel, uint8_t index, sim_tx_t *tx,
+                   report_list_t *reports, sim_stats_t *stats) {
+    stats->transmissions++;
+    if (tx->start_us < channel->busy_until_us) {
+        tx->collided = true;
+        channel->pending.collided = true;
+    }
+    if (channel->has_pending) {
+        decide_tx(config, &channel->pending, index, reports, stats);
+    }
+    channel->pending = *tx;
+    channel->has_pending = true;
+    if (tx->end_us > channel->busy_until_us) {
+        channel->busy_until_us = tx->end_us;
+    }
+}
+
+// Run the radio: every advertising event goes out on channels 37, 38 and 39 in turn
+static report_list_t simulate_air(const sim_config_t *config, sim_device_t *devices, uint32_t count,
+                                  sim_stats_t *stats) {
+    report_list_t reports = {0};
+    channel_state_t channels[3] = {0};
+    uint64_t end_us = (uint64_t)config->duration_s * 1000000;
+
+    device_heap_t heap = { .items = malloc(count * sizeof(uint32_t)), .len = count, .devices = devices };
+    for (uint32_t i = 0; i < count; i++) {
+        heap.items[i] = i;
+    }
+    for (size_t i = count / 2; i-- > 0;) {
+        heap_sift_down(&heap, i);
+    }
+
+    uint8_t adv[BTHOME_ADV_MAX_LEN];
+    while (heap.len > 0 && heap_key(&heap, 0) < end_us) {
+        sim_device_t *device = &devices[heap.items[0]];
+        uint64_t event_us = device->next_event_us;
+
+        bool is_burst = false;
+        if (device->trigger_based && device->burst_left == 0 && event_us >= device->next_burst_us) {
+            device->burst_left = config->burst_count;
+            device->burst++;
+            device->burst_start_us = event_us;
+            device->packet_id++;  // A new reading
+            stats->bursts++;
+            device->next_burst_us = event_us + rng_range(1, config->burst_every_s * 2) * 1000000ULL;
+        }
+        if (device->burst_left > 0) {
+            is_burst = true;
+            device->burst_left--;
+        } else {
+            device->packet_id++;
+        }
+
+        int len = encode_device(device, device->packet_id, is_burst, adv, sizeof(adv));
+        if (len < 0) {
+            fprintf(stderr, "Device %u does not fit an advertisement\n", heap.items[0]);
+            exit(1);
+        }
+        uint64_t airtime_us = (uint64_t)(AIR_OVERHEAD_BYTES + len) * US_PER_BYTE;
+
+        stats->events++;
+        for (uint8_t ch = 0; ch < 3; ch++) {
+            sim_tx_t tx = {
+                .start_us = event_us + ch * (airtime_us + CHANNEL_HOP_US),
+                .device = heap.items[0],
+                .event_us = is_burst ? device->burst_start_us : event_us,
+                .packet_id = device->packet_id,
+                .is_burst = is_burst,
+                .burst = device->burst,
+            };
+            tx.end_us = tx.start_us + airtime_us;
+            add_tx(config, &channels[ch], ch, &tx, &reports, stats);
+        }
+
+        // Next event: bursts repeat quickly, otherwise the interval plus advDelay
+        uint64_t delay = device->burst_left > 0 ? (uint64_t)config->burst_interval_ms * 1000
+                                                : device->interval_us;
+        device->next_event_us = event_us + delay + rng_range(0, config->jitter_ms * 1000);
+        heap_sift_down(&heap, 0);
+    }
+    for (uint8_t ch = 0; ch < 3; ch++) {
+        if (channels[ch].has_pending) {
+            decide_tx(config, &channels[ch].pending, ch, &reports, stats);
+        }
+    }
+
+    free(heap.items);
+    return reports;
+}
+
+static int compare_reports(const void *a, const void *b) {
+    const sim_report_t *ra = a;
+    const sim_report_t *rb = b;
+    return ra->time_us < rb->time_us ? -1 : ra->time_us > rb->time_us;
+}
+
+static int compare_u32(const void *a, const void *b) {
+    uint32_t ua = *(const uint32_t *)a;
+    uint32_t ub = *(const uint32_t *)b;
+    return ua < ub ? -1 : ua > ub;
+}
+
+// Bounded single-server FIFO: tracks departure times of the items it holds
+typedef struct {
+    uint64_t *departures;
+    size_t cap;
+    size_t head;
+    size_t len;
+    uint64_t free_at_us;           // When the server finishes its last accepted item
+} fifo_server_t;
+
+static void server_init(fifo_server_t *server, size_t cap) {
+    server->departures = calloc(cap, sizeof(uint64_t));
+    server->cap = cap;
+    server->head = 0;
+    server->len = 0;
+    server->free_at_us = 0;
+}
+
+// Offer an item at arrival_us; returns its departure time, or 0 if the buffer is full
+static uint64_t server_offer(fifo_server_t *server, uint64_t arrival_us, uint32_t service_us) {
+    while (server->len > 0 && server->departures[server->head] <= arrival_us) {
+        server->head = (server->head + 1) % server->cap;
+        server->len--;
+    }
+    if (server->len == server->cap) {
+        return 0;
+    }
+    uint64_t start = arrival_us > server->free_at_us ? arrival_us : server->free_at_us;
+    server->free_at_us = start + service_us;
+    server->departures[(server->head + server->len) % server->cap] = server->free_at_us;
+    server->len++;
+    return server->free_at_us;
+}
+
+// Feed the reports through the scanner core and the delivery queue, as the GAP handler
+// and the dispatch task would
+static uint32_t *run_scanner(const sim_config_t *config, sim_device_t *devices,
+                             const report_list_t *reports, sim_stats_t *stats, size_t *latency_count) {
+    static bthome_scanner_core_t core;
+    bthome_scanner_core_init(&core);
+
+    fifo_server_t gap;
+    fifo_server_t app;
+    server_init(&gap, config->controller_reports + 1);  // Plus the report being handled
+    server_init(&app, config->queue_length + 1);        // Plus the packet being delivered
+
+    uint32_t *latencies = malloc((reports->len + 1) * sizeof(uint32_t));
+    *latency_count = 0;
+
+    uint8_t adv[BTHOME_ADV_MAX_LEN];
+    for (size_t i = 0; i < reports->len; i++) {
+        const sim_report_t *report = &reports->items[i];
+        sim_device_t *device = &devices[report->device];
+        stats->heard++;
+
+        uint64_t handled_us = server_offer(&gap, report->time_us, config->gap_us);
+        if (handled_us == 0) {
+            stats->controller_dropped++;
+            continue;
+        }
+
+        // The stand-in radio source: what the GAP handler would receive
+        int len = encode_device(device, report->packet_id, report->is_burst, adv, sizeof(adv));
+        int rssi = -40 - (int)(report->device % 50);
+
+        double start = now_seconds();
+        bthome_packet_t packet;
+        int result = bthome_scanner_core_decode(&core, device->addr, adv, len, rssi, &packet);
+        if (result == 0) {
+            bthome_scanner_core_record(&core, device->addr, rssi, adv, len, &packet,
+                                       (uint32_t)(report->time_us / 1000));
+            bthome_packet_free(&packet);
+        }
+        double elapsed = now_seconds() - start;
+        stats->core_seconds += elapsed;
+        bthome_histogram_record(&stats->core_us, (uint32_t)(elapsed * 1e6 + 0.5));
+        if (result != 0) {
+            stats->rejected++;
+            continue;
+        }
+
+        uint64_t delivered_us = server_offer(&app, handled_us, config->app_us);
+        if (delivered_us == 0) {
+            stats->queue_dropped++;
+            continue;
+        }
+        stats->delivered++;
+        latencies[(*latency_count)++] = (uint32_t)(delivered_us - report->event_us);
+
+        if (report->is_burst && report->burst != device->heard_burst) {
+            device->heard_burst = report->burst;
+            stats->bursts_heard++;
+        }
+    }
+
+    free(gap.departures);
+    free(app.departures);
+    qsort(latencies, *latency_count, sizeof(uint32_t), compare_u32);
+    return latencies;
+}
+
+static double percentile_ms(const uint32_t *sorted, size_t count, double p) {
+    if (count == 0) {
+        return 0;
+    }
+    size_t index = (size_t)(p * (count - 1));
+    return sorted[index] / 1000.0;
+}
+
+static void run(const sim_config_t *config, uint32_t device_count) {
+    rng_state = config->seed ? config->seed : 1;
+    sim_device_t *devices = malloc(device_count * sizeof(sim_device_t));
+    for (uint32_t i = 0; i < device_count; i++) {
+        init_device(&devices[i], i, config);
+    }
+
+    sim_stats_t stats = {0};
+    report_list_t reports = simulate_air(config, devices, device_count, &stats);
+    qsort(reports.items, reports.len, sizeof(sim_report_t), compare_reports);
+
+    size_t latency_count;
+    uint32_t *latencies = run_scanner(config, devices, &reports, &stats, &latency_count);
+
+    double seconds = config->duration_s;
+    printf("%7u %9.0f %9.0f %7.1f%% %7.1f%% %9.0f %7.1f%% %7.1f%% %8.2f %8.2f %8.2f %8.2f %7.1f%% %10.0f %11u\n",
+           (unsigned)device_count,
+           stats.events / seconds,
+           stats.heard / seconds,
+           100.0 * stats.collided / (stats.transmissions ? stats.transmissions : 1),
+           100.0 * stats.outside_window / (stats.transmissions ? stats.transmissions : 1),
+           stats.delivered / seconds,
+           100.0 * stats.controller_dropped / (stats.heard ? stats.heard : 1),
+           100.0 * stats.queue_dropped / (stats.heard ? stats.heard : 1),
+           percentile_ms(latencies, latency_count, 0.50),
+           percentile_ms(latencies, latency_count, 0.90),
+           percentile_ms(latencies, latency_count, 0.99),
+           percentile_ms(latencies, latency_count, 1.0),
+           stats.bursts ? 100.0 * stats.bursts_heard / stats.bursts : 0.0,
+           stats.core_seconds > 0 ? (stats.heard - stats.controller_dropped) / stats.core_seconds : 0.0,
+           (unsigned)bthome_histogram_percentile(&stats.core_us, 99));
+
+    free(latencies);
+    free(reports.items);
+    free(devices);
+}
+
+static void usage(const char *argv0) {
+    fprintf(stderr,
+            "Usage: %s [options]\n"
+            "  --devices N[,N...]       Device counts to simulate (default 100,500,1000,2000,5000)\n"
+            "  --duration S             Simulated seconds per run (default 60)\n"
+            "  --interval MIN-MAX       Advertising interval range in ms (default 1000-10000)\n"
+            "  --jitter MS              Random delay added to each advertising event (default 10)\n"
+            "  --objects N              Up to N measurements per device, 1-4 (default 3)\n"
+            "  --encrypted F            Fraction of encrypted devices (default 0.05)\n"
+            "  --trigger F              Fraction of devices sending button bursts (default 0.05)\n"
+            "  --burst-every S          Mean seconds between bursts (default 30)\n"
+            "  --burst COUNT,MS         Advertisements per burst and their spacing (default 5,50)\n"
+            "  --scan INTERVAL,WINDOW   Scan interval and window in ms (default 50,30)\n"
+            "  --controller-reports N   Reports buffered ahead of the GAP handler (default 10)\n"
+            "  --gap-us US              GAP handler time per report (default 150)\n"
+            "  --queue N                Scanner delivery queue length (default 32)\n"
+            "  --app-us US              Application time per delivered packet (default 200)\n"
+            "  --seed N                 Random seed (default 1)\n",
+            argv0);
+}
+
+static bool parse_devices(const char *arg, sim_config_t *config) {
+    config->device_count_len = 0;
+    char *end;
+    while (*arg && config->device_count_len < MAX_DEVICE_COUNTS) {
+        unsigned long n = strtoul(arg, &end, 10);
+        if (end == arg || n == 0) {
+            return false;
+        }
+        config->device_counts[config->device_count_len++] = n;
+        arg = *end == ',' ? end + 1 : end;
+    }
+    return config->device_count_len > 0;
+}
+
+int main(int argc, char **argv) {
+    sim_config_t config = {
+        .device_counts = { 100, 500, 1000, 2000, 5000 },
+        .device_count_len = 5,
+        .duration_s = 60,
+        .interval_min_ms = 1000,
+        .interval_max_ms = 10000,
+        .jitter_ms = 10,
+        .max_objects = 3,
+        .encrypted_fraction = 0.05,
+        .trigger_fraction = 0.05,
+        .burst_every_s = 30,
+        .burst_count = 5,
+        .burst_interval_ms = 50,
+        .scan_interval_ms = 50,
+        .scan_window_ms = 30,
+        .controller_reports = 10,
+        .gap_us = 150,
+        .queue_length = 32,
+        .app_us = 200,
+        .seed = 1,
+    };
+
+    static const struct option options[] = {
+        { "devices", required_argument, NULL, 'd' },
+        { "duration", required_argument, NULL, 't' },
+        { "interval", required_argument, NULL, 'i' },
+        { "jitter", required_argument, NULL, 'j' },
+        { "objects", required_argument, NULL, 'o' },
+        { "encrypted", required_argument, NULL, 'e' },
+        { "trigger", required_argument, NULL, 'g' },
+        { "burst-every", required_argument, NULL, 'b' },
+        { "burst", required_argument, NULL, 'B' },
+        { "scan", required_argument, NULL, 's' },
+        { "controller-reports", required_argument, NULL, 'c' },
+        { "gap-us", required_argument, NULL, 'G' },
+        { "queue", required_argument, NULL, 'q' },
+        { "app-us", required_argument, NULL, 'a' },
+        { "seed", required_argument, NULL, 'r' },
+        { "help", no_argument, NULL, 'h' },
+        { NULL, 0, NULL, 0 },
+    };
+
+    int opt;
+    bool ok = true;
+    while (ok && (opt = getopt_long(argc, argv, "h", options, NULL)) != -1) {
+        switch (opt) {
+            case 'd': ok = parse_devices(optarg, &config); break;
+            case 't': config.duration_s = strtoul(optarg, NULL, 10); break;
+            case 'i':
+                ok = sscanf(optarg, "%u-%u", &config.interval_min_ms, &config.interval_max_ms) == 2;
+                break;
+            case 'j': config.jitter_ms = strtoul(optarg, NULL, 10); break;
+            case 'o': config.max_objects = strtoul(optarg, NULL, 10); break;
+            case 'e': config.encrypted_fraction = strtod(optarg, NULL); break;
+            case 'g': config.trigger_fraction = strtod(optarg, NULL); break;
+            case 'b': config.burst_every_s = strtoul(optarg, NULL, 10); break;
+            case 'B':
+                ok = sscanf(optarg, "%u,%u", &config.burst_count, &config.burst_interval_ms) == 2;
+                break;
+            case 's':
+                ok = sscanf(optarg, "%u,%u", &config.scan_interval_ms, &config.scan_window_ms) == 2;
+                break;
+            case 'c': config.controller_reports = strtoul(optarg, NULL, 10); break;
+            case 'G': config.gap_us = strtoul(optarg, NULL, 10); break;
+            case 'q': config.queue_length = strtoul(optarg, NULL, 10); break;
+            case 'a': config.app_us = strtoul(optarg, NULL, 10); break;
+            case 'r': config.seed = strtoul(optarg, NULL, 10); break;
+            default: ok = false; break;
+        }
+    }
+    if (!ok || optind != argc || config.duration_s == 0 || config.max_objects < 1 ||
+        config.max_objects > 4 || config.interval_min_ms == 0 ||
+        config.interval_max_ms < config.interval_min_ms || config.scan_interval_ms == 0 ||
+        config.scan_window_ms > config.scan_interval_ms || config.queue_length == 0 ||
+        config.burst_every_s == 0) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    printf("%7s %9s %9s %8s %8s %9s %8s %8s %8s %8s %8s %8s %8s %10s %11s\n",
+           "devices", "adverts/s", "heard/s", "collided", "unheard", "deliver/s", "ctl_drop",
+           "q_drop", "p50_ms", "p90_ms", "p99_ms", "max_ms", "bursts", "core/s", "core_p99_us");
+    for (size_t i = 0; i < config.device_count_len; i++) {
+        run(&config, config.device_counts[i]);
+    }
+    return 0;
+}